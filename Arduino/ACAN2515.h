@@ -32,10 +32,35 @@ struct CANMessage
   uint8_t data[8];
 };
 
+struct ACAN2515Mask
+{
+  uint8_t mSIDH;
+  uint8_t mSIDL;
+  uint8_t mEID8;
+  uint8_t mEID0;
+};
+
+typedef void (*ACAN2515CallBackRoutine)(const CANMessage & inMessage);
+
+struct ACAN2515AcceptanceFilter
+{
+  const ACAN2515Mask mMask;
+  const ACAN2515CallBackRoutine mCallBack;
+};
+
+ACAN2515Mask standard2515Mask(const uint16_t inIdentifier, const uint8_t inByte0, const uint8_t inByte1);
+ACAN2515Mask standard2515Filter(const uint16_t inIdentifier, const uint8_t inByte0, const uint8_t inByte1);
+
 struct ACAN2515
 {
   ACAN2515(uint8_t i, SPIClass & aClass, uint8_t i1);
   unsigned short begin(const ACAN2515Settings & settings, void (*isr)());
+  unsigned short begin(const ACAN2515Settings & settings, void (*isr)(),
+                       const ACAN2515Mask inRXM0, const ACAN2515Mask inRXM1,
+                       const ACAN2515AcceptanceFilter inAcceptanceFilters[], const uint8_t inAcceptanceFilterCount);
+  uint16_t setFiltersOnTheFly();
+  uint16_t setFiltersOnTheFly(const ACAN2515Mask inRXM0, const ACAN2515Mask inRXM1,
+                              const ACAN2515AcceptanceFilter inAcceptanceFilters[], const uint8_t inAcceptanceFilterCount);
   void isr();
   void poll();
   bool available();
@@ -32,11 +32,13 @@ struct Serial_T
 {
   void begin(int baudrate);
 
-  bool available();
+  int available();
+  int availableForWrite();
   char read();
   void flush();
   unsigned char readBytesUntil(int termChar, char *string, int length);
   void print(const char *);
   void println(const char *);
+  size_t write(const char *buffer, size_t size);
 };
 extern struct Serial_T Serial;
\ No newline at end of file
@@ -0,0 +1,18 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+//
+//
+
+#pragma once
+
+#include <Arduino.h>
+
+struct DueFlashStorage
+{
+  byte read(uint32_t address);
+  byte * readAddress(uint32_t address);
+  bool write(uint32_t address, byte value);
+  bool write(uint32_t address, byte * data, uint32_t dataLength);
+};
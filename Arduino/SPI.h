@@ -7,9 +7,23 @@
 
 #pragma once
 
+#include <Arduino.h>
+
+#define MSBFIRST 1
+#define SPI_MODE0 0x00
+
+struct SPISettings
+{
+    SPISettings() {}
+    SPISettings(unsigned long clock, byte bitOrder, byte dataMode) {}
+};
+
 struct SPIClass
 {
     void begin();
+    void beginTransaction(SPISettings settings);
+    byte transfer(byte data);
+    void endTransaction();
 };
 
-extern SPIClass SPI;
\ No newline at end of file
+extern SPIClass SPI;
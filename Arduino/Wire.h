@@ -8,9 +8,10 @@ struct TwoWire
     void beginTransmission(byte);
     byte endTransmission();
     void write(int i);
+    void write(const byte *data, size_t length);
     byte read();
     bool available();
-    void requestFrom(int i, int i1);
+    byte requestFrom(int i, int i1);
 };
 
-extern TwoWire Wire;
\ No newline at end of file
+extern TwoWire Wire;
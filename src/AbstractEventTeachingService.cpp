@@ -32,6 +32,32 @@ void AbstractEventTeachingService::inhibitLearn()
   controller->setParamFlag(PF_LRN, false);
 }
 
+bool AbstractEventTeachingService::acceptsMessage(const VlcbMessage *msg)
+{
+  unsigned int nn = Configuration::getTwoBytes(&msg->data[1]);
+
+  switch (msg->data[0])
+  {
+    case OPC_NNLRN:
+      // Learn mode is also cancelled when another node is put in learn mode.
+    case OPC_EVULN:
+      // Learn mode may be turned on by a message that is still in the queue.
+      return true;
+
+    case OPC_MODE:
+    case OPC_NNULN:
+    case OPC_RQEVN:
+    case OPC_NERD:
+    case OPC_REVAL:
+    case OPC_NNCLR:
+    case OPC_NNEVN:
+      return isThisNodeNumber(nn);
+
+    default:
+      return false;
+  }
+}
+
 void AbstractEventTeachingService::handleMessage(const VlcbMessage *msg) 
 {
   unsigned int opc = msg->data[0];
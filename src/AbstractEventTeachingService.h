@@ -24,6 +24,7 @@ public:
 
   /// @cond LIBRARY
   virtual Data getServiceData() override;
+  virtual bool acceptsMessage(const VlcbMessage *msg) override;
 
   void enableLearn();
   void inhibitLearn();
@@ -0,0 +1,117 @@
+// Copyright (C) Sven Rosvall (sven@rosvall.ie)
+// This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+// Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0/
+
+
+//
+// Functions to convert between a compact binary format and CANFrame objects
+//
+
+
+// Each frame is sent as:
+// <FLAGS> <IDENTIFIER> <DATA-0> … <DATA-7> <CRC>
+// where:
+//     FLAGS is one byte. Bit 7 is set for extended frames, bit 6 is set for RTR frames,
+//     bits 0 to 3 hold the number of data bytes. Bits 4 and 5 are always zero.
+//     IDENTIFIER is 2 bytes for standard frames and 4 bytes for extended frames, most significant byte first.
+//     CRC is a CRC-8 with polynomial 0x07 and initial value 0xFF over all preceding bytes of the frame.
+//
+// The length of a frame follows from its first byte so there are no start or end markers.
+// A standard frame with 8 data bytes is 12 bytes long compared with 24 characters in GridConnect.
+// The receiver finds the start of the next frame again after an error by dropping
+// one byte at a time until the flags are valid and the CRC matches.
+
+#include "BinaryFraming.h"
+
+namespace VLCB
+{
+
+  static const uint8_t FLAG_EXT = 0x80;
+  static const uint8_t FLAG_RTR = 0x40;
+  static const uint8_t FLAG_RESERVED = 0x30;
+  static const uint8_t FLAG_LEN = 0x0F;
+
+  static uint8_t crc8(const uint8_t * buffer, byte length)
+  {
+    uint8_t crc = 0xFF;
+    for (byte i = 0; i < length; ++i)
+    {
+      crc ^= buffer[i];
+      for (byte bit = 0; bit < 8; ++bit)
+      {
+        crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+      }
+    }
+    return crc;
+  }
+
+  byte binaryFrameLength(uint8_t firstByte)
+  {
+    byte len = firstByte & FLAG_LEN;
+    if ((firstByte & FLAG_RESERVED) || len > 8)
+    {
+      return 0;
+    }
+    // flags, identifier, data and CRC
+    return 1 + ((firstByte & FLAG_EXT) ? 4 : 2) + len + 1;
+  }
+
+  //
+  /// encode a frame into buffer which must hold BINARY_FRAME_MAX_LENGTH bytes
+  /// returns the number of bytes encoded, or 0 if the frame cannot be encoded
+  //
+  byte encodeBinaryFrame(uint8_t * buffer, const CanFrameHeader & header, const uint8_t data[])
+  {
+    if (header.len > 8 || header.id > (header.ext ? 0x1FFFFFFF : 0x7FF))
+    {
+      return 0;
+    }
+
+    uint8_t * pos = buffer;
+    *pos++ = (header.ext ? FLAG_EXT : 0) | (header.rtr ? FLAG_RTR : 0) | header.len;
+    if (header.ext)
+    {
+      *pos++ = header.id >> 24;
+      *pos++ = header.id >> 16;
+    }
+    *pos++ = header.id >> 8;
+    *pos++ = header.id;
+    memcpy(pos, data, header.len);
+    pos += header.len;
+    byte length = pos - buffer;
+    *pos++ = crc8(buffer, length);
+    return length + 1;
+  }
+
+  //
+  /// decode a complete frame of the length given by binaryFrameLength()
+  /// returns false if the CRC does not match or the identifier is out of range
+  //
+  bool decodeBinaryFrame(const uint8_t * buffer, byte length, CANFrame *frame)
+  {
+    if (length == 0 || length != binaryFrameLength(buffer[0]) || crc8(buffer, length - 1) != buffer[length - 1])
+    {
+      return false;
+    }
+
+    const uint8_t * pos = buffer + 1;
+    uint32_t id = 0;
+    byte idLength = (buffer[0] & FLAG_EXT) ? 4 : 2;
+    for (byte i = 0; i < idLength; ++i)
+    {
+      id = (id << 8) | *pos++;
+    }
+    if (id > ((buffer[0] & FLAG_EXT) ? 0x1FFFFFFF : 0x7FF))
+    {
+      return false;
+    }
+
+    frame->id = id;
+    frame->ext = buffer[0] & FLAG_EXT;
+    frame->rtr = buffer[0] & FLAG_RTR;
+    frame->len = buffer[0] & FLAG_LEN;
+    memcpy(frame->data, pos, frame->len);
+    return true;
+  }
+}
@@ -0,0 +1,20 @@
+// Copyright (C) Sven Rosvall (sven@rosvall.ie)
+// This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+// Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#pragma once
+
+#include <Arduino.h>
+#include <CanTransport.h>
+
+namespace VLCB
+{
+  // Longest binary frame, an extended frame with 8 data bytes.
+  const byte BINARY_FRAME_MAX_LENGTH = 14;
+
+  // Length of the binary frame that starts with this byte, or 0 if it cannot start a frame.
+  byte binaryFrameLength(uint8_t firstByte);
+  bool decodeBinaryFrame(const uint8_t * buffer, byte length, CANFrame *frame);
+  byte encodeBinaryFrame(uint8_t * buffer, const CanFrameHeader & header, const uint8_t data[]);
+}
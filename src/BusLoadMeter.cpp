@@ -0,0 +1,140 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+#include "BusLoadMeter.h"
+#include <string.h>
+
+namespace VLCB
+{
+
+//
+/// bits on the bus for a frame
+//
+unsigned int BusLoadMeter::frameBits(bool ext, bool rtr, uint8_t len)
+{
+  // A remote frame has a DLC but no data field.
+  unsigned int dataBits = rtr ? 0 : 8 * len;
+
+  // Standard frame: SOF, 11 bit ID, RTR, IDE, r0, DLC, data and 15 bit CRC are subject to stuffing.
+  // Extended frames add SRR, 18 bit ID extension and r1.
+  unsigned int stuffedBits = (ext ? 54 : 34) + dataBits;
+
+  // Then follows CRC delimiter, ACK slot and delimiter, EOF and interframe space.
+  unsigned int fixedBits = 1 + 2 + 7 + 3;
+
+  // A stuff bit is inserted after 5 equal bits. In the worst case
+  // this happens after the first 5 bits and then after every 4 bits.
+  unsigned int stuffBits = (stuffedBits - 1) / 4;
+
+  return stuffedBits + fixedBits + stuffBits;
+}
+
+void BusLoadMeter::countReceivedBits(unsigned int bits)
+{
+  update();
+  receiveBits += bits;
+  ++framesThisSecond;
+  ++slotFrames;
+}
+
+void BusLoadMeter::countTransmittedBits(unsigned int bits)
+{
+  update();
+  transmitBits += bits;
+  ++framesThisSecond;
+  ++slotFrames;
+}
+
+void BusLoadMeter::update()
+{
+  unsigned long now = millis();
+  if (now - slotStart < BUS_LOAD_SLOT_MILLIS)
+  {
+    return;
+  }
+
+  if (slotFrames > peakSlotFrames)
+  {
+    peakSlotFrames = slotFrames;
+  }
+  slotFrames = 0;
+  slotStart = now - (now - slotStart) % BUS_LOAD_SLOT_MILLIS;
+
+  // Close each second that has passed. Stop after filling the history with idle seconds.
+  byte closed = 0;
+  while (now - secondStart >= 1000 && closed <= BUS_LOAD_HISTORY_SECONDS)
+  {
+    closeSecond();
+    secondStart += 1000;
+    ++closed;
+  }
+  if (now - secondStart >= 1000)
+  {
+    secondStart = now - (now - secondStart) % 1000;
+  }
+}
+
+void BusLoadMeter::closeSecond()
+{
+  receiveLoadHistory[historyIndex] = receiveBits * 1000 / bitRate;
+  transmitLoadHistory[historyIndex] = transmitBits * 1000 / bitRate;
+  historyIndex = (historyIndex + 1) % BUS_LOAD_HISTORY_SECONDS;
+  if (historyCount < BUS_LOAD_HISTORY_SECONDS)
+  {
+    ++historyCount;
+  }
+
+  framesLastSecond = framesThisSecond;
+  framesThisSecond = 0;
+  receiveBits = 0;
+  transmitBits = 0;
+}
+
+void BusLoadMeter::reset()
+{
+  secondStart = slotStart = millis();
+  receiveBits = transmitBits = 0;
+  framesThisSecond = framesLastSecond = 0;
+  slotFrames = peakSlotFrames = 0;
+  memset(receiveLoadHistory, 0, sizeof(receiveLoadHistory));
+  memset(transmitLoadHistory, 0, sizeof(transmitLoadHistory));
+  historyIndex = historyCount = 0;
+}
+
+unsigned int BusLoadMeter::lastReceiveLoad() const
+{
+  if (historyCount == 0)
+  {
+    return 0;
+  }
+  return receiveLoadHistory[(historyIndex + BUS_LOAD_HISTORY_SECONDS - 1) % BUS_LOAD_HISTORY_SECONDS];
+}
+
+unsigned int BusLoadMeter::lastTransmitLoad() const
+{
+  if (historyCount == 0)
+  {
+    return 0;
+  }
+  return transmitLoadHistory[(historyIndex + BUS_LOAD_HISTORY_SECONDS - 1) % BUS_LOAD_HISTORY_SECONDS];
+}
+
+unsigned int BusLoadMeter::averageLoad(const unsigned int history[]) const
+{
+  if (historyCount == 0)
+  {
+    return 0;
+  }
+
+  // Entries not yet written are zero.
+  unsigned long sum = 0;
+  for (byte i = 0; i < BUS_LOAD_HISTORY_SECONDS; ++i)
+  {
+    sum += history[i];
+  }
+  return sum / historyCount;
+}
+
+}
@@ -0,0 +1,78 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+#pragma once
+
+#include <Arduino.h>
+#include "CanTransport.h"
+
+namespace VLCB
+{
+
+const unsigned long DEFAULT_CAN_BITRATE = 125000UL;  // CBUS/VLCB standard bit rate
+const byte BUS_LOAD_HISTORY_SECONDS = 10;
+const unsigned int BUS_LOAD_SLOT_MILLIS = 100;
+
+/// @brief Estimates CAN bus utilisation from the frames sent and received by this module.
+///
+/// Each frame is converted to the number of bits it occupies on the bus including
+/// a worst case estimate of stuff bits.
+/// Load is reported in units of 0.1% of the bus bit rate for the last complete
+/// second and averaged over the last 10 seconds.
+class BusLoadMeter
+{
+public:
+  explicit BusLoadMeter(unsigned long bitRate = DEFAULT_CAN_BITRATE) : bitRate(bitRate) {}
+
+  /// Number of bits the frame occupies on the bus including interframe space.
+  static unsigned int frameBits(bool ext, bool rtr, uint8_t len);
+  /// Works with CANFrame, CanFrameHeader or any other type with ext, rtr and len members.
+  template <typename Frame>
+  static unsigned int frameBits(const Frame & frame) { return frameBits(frame.ext, frame.rtr, frame.len); }
+
+  void setBitRate(unsigned long rate) { bitRate = rate; }
+  unsigned long getBitRate() const { return bitRate; }
+
+  template <typename Frame>
+  void countReceived(const Frame & frame) { countReceivedBits(frameBits(frame)); }
+  template <typename Frame>
+  void countTransmitted(const Frame & frame) { countTransmittedBits(frameBits(frame)); }
+  /// Close time windows that have passed. Call regularly also when there is no traffic.
+  void update();
+  void reset();
+
+  unsigned int getReceiveLoad() const { return lastReceiveLoad(); }  ///< 0.1% units, last second
+  unsigned int getTransmitLoad() const { return lastTransmitLoad(); }  ///< 0.1% units, last second
+  unsigned int getReceiveLoad10s() const { return averageLoad(receiveLoadHistory); }  ///< 0.1% units, last 10 seconds
+  unsigned int getTransmitLoad10s() const { return averageLoad(transmitLoadHistory); }  ///< 0.1% units, last 10 seconds
+  unsigned int getFramesPerSecond() const { return framesLastSecond; }  ///< frames in both directions, last second
+  unsigned int getPeakFramesPerSlot() const { return peakSlotFrames; }  ///< most frames seen in any 100ms period
+
+private:
+  void countReceivedBits(unsigned int bits);
+  void countTransmittedBits(unsigned int bits);
+  void closeSecond();
+  unsigned int lastReceiveLoad() const;
+  unsigned int lastTransmitLoad() const;
+  unsigned int averageLoad(const unsigned int history[]) const;
+
+  unsigned long bitRate;
+
+  unsigned long secondStart = 0;
+  unsigned long slotStart = 0;
+  unsigned long receiveBits = 0;
+  unsigned long transmitBits = 0;
+  unsigned int framesThisSecond = 0;
+  unsigned int framesLastSecond = 0;
+  unsigned int slotFrames = 0;
+  unsigned int peakSlotFrames = 0;
+
+  unsigned int receiveLoadHistory[BUS_LOAD_HISTORY_SECONDS] = {};
+  unsigned int transmitLoadHistory[BUS_LOAD_HISTORY_SECONDS] = {};
+  byte historyIndex = 0;
+  byte historyCount = 0;
+};
+
+}
@@ -24,6 +24,7 @@ CAN2515::CAN2515()
   , _intPin(MCP2515_INT)
   , _num_rx_buffers(NUM_RX_BUFFS)
   , _num_tx_buffers(NUM_TX_BUFFS)
+  , _num_retry_buffers(NUM_TX_RETRY_BUFFS)
 {
 }
 
@@ -41,7 +42,22 @@ bool CAN2515::begin(bool poll, SPIClass & spi)
 
   _numMsgsSent = 0;
   _numMsgsRcvd = 0;
+  _numTxRetries = 0;
+  _numTxDrops = 0;
+  _numRxOverruns = 0;
+  _rxErrorCounterIncrease = 0;
+  _txErrorCounterIncrease = 0;
+  _lastRxErrorCount = 0;
+  _lastTxErrorCount = 0;
+  _lastErrorSampleTime = millis();
   _poll = poll;
+  _spi = &spi;
+
+  if (_txRetryQueue == nullptr)
+  {
+    _txRetryQueue = new CircularBuffer<CANMessage>(_num_retry_buffers);
+  }
+  _txRetryQueue->clear();
 
   ACAN2515Settings settings(_osc_freq, CANBITRATE);
 
@@ -69,18 +85,19 @@ bool CAN2515::begin(bool poll, SPIClass & spi)
 
   // instantiate CAN bus object
   // if in polling mode, the interrupt pin and ISR not used
+  void (*isr)() = NULL;
   if (_poll)
   {
     canp = new ACAN2515(_csPin, spi, 255);
-    ret = canp->begin(settings, NULL);
   }
   else
   {
     canp = new ACAN2515(_csPin, spi, _intPin);
     static ACAN2515 * lcanp; // Need a variable with static storage duration for use in the lambda.
     lcanp = canp;
-    ret = canp->begin(settings, [] { lcanp->isr(); });
+    isr = [] { lcanp->isr(); };
   }
+  ret = programAcceptanceFilters(&settings, isr);
 
   if (ret == 0)
   {
@@ -94,6 +111,146 @@ bool CAN2515::begin(bool poll, SPIClass & spi)
   }
 }
 
+//
+/// set the acceptance filters
+/// filters are programmed into the MCP2515 if they fit its masks and filters
+/// otherwise frames are filtered in software
+//
+bool CAN2515::setAcceptanceFilters(const CanAcceptanceFilter filters[], byte count)
+{
+  if (!CanTransport::setAcceptanceFilters(filters, count))
+  {
+    return false;
+  }
+
+  if (canp != nullptr)
+  {
+    // Already running. Change the filters without resetting the controller.
+    return programAcceptanceFilters(nullptr, NULL) == 0;
+  }
+  return true;
+}
+
+bool CAN2515::acceptsFrame(const CanFrameHeader & header)
+{
+  return _hardwareFilters || CanTransport::acceptsFrame(header);
+}
+
+//
+/// map the acceptance filters onto the MCP2515 masks and filters
+/// RXB0 has mask 0 with 2 filters and RXB1 has mask 1 with 4 filters
+/// unused filter slots repeat another filter with the same mask
+/// returns false if the filters use more than 2 masks or do not fit the buffers
+//
+bool CAN2515::mapAcceptanceFilters(uint16_t masks[2], uint16_t ids[MAX_ACCEPTANCE_FILTERS])
+{
+  byte numMasks = 0;
+  byte maskUse[2] = {0, 0};
+  for (byte i = 0; i < numAcceptanceFilters; ++i)
+  {
+    uint16_t mask = acceptanceFilters[i].mask & 0x7FF;
+    if (numMasks > 0 && masks[0] == mask)
+    {
+      ++maskUse[0];
+    }
+    else if (numMasks > 1 && masks[1] == mask)
+    {
+      ++maskUse[1];
+    }
+    else if (numMasks < 2)
+    {
+      masks[numMasks] = mask;
+      maskUse[numMasks++] = 1;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  if (numMasks == 1)
+  {
+    // Both buffers use the same mask so all 6 filters are available.
+    masks[1] = masks[0];
+  }
+  else
+  {
+    if (maskUse[0] > 2)
+    {
+      // RXB0 only has 2 filters. Give it the smaller group.
+      uint16_t m = masks[0];
+      masks[0] = masks[1];
+      masks[1] = m;
+      byte u = maskUse[0];
+      maskUse[0] = maskUse[1];
+      maskUse[1] = u;
+    }
+    if (maskUse[0] > 2 || maskUse[1] > 4)
+    {
+      return false;
+    }
+  }
+
+  byte rxb0 = 0;
+  byte rxb1 = 2;
+  for (byte i = 0; i < numAcceptanceFilters; ++i)
+  {
+    uint16_t id = acceptanceFilters[i].id & 0x7FF;
+    if ((acceptanceFilters[i].mask & 0x7FF) == masks[0] && rxb0 < 2)
+    {
+      ids[rxb0++] = id;
+    }
+    else
+    {
+      ids[rxb1++] = id;
+    }
+  }
+
+  // Fill unused slots with a copy of a filter that uses the same mask.
+  for (; rxb0 < 2; ++rxb0)
+  {
+    ids[rxb0] = (rxb0 > 0) ? ids[0] : ids[2];
+  }
+  for (; rxb1 < MAX_ACCEPTANCE_FILTERS; ++rxb1)
+  {
+    ids[rxb1] = (rxb1 > 2) ? ids[2] : ids[0];
+  }
+  return true;
+}
+
+//
+/// program the acceptance filters into the MCP2515
+/// starts the controller if settings are given, otherwise updates the running controller
+//
+uint16_t CAN2515::programAcceptanceFilters(const ACAN2515Settings * settings, void (*isr)())
+{
+  uint16_t masks[2];
+  uint16_t ids[MAX_ACCEPTANCE_FILTERS];
+  // The MCP2515 cannot pass enumeration frames by RTR or length so only filter in
+  // hardware if a filter passes them by ID.
+  _hardwareFilters = numAcceptanceFilters > 0 && filtersPassEnumeration() && mapAcceptanceFilters(masks, ids);
+
+  if (!_hardwareFilters)
+  {
+    // Receive everything. Any filtering is done in software.
+    return settings ? canp->begin(*settings, isr) : canp->setFiltersOnTheFly();
+  }
+
+  const ACAN2515Mask rxm0 = standard2515Mask(masks[0], 0, 0);
+  const ACAN2515Mask rxm1 = standard2515Mask(masks[1], 0, 0);
+  const ACAN2515AcceptanceFilter filters[MAX_ACCEPTANCE_FILTERS] =
+  {
+    {standard2515Filter(ids[0], 0, 0), NULL},
+    {standard2515Filter(ids[1], 0, 0), NULL},
+    {standard2515Filter(ids[2], 0, 0), NULL},
+    {standard2515Filter(ids[3], 0, 0), NULL},
+    {standard2515Filter(ids[4], 0, 0), NULL},
+    {standard2515Filter(ids[5], 0, 0), NULL}
+  };
+  return settings ? canp->begin(*settings, isr, rxm0, rxm1, filters, MAX_ACCEPTANCE_FILTERS)
+                  : canp->setFiltersOnTheFly(rxm0, rxm1, filters, MAX_ACCEPTANCE_FILTERS);
+}
+
 //
 /// check for unprocessed messages in the buffer
 //
@@ -103,64 +260,201 @@ bool CAN2515::available()
   {            // not using interrupts, so poll the interrupt register
     canp->poll();
   }
+
+  // This is called on every loop. Use the opportunity to send frames that are waiting.
+  sendRetryQueue();
+  checkReceiveOverrun();
+  sampleErrorCounters();
+
   return (canp->available());
 }
 
+//
+/// the MCP2515 sets an overflow flag in EFLG when a frame arrives while its receive buffer is still full
+/// count each flag that is set and clear them so that the next overflow is seen
+//
+void CAN2515::checkReceiveOverrun()
+{
+  byte eflg = canp->errorFlagRegister();
+  if ((eflg & (EFLG_RX0OVR | EFLG_RX1OVR)) == 0)
+  {
+    return;
+  }
+
+  if (eflg & EFLG_RX0OVR)
+  {
+    ++_numRxOverruns;
+  }
+  if (eflg & EFLG_RX1OVR)
+  {
+    ++_numRxOverruns;
+  }
+  clearReceiveOverflowFlags();
+}
+
+//
+/// the ACAN2515 driver cannot write registers so clear the flags with a bit modify instruction
+/// the SPI transaction keeps the driver's interrupt handler off the bus meanwhile
+//
+void CAN2515::clearReceiveOverflowFlags()
+{
+  _spi->beginTransaction(SPISettings(MCP2515_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+  digitalWrite(_csPin, LOW);
+  _spi->transfer(MCP2515_BIT_MODIFY);
+  _spi->transfer(MCP2515_EFLG);
+  _spi->transfer(EFLG_RX0OVR | EFLG_RX1OVR);    // mask
+  _spi->transfer(0x00);                         // data
+  digitalWrite(_csPin, HIGH);
+  _spi->endTransaction();
+}
+
+//
+/// the MCP2515 does not count error frames
+/// estimate them from increases of the receive and transmit error counters between samples
+/// the receive error counter increases by 1 for most detected errors
+/// the transmit error counter increases by 8 for each error frame sent as transmitter
+/// both counters decrease for each frame received or sent successfully so these are lower bounds
+//
+void CAN2515::sampleErrorCounters()
+{
+  if (millis() - _lastErrorSampleTime < ERROR_SAMPLE_INTERVAL)
+  {
+    return;
+  }
+  _lastErrorSampleTime = millis();
+
+  byte rec = canp->receiveErrorCounter();
+  byte tec = canp->transmitErrorCounter();
+  if (rec > _lastRxErrorCount)
+  {
+    _rxErrorCounterIncrease += rec - _lastRxErrorCount;
+  }
+  if (tec > _lastTxErrorCount)
+  {
+    _txErrorCounterIncrease += (tec - _lastTxErrorCount + 7) / 8;
+  }
+  _lastRxErrorCount = rec;
+  _lastTxErrorCount = tec;
+}
+
 //
 /// get next unprocessed message from the buffer
 /// must call available first to ensure there is something to get
 //
 CANFrame CAN2515::getNextCanFrame()
+{
+  CANFrame frame;
+  CanFrameHeader header = receiveCanFrame(frame.data);
+  frame.id = header.id;
+  frame.ext = header.ext;
+  frame.rtr = header.rtr;
+  frame.len = header.len;
+  return frame;
+}
+
+//
+/// get next unprocessed message from the buffer with its payload copied straight to data
+/// must call available first to ensure there is something to get
+//
+CanFrameHeader CAN2515::receiveCanFrame(uint8_t data[])
 {
   // DEBUG_SERIAL << F("CAN2515 trying to get next message.") << endl;
   CANMessage message;       // ACAN2515 frame class
 
   canp->receive(message);
 
-//  DEBUG_SERIAL << F("CAN2515 getNextCanFrame id=") << (msg.id & 0x7F) << " len=" << msg.len << " rtr=" << msg.rtr;
-//  if (msg.len > 0)
-//    DEBUG_SERIAL << " op=" << _HEX(msg.data[0]);
+//  DEBUG_SERIAL << F("CAN2515 receiveCanFrame id=") << (message.id & 0x7F) << " len=" << message.len << " rtr=" << message.rtr;
+//  if (message.len > 0)
+//    DEBUG_SERIAL << " op=" << _HEX(message.data[0]);
 //  DEBUG_SERIAL << endl;
 
   ++_numMsgsRcvd;
-  
-  CANFrame frame;
-  frame.id = message.id;
-  frame.ext = message.ext;
-  frame.rtr = message.rtr;
-  frame.len = message.len;
-  memcpy(frame.data, message.data, message.len);
 
-  return frame;
+  return CanFrameAdapter<CANMessage>::read(message, data);
 }
 
 //
 /// send a VLCB message
+/// if the transmit buffer is full the frame is kept in a retry queue and sent later
+/// returns false if the frame had to be dropped
 //
 bool CAN2515::sendCanFrame(CANFrame *frame)
 {
-  CANMessage msg;
-  msg.id = frame->id;
-  msg.ext = frame->ext;
-  msg.rtr = frame->rtr;
-  msg.len = frame->len;
-  memcpy(msg.data, frame->data, frame->len);
+  return transmitCanFrame({frame->id, frame->ext, frame->rtr, frame->len}, frame->data);
+}
 
-//  DEBUG_SERIAL << F("CAN2515 sendCanFrame id=") << (msg->id & 0x7F) << " len=" << msg->len << " rtr=" << rtr;
-//  if (msg->len > 0)
-//    DEBUG_SERIAL << " op=" << _HEX(msg->data[0]);
+//
+/// send a CAN frame given as header and payload
+/// the frame is built straight into the ACAN2515 message and is not copied
+/// again unless it has to wait in the retry queue
+//
+bool CAN2515::transmitCanFrame(const CanFrameHeader & header, const uint8_t data[])
+{
+//  DEBUG_SERIAL << F("CAN2515 transmitCanFrame id=") << (header.id & 0x7F) << " len=" << header.len << " rtr=" << header.rtr;
+//  if (header.len > 0)
+//    DEBUG_SERIAL << " op=" << _HEX(data[0]);
 //  DEBUG_SERIAL << endl;
 
-  bool ret = canp->tryToSend(msg);
-  _numMsgsSent += ret;
+  CANMessage message;
+  CanFrameAdapter<CANMessage>::write(message, header, data);
 
-  // Simple workaround for sending many messages. Let the underlying hardware some time to send this message before next.
-  // Without this delay we need a transmit buffer size of at least 15 or outgoing messages will be dropped.
-  delay(1);
+  // Keep frames in order. Send any earlier frames first.
+  sendRetryQueue();
 
+  if (!_txRetryQueue->available() && tryToSend(message))
+  {
+    return true;
+  }
+
+  if (_txRetryQueue->bufUse() >= _num_retry_buffers)
+  {
+    // DEBUG_SERIAL << F("CAN2515 transmit buffers full, dropping frame") << endl;
+    ++_numTxDrops;
+    return false;
+  }
+
+  ++_numTxRetries;
+  _txRetryQueue->put(message);
+  return true;
+}
+
+//
+/// check for room in the transmit buffer without attempting to send
+//
+bool CAN2515::txSpaceAvailable()
+{
+  unsigned int size = canp->transmitBufferSize(0);
+  // Without a driver buffer only the hardware buffer is used. Let tryToSend() find out.
+  return size == 0 || canp->transmitBufferCount(0) < size;
+}
+
+bool CAN2515::tryToSend(const CANMessage & message)
+{
+  if (!txSpaceAvailable())
+  {
+    return false;
+  }
+
+  bool ret = canp->tryToSend(message);
+  _numMsgsSent += ret;
   return ret;
 }
 
+//
+/// send frames from the retry queue while there is room in the transmit buffer
+//
+void CAN2515::sendRetryQueue()
+{
+  while (_txRetryQueue->available())
+  {
+    if (!tryToSend(*_txRetryQueue->peek()))
+    {
+      return;
+    }
+    _txRetryQueue->pop();
+  }
+}
+
 //
 /// display the CAN bus status instrumentation
 //
@@ -218,6 +512,15 @@ void CAN2515::setNumBuffers(byte num_rx_buffers, byte num_tx_buffers)
   _num_tx_buffers = num_tx_buffers;
 }
 
+//
+/// set the number of frames that can wait for a free transmit buffer
+/// must be called before begin()
+//
+void CAN2515::setNumRetryBuffers(byte num_retry_buffers)
+{
+  _num_retry_buffers = num_retry_buffers;
+}
+
 //
 /// set the MCP2515 crystal frequency
 /// default is 16MHz but some modules have an 8MHz crystal
@@ -21,8 +21,15 @@ static const byte MCP2515_CS = 10;                          // SPI chip select p
 static const byte MCP2515_INT = 2;                          // interrupt pin
 static const byte NUM_RX_BUFFS = 4;                         // default value
 static const byte NUM_TX_BUFFS = 2;                         // default value
+static const byte NUM_TX_RETRY_BUFFS = 4;                   // default value
+static const unsigned int ERROR_SAMPLE_INTERVAL = 100;      // ms between samples of the error counters
 static const uint32_t CANBITRATE = 125000UL;                // 125Kb/s - fixed for VLCB
 static const uint32_t OSCFREQ = 16000000UL;                 // crystal frequency default
+static const uint32_t MCP2515_SPI_CLOCK = 10000000UL;       // maximum SPI clock of the MCP2515
+static const byte MCP2515_BIT_MODIFY = 0x05;                // SPI instruction to change bits of a register
+static const byte MCP2515_EFLG = 0x2D;                      // error flag register
+static const byte EFLG_RX0OVR = 0x40;                       // receive buffer 0 overflow
+static const byte EFLG_RX1OVR = 0x80;                       // receive buffer 1 overflow
 
 /// @brief Transport implementation for the MCP2515/25625 CAN controllers
 class CAN2515 : public CanTransport
@@ -41,12 +48,17 @@ public:
   virtual bool available() override;
   virtual CANFrame getNextCanFrame() override;
   virtual bool sendCanFrame(CANFrame *frame) override;
+  virtual CanFrameHeader receiveCanFrame(uint8_t data[]) override;
+  virtual bool transmitCanFrame(const CanFrameHeader & header, const uint8_t data[]) override;
   virtual void reset() override;
   virtual byte getHardwareType() override { return CAN_HW_MCP2515; };
+  virtual bool setAcceptanceFilters(const CanAcceptanceFilter filters[], byte count) override;
+  virtual bool acceptsFrame(const CanFrameHeader & header) override;
 
   // these methods are specific to this implementation
   // they are not declared or implemented by the Transport interface class
   void setNumBuffers(byte num_rx_buffers, byte num_tx_buffers = 0);      // note default arg
+  void setNumRetryBuffers(byte num_retry_buffers);
   void printStatus();
   void setOscFreq(unsigned long freq);
 
@@ -67,18 +79,43 @@ public:
   virtual unsigned int receiveBufferPeak() override { return canp->receiveBufferPeakCount(); };
   virtual unsigned int transmitBufferPeak() override { return canp->transmitBufferPeakCount(0); };
   virtual unsigned int errorStatus() override { return canp->errorFlagRegister(); }
+  virtual unsigned int transmitRetryCounter() override { return _numTxRetries; }
+  virtual unsigned int transmitDropCounter() override { return _numTxDrops; }
+  virtual unsigned int receiveOverrunCounter() override { return _numRxOverruns; }
+  virtual unsigned int errorFramesDetected() override { return _rxErrorCounterIncrease; }
+  virtual unsigned int errorFramesGenerated() override { return _txErrorCounterIncrease; }
   /// @endcond
 
 private:
-  ACAN2515 *canp;   // pointer to CAN object
+  bool txSpaceAvailable();
+  bool tryToSend(const CANMessage & message);
+  void sendRetryQueue();
+  void checkReceiveOverrun();
+  void clearReceiveOverflowFlags();
+  void sampleErrorCounters();
+  bool mapAcceptanceFilters(uint16_t masks[2], uint16_t ids[MAX_ACCEPTANCE_FILTERS]);
+  uint16_t programAcceptanceFilters(const ACAN2515Settings * settings, void (*isr)());
+
+  ACAN2515 *canp = nullptr;   // pointer to CAN object
+  bool _hardwareFilters = false;  // acceptance filters are programmed into the MCP2515
+  CircularBuffer<CANMessage> *_txRetryQueue = nullptr; // frames waiting for space in the transmit buffer
   unsigned int _numMsgsSent, _numMsgsRcvd;
+  unsigned int _numTxRetries, _numTxDrops;
+  unsigned int _numRxOverruns;
+  unsigned int _rxErrorCounterIncrease;   // estimate of error frames detected, see sampleErrorCounters()
+  unsigned int _txErrorCounterIncrease;   // estimate of error frames generated, see sampleErrorCounters()
+  byte _lastRxErrorCount, _lastTxErrorCount;
+  unsigned long _lastErrorSampleTime;
   unsigned long _osc_freq;
   byte _csPin, _intPin;
-  byte _num_rx_buffers, _num_tx_buffers;
+  byte _num_rx_buffers, _num_tx_buffers, _num_retry_buffers;
   bool _poll;
 
 #ifdef ARDUINO_ARCH_RP2040
   byte _mosi_pin, _miso_pin, _sck_pin;
+  SPIClassRP2040 *_spi = nullptr;
+#else
+  SPIClass *_spi = nullptr;
 #endif
 };
 
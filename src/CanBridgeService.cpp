@@ -0,0 +1,306 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+#include "CanBridgeService.h"
+#include "CanService.h"
+#include <string.h>
+
+namespace VLCB
+{
+
+//
+/// messages that carry the node number of the node they are sent to
+//
+static bool isAddressedToNode(byte opc)
+{
+  switch (opc)
+  {
+    case OPC_NNRSM:
+    case OPC_NNLRN:
+    case OPC_NNULN:
+    case OPC_NNCLR:
+    case OPC_NNEVN:
+    case OPC_NERD:
+    case OPC_RQEVN:
+    case OPC_RQDAT:
+    case OPC_BOOT:
+    case OPC_ENUM:
+    case OPC_NNRST:
+    case OPC_NVRD:
+    case OPC_NENRD:
+    case OPC_RQNPN:
+    case OPC_CANID:
+    case OPC_MODE:
+    case OPC_RQSD:
+    case OPC_RDGN:
+    case OPC_NVSETRD:
+    case OPC_NVSET:
+    case OPC_REVAL:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+//
+/// messages that carry the node number of the node that sent them
+/// events also carry the node number of the producer
+//
+static bool isSentByNode(byte opc)
+{
+  switch (opc)
+  {
+    case OPC_RQNN:
+    case OPC_NNREL:
+    case OPC_NNACK:
+    case OPC_WRACK:
+    case OPC_CMDERR:
+    case OPC_EVNLF:
+    case OPC_NUMEV:
+    case OPC_NVANS:
+    case OPC_PARAN:
+    case OPC_HEARTB:
+    case OPC_SD:
+    case OPC_GRSP:
+    case OPC_NEVAL:
+    case OPC_PNN:
+    case OPC_DGN:
+    case OPC_ESD:
+    case OPC_ENRSP:
+      return true;
+
+    default:
+      return priorityForOpCode(opc) == PRIORITY_EVENT;
+  }
+}
+
+CanBridgeService::CanBridgeService(CanTransport * port0, CanTransport * port1, byte queueSize)
+  : ports{{port0, queueSize}, {port1, queueSize}}
+{
+  clearRoutes();
+}
+
+void CanBridgeService::process(const Action * /*action*/)
+{
+  // Make room for new frames, then forward them without waiting for the next call.
+  for (byte port = 0; port < BRIDGE_PORTS; ++port)
+  {
+    sendFrames(port);
+  }
+  for (byte port = 0; port < BRIDGE_PORTS; ++port)
+  {
+    receiveFrames(port);
+  }
+  for (byte port = 0; port < BRIDGE_PORTS; ++port)
+  {
+    sendFrames(port);
+  }
+}
+
+//
+/// read frames from a port straight into the queue of the other port
+/// stop reading when the other port's queue is full and leave the frames in the transport
+//
+void CanBridgeService::receiveFrames(byte from)
+{
+  Port & in = ports[from];
+  Port & out = ports[1 - from];
+
+  for (byte count = 0; count < maxFramesPerProcess && in.transport->available(); ++count)
+  {
+    CANFrame * frame = out.txQueue.reserve();
+    if (frame == nullptr)
+    {
+      ++in.stats.backpressure;
+      return;
+    }
+
+    CanFrameHeader header = in.transport->receiveCanFrame(frame->data);
+    frame->id = header.id;
+    frame->ext = header.ext;
+    frame->rtr = header.rtr;
+    frame->len = header.len;
+    ++in.stats.framesReceived;
+
+    if (!in.transport->acceptsFrame(header) || !shouldForward(from, *frame))
+    {
+      ++in.stats.framesFiltered;
+      continue;
+    }
+
+    out.txQueue.commit();
+    ++in.stats.framesForwarded;
+    byte usage = out.txQueue.bufUse();
+    if (usage > out.stats.queuePeak)
+    {
+      out.stats.queuePeak = usage;
+    }
+  }
+}
+
+//
+/// send queued frames until the transport refuses one
+//
+void CanBridgeService::sendFrames(byte to)
+{
+  Port & out = ports[to];
+  while (out.txQueue.available())
+  {
+    const CANFrame * frame = out.txQueue.peek();
+    if (!out.transport->transmitCanFrame({frame->id, frame->ext, frame->rtr, frame->len}, frame->data))
+    {
+      // Try again on the next call to process().
+      return;
+    }
+    out.txQueue.pop();
+    ++out.stats.framesSent;
+  }
+}
+
+//
+/// learn where the sender lives and decide if the frame shall go to the other port
+//
+bool CanBridgeService::shouldForward(byte from, const CANFrame & frame)
+{
+  if (frame.ext)
+  {
+    // Not VLCB, such as bootloader data. Let it through.
+    return true;
+  }
+
+  learnCanid(from, frame.id & 0x7F);
+
+  if (frame.rtr || frame.len == 0)
+  {
+    // CANID enumeration requests and replies must reach all segments.
+    return true;
+  }
+
+  byte opc = frame.data[0];
+  unsigned int nn = (frame.len >= 3) ? (frame.data[1] << 8) + frame.data[2] : 0;
+
+  if (nn != 0 && isSentByNode(opc))
+  {
+    learnNode(from, nn);
+  }
+
+  if (priorityForOpCode(opc) == PRIORITY_EVENT)
+  {
+    // Too short to hold an event. Forward it like other frames that the bridge does not understand.
+    return frame.len < 5 || eventPassesFilters(from, frame);
+  }
+
+  if (nn != 0 && isAddressedToNode(opc))
+  {
+    // Forward unless the node is known to be on the segment the message came from.
+    return getNodePort(nn) != from;
+  }
+
+  return true;
+}
+
+bool CanBridgeService::eventPassesFilters(byte from, const CANFrame & frame)
+{
+  bool hasFilters = false;
+  unsigned int nn = (frame.data[1] << 8) + frame.data[2];
+  unsigned int en = (frame.data[3] << 8) + frame.data[4];
+
+  for (byte i = 0; i < numEventFilters; ++i)
+  {
+    const EventFilter & filter = eventFilters[i];
+    if (filter.fromPort != from)
+    {
+      continue;
+    }
+    hasFilters = true;
+    if ((filter.nn == 0 || filter.nn == nn) && en >= filter.firstEvent && en <= filter.lastEvent)
+    {
+      return true;
+    }
+  }
+  return !hasFilters;
+}
+
+bool CanBridgeService::addEventFilter(byte fromPort, unsigned int nn, unsigned int firstEvent, unsigned int lastEvent)
+{
+  if (numEventFilters >= MAX_BRIDGE_EVENT_FILTERS || fromPort >= BRIDGE_PORTS)
+  {
+    return false;
+  }
+  eventFilters[numEventFilters++] = {fromPort, nn, firstEvent, lastEvent};
+  return true;
+}
+
+void CanBridgeService::learnCanid(byte port, byte canid)
+{
+  if (canid == 0)
+  {
+    return;
+  }
+  if (canidPorts[canid] != BRIDGE_NO_PORT && canidPorts[canid] != port)
+  {
+    // The node has moved or there is a CANID conflict across the segments.
+    ++ports[port].stats.canidMoves;
+  }
+  canidPorts[canid] = port;
+}
+
+void CanBridgeService::learnNode(byte port, unsigned int nn)
+{
+  for (byte i = 0; i < numNodeRoutes; ++i)
+  {
+    if (nodeRoutes[i].nn == nn)
+    {
+      nodeRoutes[i].port = port;
+      return;
+    }
+  }
+
+  if (numNodeRoutes < BRIDGE_NODE_TABLE_SIZE)
+  {
+    nodeRoutes[numNodeRoutes++] = {nn, port};
+    return;
+  }
+
+  // Table is full. Replace the entries in turn.
+  nodeRoutes[nextNodeRoute] = {nn, port};
+  nextNodeRoute = (nextNodeRoute + 1) % BRIDGE_NODE_TABLE_SIZE;
+}
+
+//
+/// statistics for a port, all zero for a port that does not exist
+//
+const BridgePortStats & CanBridgeService::getPortStats(byte port) const
+{
+  static const BridgePortStats noStats = {};
+  return (port < BRIDGE_PORTS) ? ports[port].stats : noStats;
+}
+
+byte CanBridgeService::getQueueUsage(byte port)
+{
+  return (port < BRIDGE_PORTS) ? ports[port].txQueue.bufUse() : 0;
+}
+
+byte CanBridgeService::getNodePort(unsigned int nn) const
+{
+  for (byte i = 0; i < numNodeRoutes; ++i)
+  {
+    if (nodeRoutes[i].nn == nn)
+    {
+      return nodeRoutes[i].port;
+    }
+  }
+  return BRIDGE_NO_PORT;
+}
+
+void CanBridgeService::clearRoutes()
+{
+  memset(canidPorts, BRIDGE_NO_PORT, sizeof(canidPorts));
+  numNodeRoutes = 0;
+  nextNodeRoute = 0;
+}
+
+}
@@ -0,0 +1,121 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+#pragma once
+
+#include "Service.h"
+#include "CanTransport.h"
+#include "CircularBuffer.h"
+#include <vlcbdefs.hpp>
+
+namespace VLCB
+{
+
+const byte BRIDGE_PORTS = 2;
+const byte BRIDGE_NO_PORT = 0xFF;
+const byte DEFAULT_BRIDGE_QUEUE_SIZE = 8;
+const byte BRIDGE_NODE_TABLE_SIZE = 32;
+const byte MAX_BRIDGE_EVENT_FILTERS = 8;
+const byte DEFAULT_BRIDGE_FRAMES_PER_PROCESS = 4;
+
+/// Statistics for one port of a CanBridgeService.
+struct BridgePortStats
+{
+  unsigned int framesReceived;   ///< Frames received on this port.
+  unsigned int framesForwarded;  ///< Frames received on this port and queued for the other port.
+  unsigned int framesFiltered;   ///< Frames received on this port that were not forwarded.
+  unsigned int framesSent;       ///< Frames sent on this port.
+  unsigned int backpressure;     ///< Times reading stopped as the other port's queue was full.
+  unsigned int canidMoves;       ///< Times a CANID seen on this port was last seen on the other port.
+  byte queuePeak;                ///< Most frames waiting to be sent on this port.
+};
+
+/// @brief Forwards CAN frames between two CAN bus segments.
+///
+/// The bridge learns which segment each CANID and node number lives on from
+/// the frames it receives. Messages addressed to a node are only forwarded if
+/// the node is not known to be on the segment the message came from.
+/// Events are forwarded unless event filters are set up for the port they
+/// came from. Other frames are always forwarded.
+///
+/// Each port has a queue of frames waiting to be sent on it. If a queue is full
+/// the bridge stops reading from the other port until there is room again.
+///
+/// The bridge reads its ports directly and does not pass frames on to other services.
+class CanBridgeService : public Service
+{
+public:
+  CanBridgeService(CanTransport * port0, CanTransport * port1, byte queueSize = DEFAULT_BRIDGE_QUEUE_SIZE);
+
+  /// @cond LIBRARY
+  virtual VlcbServiceTypes getServiceID() const override { return SERVICE_ID_NONE; }
+  virtual byte getServiceVersionID() const override { return 1; }
+
+  virtual void process(const Action * action) override;
+  virtual bool acceptsMessage(const VlcbMessage * /*msg*/) override { return false; }
+  /// @endcond
+
+  /// Only forward events from fromPort if they match one of the filters for that port.
+  /// Events firstEvent to lastEvent from node nn match. A nn of 0 matches any node.
+  /// Returns false if there is no room for another filter.
+  bool addEventFilter(byte fromPort, unsigned int nn, unsigned int firstEvent, unsigned int lastEvent);
+  /// Forward all events again.
+  void clearEventFilters() { numEventFilters = 0; }
+  /// Set the maximum number of frames read from each port on each call to process().
+  void setMaxFramesPerProcess(byte maxFrames) { maxFramesPerProcess = maxFrames; }
+
+  /// Port where a CANID was last seen, or BRIDGE_NO_PORT if not known.
+  byte getCanidPort(byte canid) const { return canidPorts[canid & 0x7F]; }
+  /// Port where a node was last seen, or BRIDGE_NO_PORT if not known.
+  byte getNodePort(unsigned int nn) const;
+  /// Forget all learned CANIDs and node numbers.
+  void clearRoutes();
+
+  const BridgePortStats & getPortStats(byte port) const;
+  byte getQueueUsage(byte port);
+
+private:
+  struct Port
+  {
+    Port(CanTransport * transport, byte queueSize) : transport(transport), txQueue(queueSize), queueSize(queueSize) {}
+
+    CanTransport * transport;
+    CircularBuffer<CANFrame> txQueue;
+    byte queueSize;
+    BridgePortStats stats = {};
+  };
+
+  struct NodeRoute
+  {
+    unsigned int nn;
+    byte port;
+  };
+
+  struct EventFilter
+  {
+    byte fromPort;
+    unsigned int nn;
+    unsigned int firstEvent;
+    unsigned int lastEvent;
+  };
+
+  void receiveFrames(byte from);
+  void sendFrames(byte to);
+  bool shouldForward(byte from, const CANFrame & frame);
+  bool eventPassesFilters(byte from, const CANFrame & frame);
+  void learnCanid(byte port, byte canid);
+  void learnNode(byte port, unsigned int nn);
+
+  Port ports[BRIDGE_PORTS];
+  byte canidPorts[128];
+  NodeRoute nodeRoutes[BRIDGE_NODE_TABLE_SIZE];
+  byte numNodeRoutes = 0;
+  byte nextNodeRoute = 0;  // entry to replace when the table is full
+  EventFilter eventFilters[MAX_BRIDGE_EVENT_FILTERS];
+  byte numEventFilters = 0;
+  byte maxFramesPerProcess = DEFAULT_BRIDGE_FRAMES_PER_PROCESS;
+};
+
+}
@@ -11,7 +11,103 @@
 namespace VLCB
 {
 
-const int DEFAULT_PRIORITY = 0xB;     // default Controller messages priority. 1011 = 2|3 = normal/low
+const int DEFAULT_PRIORITY = CAN_PRIORITY_NORMAL;     // default Controller messages priority. 1011 = 2|3 = normal/low
+
+//
+/// the priority class for messages with this op-code
+//
+MessagePriority priorityForOpCode(byte opc)
+{
+  switch (opc)
+  {
+    case OPC_HLT:
+    case OPC_BON:
+    case OPC_TOF:
+    case OPC_TON:
+    case OPC_ESTOP:
+    case OPC_ARST:
+    case OPC_RTOF:
+    case OPC_RTON:
+    case OPC_RESTP:
+      return PRIORITY_EMERGENCY;
+
+    case OPC_ACON:
+    case OPC_ACOF:
+    case OPC_ASON:
+    case OPC_ASOF:
+    case OPC_ACON1:
+    case OPC_ACOF1:
+    case OPC_ASON1:
+    case OPC_ASOF1:
+    case OPC_ACON2:
+    case OPC_ACOF2:
+    case OPC_ASON2:
+    case OPC_ASOF2:
+    case OPC_ACON3:
+    case OPC_ACOF3:
+    case OPC_ASON3:
+    case OPC_ASOF3:
+    case OPC_ARON:
+    case OPC_AROF:
+    case OPC_ARSON:
+    case OPC_ARSOF:
+    case OPC_ARON1:
+    case OPC_AROF1:
+    case OPC_ARSON1:
+    case OPC_ARSOF1:
+    case OPC_ARON2:
+    case OPC_AROF2:
+    case OPC_ARSON2:
+    case OPC_ARSOF2:
+    case OPC_ARON3:
+    case OPC_AROF3:
+    case OPC_ARSON3:
+    case OPC_ARSOF3:
+    case OPC_ACDAT:
+      return PRIORITY_EVENT;
+
+    case OPC_DTXC:
+    case OPC_ENRSP:
+    case OPC_PARAN:
+    case OPC_PARAMS:
+    case OPC_NVANS:
+    case OPC_EVANS:
+    case OPC_NEVAL:
+    case OPC_NUMEV:
+    case OPC_EVNLF:
+    case OPC_DGN:
+    case OPC_NAME:
+    case OPC_SD:
+    case OPC_ESD:
+      return PRIORITY_BULK;
+
+    default:
+      return PRIORITY_NORMAL;
+  }
+}
+
+//
+/// the 4 CAN priority bits for a message
+//
+byte canPriority(MessagePriority priority, byte opc)
+{
+  if (priority == PRIORITY_DEFAULT)
+  {
+    priority = priorityForOpCode(opc);
+  }
+
+  switch (priority)
+  {
+    case PRIORITY_EMERGENCY:
+      return CAN_PRIORITY_EMERGENCY;
+    case PRIORITY_EVENT:
+      return CAN_PRIORITY_EVENT;
+    case PRIORITY_BULK:
+      return CAN_PRIORITY_BULK;
+    default:
+      return CAN_PRIORITY_NORMAL;
+  }
+}
 
 Service::Data CanService::getServiceData()
 {
@@ -21,7 +117,10 @@ Service::Data CanService::getServiceData()
 
 void CanService::process(const Action *action)
 {
-  checkIncomingCanFrame();
+  flushTransmitQueues();
+  checkIncomingCanFrames();
+  checkEnumerationResponse();
+  busLoadMeter.update();
 
   if (enumeration_required)
   {
@@ -40,7 +139,7 @@ void CanService::process(const Action *action)
   switch (action->actionType)
   {
     case ACT_MESSAGE_OUT:
-      sendMessage(&action->vlcbMessage);
+      sendMessage(&action->vlcbMessage, action->priority);
       break;
 
     case ACT_MESSAGE_IN:
@@ -56,6 +155,19 @@ void CanService::process(const Action *action)
   }
 }
 
+bool CanService::acceptsMessage(const VlcbMessage *msg)
+{
+  switch (msg->data[0])
+  {
+    case OPC_CANID:
+    case OPC_ENUM:
+      return isThisNodeNumber(Configuration::getTwoBytes(&msg->data[1]));
+
+    default:
+      return false;
+  }
+}
+
 void CanService::handleCanServiceMessage(const VlcbMessage *msg)
 {
   unsigned int opc = msg->data[0];
@@ -95,7 +207,7 @@ void CanService::handleSetCANID(const VlcbMessage *msg, unsigned int nn)
     return;
   }
 
-  controller->getModuleConfig()->setCANID(newCANID);
+  changeCANID(newCANID);
   controller->sendWRACK();
   controller->sendGRSP(OPC_CANID, getServiceID(), GRSP_OK);
 }
@@ -138,6 +250,8 @@ void CanService::startCANenumeration(bool fromENUM)
   // initiate CAN bus enumeration cycle, either due to ENUM opcode, ID clash, or user button press
   // DEBUG_SERIAL << F("> beginning self-enumeration cycle") << endl;
 
+  ++diagEnumerations;
+
   // set global variables
   bCANenum = true;                  // we are enumerating
   CANenumTime = millis();           // the cycle start time
@@ -149,19 +263,123 @@ void CanService::startCANenumeration(bool fromENUM)
   // DEBUG_SERIAL << F("> enumeration cycle initiated") << endl;
 }
 
-void CanService::checkIncomingCanFrame()
+CanService::~CanService()
 {
-  // Check concrete transport for messages and put on controller action queue.
-  if (!canTransport->available())
+  for (byte i = 0; i < MAX_CAN_TRANSPORTS; ++i)
   {
-    return;
+    delete txQueues[i];
+  }
+}
+
+bool CanService::addTransport(CanTransport * tpt, byte queueSize)
+{
+  if (numTransports >= MAX_CAN_TRANSPORTS)
+  {
+    return false;
   }
-  CANFrame canFrame = canTransport->getNextCanFrame();
 
+  if (numTransports == 1)
+  {
+    // The first transport only needs a queue when there are others to forward frames to it.
+    txQueues[0] = new CircularBuffer<CANFrame>(queueSize);
+  }
+  transports[numTransports] = tpt;
+  txQueues[numTransports] = new CircularBuffer<CANFrame>(queueSize);
+  ++numTransports;
+  return true;
+}
+
+unsigned int CanService::getTotalTransmitDrops() const
+{
+  unsigned int drops = 0;
+  for (byte i = 0; i < numTransports; ++i)
+  {
+    drops += diagTransmitDrops[i];
+  }
+  return drops;
+}
+
+//
+/// take frames from each transport until it is empty or the budget of messages for this call is used up
+//
+void CanService::checkIncomingCanFrames()
+{
+  for (byte origin = 0; origin < numTransports; ++origin)
+  {
+    receiveCanFrames(origin);
+  }
+}
+
+void CanService::receiveCanFrames(byte origin)
+{
+  CanTransport * transport = transports[origin];
+
+  // How far behind the transport is when we start taking frames.
+  unsigned int backlog = transport->receiveBufferUsage();
+  if (backlog > receiveBacklogPeak)
+  {
+    receiveBacklogPeak = backlog;
+  }
+
+  // Every frame taken counts against maxFramesReadPerProcess so that a storm of
+  // frames that are dropped does not keep us here. Frames put on the action queue
+  // also count against the smaller maxFramesPerProcess.
+  byte queued = 0;
+  for (byte read = 0; read < maxFramesReadPerProcess && queued < maxFramesPerProcess && transport->available(); ++read)
+  {
+    // Each message needs room for itself and an activity indication.
+    // Without room the frame can still be passed on to the other transports.
+    bool roomForLocal = controller->actionQueueHasSpace(2);
+    if (!roomForLocal && numTransports == 1)
+    {
+      break;
+    }
+
+    // Take the frame straight into the next free action so that the payload
+    // is not copied again on its way to the services.
+    Action * action = roomForLocal ? controller->reserveAction() : nullptr;
+    uint8_t forwardOnlyData[8];
+    uint8_t * data = roomForLocal ? action->vlcbMessage.data : forwardOnlyData;
+    CanFrameHeader header = transport->receiveCanFrame(data);
+    if (origin == 0)
+    {
+      busLoadMeter.countReceived(header);
+    }
+
+    // Frames are routed regardless of what this module's own services want.
+    if (numTransports > 1)
+    {
+      forwardCanFrame(origin, header, data);
+    }
+
+    if (!roomForLocal)
+    {
+      ++diagLocalReceiveDrops;
+      continue;
+    }
+    if (!transport->acceptsFrame(header))
+    {
+      // The transport could not filter this frame in hardware.
+      continue;
+    }
+    if (handleIncomingCanFrame(header, action))
+    {
+      ++queued;
+    }
+  }
+}
+
+//
+/// handle RTR and enumeration frames inline, put other frames on the controller action queue
+/// the payload has already been received into the reserved action
+/// returns true if the frame was put on the action queue
+//
+bool CanService::handleIncomingCanFrame(const CanFrameHeader & canFrame, Action * action)
+{
   // is this an extended frame ? we currently ignore these as bootloader, etc data may confuse us !
   if (canFrame.ext)
   {
-    return;
+    return false;
   }
 
   // is this a CANID enumeration request from another node (RTR set) ?
@@ -170,13 +388,20 @@ void CanService::checkIncomingCanFrame()
     // DEBUG_SERIAL << F("> CANID enumeration RTR from CANID = ") << remoteCANID << endl;
     // send an empty canFrame to show our CANID
 
-    sendEmptyFrame();
+    if (enumerationResponseWindow == 0)
+    {
+      sendEmptyFrame();
+    }
+    else if (!enumerationResponsePending)
+    {
+      // reply later so that all nodes do not reply at the same time.
+      enumerationResponsePending = true;
+      enumerationRequestTime = millis();
+    }
 
-    return;
+    return false;
   }
 
-  controller->indicateActivity();
-
   byte remoteCANID = getCANID(canFrame.id);
 
   /// set flag if we find a CANID conflict with the frame's producer
@@ -185,8 +410,11 @@ void CanService::checkIncomingCanFrame()
   {
     // DEBUG_SERIAL << F("> CAN id clash, enumeration required") << endl;
     enumeration_required = true;
+    ++diagCanidConflicts;
   }
 
+  bool queued = false;
+
   // are we enumerating CANIDs ?
   if (bCANenum && canFrame.len == 0)
   {
@@ -197,15 +425,29 @@ void CanService::checkIncomingCanFrame()
       bitWrite(enum_responses[(remoteCANID / 8)], remoteCANID % 8, 1);
       // DEBUG_SERIAL << F("> stored CANID ") << remoteCANID << F(" at index = ") << (remoteCANID / 8) << F(", bit = ") << (remoteCANID % 8) << endl;
     }
-
-    return;
   }
+  else
+  {
+    // The incoming CAN frame is a VLCB message.
+    action->actionType = ACT_MESSAGE_IN;
+    action->vlcbMessage.len = canFrame.len;
+    action->priority = PRIORITY_DEFAULT;
 
-  // The incoming CAN frame is a VLCB message.
-  Action action = {ACT_MESSAGE_IN, {canFrame.len}};
-  memcpy(action.vlcbMessage.data, canFrame.data, canFrame.len);
+    // Drop messages that no service would act on so that they don't fill up the action queue.
+    if (receiveFilter && !controller->acceptsMessage(&action->vlcbMessage))
+    {
+      ++diagFilteredFrames;
+    }
+    else
+    {
+      controller->putReservedAction();
+      queued = true;
+    }
+  }
 
-  controller->putAction(action);
+  // Indicate activity after the message is queued as the indication uses the next free action.
+  controller->indicateActivity();
+  return queued;
 }
 
 /// actual implementation of the makeHeader method
@@ -217,22 +459,118 @@ inline uint32_t makeHeader_impl(byte id, byte priority)
   return (priority << 7) + (id & 0x7f);
 }
 
-bool CanService::sendMessage(const VlcbMessage *msg)
+bool CanService::sendMessage(const VlcbMessage *msg, MessagePriority priority)
 {
   // caller must populate the frame data
   // this method will create the correct frame header (CAN ID and priority bits)
   // rtr and ext default to false unless arguments are supplied - see method definition in .h
-  // priority defaults to 1011 low/medium
+  // priority is taken from the op-code unless given by the caller
 
-  CANFrame frame;
-  frame.id = makeHeader_impl(controller->getModuleCANID(), DEFAULT_PRIORITY);
-  frame.len = msg->len;
-  frame.rtr = false;
-  frame.ext = false;
-  memcpy(frame.data, msg->data, msg->len);
+  // The payload is sent straight from the message in the action queue.
+  CanFrameHeader header;
+  header.id = makeHeader_impl(controller->getModuleCANID(), canPriority(priority, msg->len > 0 ? msg->data[0] : 0));
+  header.len = msg->len;
+  header.rtr = false;
+  header.ext = false;
 
   controller->indicateActivity();
-  return sendCanFrame(&frame);
+  return sendCanFrame(header, msg->data);
+}
+
+//
+/// send a frame from this module on all transports
+/// returns true if the frame was sent or queued on at least one transport
+//
+bool CanService::sendCanFrame(const CanFrameHeader & header, const uint8_t data[])
+{
+  bool sent = false;
+  for (byte i = 0; i < numTransports; ++i)
+  {
+    if (sendOnTransport(i, header, data))
+    {
+      sent = true;
+    }
+  }
+  return sent;
+}
+
+//
+/// send a frame at once if nothing is waiting on the transport, otherwise queue it
+/// a transport without a queue reports failures to the caller as before
+//
+bool CanService::sendOnTransport(byte index, const CanFrameHeader & header, const uint8_t data[])
+{
+  CircularBuffer<CANFrame> * txQueue = txQueues[index];
+  if (txQueue == nullptr || !txQueue->available())
+  {
+    if (transports[index]->transmitCanFrame(header, data))
+    {
+      if (index == 0)
+      {
+        busLoadMeter.countTransmitted(header);
+      }
+      return true;
+    }
+    if (txQueue == nullptr)
+    {
+      return false;
+    }
+  }
+
+  CANFrame * frame = txQueue->reserve();
+  if (frame == nullptr)
+  {
+    ++diagTransmitDrops[index];
+    return false;
+  }
+  frame->id = header.id;
+  frame->ext = header.ext;
+  frame->rtr = header.rtr;
+  frame->len = header.len;
+  memcpy(frame->data, data, header.len);
+  txQueue->commit();
+  return true;
+}
+
+//
+/// pass a received frame on to all transports except the one it came from
+//
+void CanService::forwardCanFrame(byte origin, const CanFrameHeader & header, const uint8_t data[])
+{
+  for (byte i = 0; i < numTransports; ++i)
+  {
+    if (i != origin)
+    {
+      sendOnTransport(i, header, data);
+    }
+  }
+  ++diagForwardedFrames[origin];
+}
+
+//
+/// send queued frames until a transport refuses one
+//
+void CanService::flushTransmitQueues()
+{
+  for (byte i = 0; i < numTransports; ++i)
+  {
+    CircularBuffer<CANFrame> * txQueue = txQueues[i];
+    while (txQueue != nullptr && txQueue->available())
+    {
+      const CANFrame * frame = txQueue->peek();
+      CanFrameHeader header = {frame->id, frame->ext, frame->rtr, frame->len};
+      if (!transports[i]->transmitCanFrame(header, frame->data))
+      {
+        // Try again on the next call to process().
+        break;
+      }
+      if (i == 0)
+      {
+        busLoadMeter.countTransmitted(header);
+      }
+      txQueue->pop();
+    }
+  }
 }
 
 bool CanService::sendRtrFrame()
@@ -242,13 +580,14 @@ bool CanService::sendRtrFrame()
 
 bool CanService::sendEmptyFrame(bool rtr)
 {
-  CANFrame frame;
-  frame.id = makeHeader_impl(controller->getModuleCANID(), DEFAULT_PRIORITY);
-  frame.rtr = rtr;
-  frame.ext = false;
-  frame.len = 0;
-
-  return sendCanFrame(&frame);
+  CanFrameHeader header;
+  header.id = makeHeader_impl(controller->getModuleCANID(), DEFAULT_PRIORITY);
+  header.rtr = rtr;
+  header.ext = false;
+  header.len = 0;
+
+  const uint8_t noData[1] = {0};
+  return sendCanFrame(header, noData);
 }
 
 void CanService::checkCANenumTimout()
@@ -264,13 +603,19 @@ void CanService::checkCANenumTimout()
     // DEBUG_SERIAL << F("> processing received responses") << endl;
 
     byte selected_id = findFreeCanId();
+    if (selected_id == 0)
+    {
+      // All CANIDs are taken.
+      ++diagEnumerationFailures;
+      selected_id = 1;
+    }
 
     // DEBUG_SERIAL << F("> lowest available CAN id = ") << selected_id << endl;
 
     bCANenum = false;
 
     // store the new CAN ID
-    controller->getModuleConfig()->setCANID(selected_id);
+    changeCANID(selected_id);
 
     // send NNACK if initiated by ENUM request.
     if (startedFromEnumMessage)
@@ -280,6 +625,16 @@ void CanService::checkCANenumTimout()
   }
 }
 
+void CanService::checkEnumerationResponse()
+{
+  if (enumerationResponsePending
+      && (millis() - enumerationRequestTime) >= controller->responseDelay(enumerationResponseWindow))
+  {
+    enumerationResponsePending = false;
+    sendEmptyFrame();
+  }
+}
+
 byte CanService::findFreeCanId()
 {
   // iterate through the 128 bit field
@@ -310,7 +665,16 @@ byte CanService::findFreeCanId()
     }
   }
 
-  return 1;     // default if no responses from other modules
+  return 0;     // no free CAN ID
+}
+
+void CanService::changeCANID(byte newCANID)
+{
+  if (newCANID != controller->getModuleCANID())
+  {
+    ++diagCanidChanges;
+  }
+  controller->getModuleConfig()->setCANID(newCANID);
 }
 
 }
\ No newline at end of file
@@ -7,6 +7,9 @@
 
 #include "Service.h"
 #include "CanTransport.h"
+#include "Controller.h"
+#include "BusLoadMeter.h"
+#include "CircularBuffer.h"
 #include <vlcbdefs.hpp>
 
 namespace VLCB
@@ -14,6 +17,21 @@ namespace VLCB
 
 struct VlcbMessage;
 
+/// CAN priority bits for the message priority classes.
+/// 4 bits made up of 2 bits major priority and 2 bits minor priority.
+const byte CAN_PRIORITY_EMERGENCY = 0x3;  // 00 11 high
+const byte CAN_PRIORITY_EVENT = 0x9;      // 10 01 normal, above other normal traffic
+const byte CAN_PRIORITY_NORMAL = 0xB;     // 10 11 normal/low
+const byte CAN_PRIORITY_BULK = 0xF;       // 11 11 low
+
+MessagePriority priorityForOpCode(byte opc);
+byte canPriority(MessagePriority priority, byte opc);
+
+const byte DEFAULT_MAX_FRAMES_PER_PROCESS = 4;
+const byte DEFAULT_MAX_FRAMES_READ_PER_PROCESS = 16;
+const byte MAX_CAN_TRANSPORTS = 3;
+const byte DEFAULT_TRANSPORT_QUEUE_SIZE = 8;
+
 /// @brief Service for sending and receiving messages on a CAN bus
 /// 
 /// Delegates to a CanTransport object to do the actual transmission on the CAN bus.
@@ -24,6 +42,12 @@ struct VlcbMessage;
 /// It also puts incoming CANFrame's on to the ActionQueue as a VlcbMessage,
 /// and gets outgoing VlcbMessage from the ActionQueue and passes it to the CanTransport 
 /// object for transmission on the CAN bus.
+///
+/// More transports can be added, such as a GridConnect serial link next to the
+/// CAN bus. Frames received on one transport are passed on to all other
+/// transports and to the services of this module. Messages from the services
+/// are sent on all transports.
+/// Each transport has a queue of frames that it could not send at once.
 /// @endcond 
 class CanService : public Service
 {
@@ -31,17 +55,73 @@ class CanService : public Service
 public:
   /// Construct a CanService with a concrete CanTransport object to use for 
   /// transmission on the CAN bus.
-  CanService(CanTransport * tpt) : canTransport(tpt) {}
+  CanService(CanTransport * tpt) : canTransport(tpt), transports{tpt} {}
+  virtual ~CanService();
 
   /// @cond LIBRARY
   virtual VlcbServiceTypes getServiceID() const override { return SERVICE_ID_CAN; }
-  virtual byte getServiceVersionID() const override { return 2; }
+  virtual byte getServiceVersionID() const override { return 3; }
   virtual Data getServiceData();
 
   virtual void process(const Action * action) override;
+  virtual bool acceptsMessage(const VlcbMessage *msg) override;
+  /// @endcond
+
+  /// Set the maximum number of incoming messages taken from the CAN transport
+  /// and put on the action queue on each call to process(). RTR, enumeration and
+  /// dropped frames are handled inline and do not count against this limit.
+  void setMaxFramesPerProcess(byte maxFrames) { maxFramesPerProcess = maxFrames; }
+  /// Set the maximum number of frames of any kind taken from each transport on
+  /// each call to process(). This bounds the time spent when the bus is flooded
+  /// with frames that are dropped.
+  void setMaxFramesReadPerProcess(byte maxFrames) { maxFramesReadPerProcess = maxFrames; }
+  /// Largest number of frames found waiting in a transport receive buffer at the start of process().
+  /// Compare with the transport receive buffer size to see how far behind the module gets.
+  unsigned int getReceiveBacklogPeak() const { return receiveBacklogPeak; }
+  /// Drop incoming messages that no service would act on before they are put
+  /// on the action queue. Enabled by default.
+  void setReceiveFilter(bool enable) { receiveFilter = enable; }
+  /// Number of incoming messages dropped by the receive filter.
+  unsigned int getFilteredFrameCount() const { return diagFilteredFrames; }
+  /// Spread replies to CANID enumeration requests over a window instead of
+  /// replying at once. Must be shorter than the 100ms enumeration cycle.
+  /// A window of 0 (the default) replies at once.
+  void setEnumerationResponseWindow(byte windowMillis) { enumerationResponseWindow = windowMillis; }
+  /// Bus load estimated from the frames sent and received by this module.
+  /// Set the bit rate on the meter if the bus does not run at 125kbit/s.
+  BusLoadMeter & getBusLoadMeter() { return busLoadMeter; }
+
+  /// Add another transport that frames are routed to and from.
+  /// The transport given to the constructor is transport 0 and is used for
+  /// the bus load meter and diagnostics.
+  /// Returns false if there is no room for another transport.
+  bool addTransport(CanTransport * tpt, byte queueSize = DEFAULT_TRANSPORT_QUEUE_SIZE);
+  byte getTransportCount() const { return numTransports; }
+  CanTransport * getTransport(byte index) const { return transports[index]; }
+  /// Number of frames received on this transport and passed on to other transports.
+  unsigned int getForwardedFrames(byte index) const { return diagForwardedFrames[index]; }
+  /// Number of frames not sent on this transport because its queue was full.
+  unsigned int getTransmitDrops(byte index) const { return diagTransmitDrops[index]; }
+  /// Number of frames passed on to other transports but not to this module's
+  /// services because the action queue was full.
+  unsigned int getLocalReceiveDrops() const { return diagLocalReceiveDrops; }
+  /// Total number of frames dropped on all transports.
+  unsigned int getTotalTransmitDrops() const;
 
+  /// @cond LIBRARY
 protected:
   CanTransport * canTransport;
+
+  unsigned int diagEnumerations = 0;
+  unsigned int diagCanidConflicts = 0;
+  unsigned int diagCanidChanges = 0;
+  unsigned int diagEnumerationFailures = 0;
+  unsigned int diagFilteredFrames = 0;
+  unsigned int diagLocalReceiveDrops = 0;
+  unsigned int diagForwardedFrames[MAX_CAN_TRANSPORTS] = {};
+  unsigned int diagTransmitDrops[MAX_CAN_TRANSPORTS] = {};
+
+  BusLoadMeter busLoadMeter;
   /// @endcond 
 
 private:
@@ -49,21 +129,41 @@ private:
   void handleEnumeration(unsigned int nn);
   void handleSetCANID(const VlcbMessage *msg, unsigned int nn);
 
-  bool sendMessage(const VlcbMessage *msg);
+  bool sendMessage(const VlcbMessage *msg, MessagePriority priority);
   bool sendRtrFrame();
   bool sendEmptyFrame(bool rtr = false);
-  bool sendCanFrame(CANFrame *msg) { return canTransport->sendCanFrame(msg); }
+  bool sendCanFrame(const CanFrameHeader & header, const uint8_t data[]);
   void startCANenumeration(bool fromENUM = false);
 
-  void checkIncomingCanFrame();
+  bool sendOnTransport(byte index, const CanFrameHeader & header, const uint8_t data[]);
+  void forwardCanFrame(byte origin, const CanFrameHeader & header, const uint8_t data[]);
+  void flushTransmitQueues();
+
+  void checkIncomingCanFrames();
+  void receiveCanFrames(byte origin);
+  bool handleIncomingCanFrame(const CanFrameHeader & canFrame, Action * action);
   void checkCANenumTimout();
+  void checkEnumerationResponse();
   byte findFreeCanId();
+  void changeCANID(byte newCANID);
 
   bool enumeration_required = false;
   bool bCANenum = false;
   bool startedFromEnumMessage = false;
   unsigned long CANenumTime;
   byte enum_responses[16];     // 128 bits for storing CAN ID enumeration results
+  bool receiveFilter = true;
+  byte enumerationResponseWindow = 0;
+  bool enumerationResponsePending = false;
+  unsigned long enumerationRequestTime;
+  byte maxFramesPerProcess = DEFAULT_MAX_FRAMES_PER_PROCESS;
+  byte maxFramesReadPerProcess = DEFAULT_MAX_FRAMES_READ_PER_PROCESS;
+  unsigned int receiveBacklogPeak = 0;
+
+  CanTransport * transports[MAX_CAN_TRANSPORTS];
+  // Frames waiting to be sent on each transport. Only used with more than one transport.
+  CircularBuffer<CANFrame> * txQueues[MAX_CAN_TRANSPORTS] = {};
+  byte numTransports = 1;
 };
 
 }
@@ -30,33 +30,73 @@ void CanServiceWithDiagnostics::reportDiagnostics(byte serviceIndex, byte diagno
     case 0x04: // Tx buffer current usage count
       diagnosticsValue = canTransport->transmitBufferUsage();
       break;
+    case 0x05: // Tx buffer overrun count
+      diagnosticsValue = canTransport->transmitDropCounter();
+      break;
     case 0x06: // TX message count
       diagnosticsValue = canTransport->transmitCounter();
       break;
     case 0x07: // RX buffer current usage count
       diagnosticsValue = canTransport->receiveBufferUsage();
       break;
+    case 0x08: // RX buffer overrun count
+      diagnosticsValue = canTransport->receiveOverrunCounter();
+      break;
     case 0x09: // RX message counter
       diagnosticsValue = canTransport->receiveCounter();
       break;
-    case 0x11: // Transmit buffers used high watermark - Added in service version 2
-      diagnosticsValue = canTransport->transmitBufferPeak();
-      break;
-    case 0x12: // Receive buffers used high watermark - Added in service version 2
-      diagnosticsValue = canTransport->receiveBufferPeak();
-      break;
-
-    // Diagnostics codes not yet implemented
-    case 0x05: // Tx buffer overrun count
-    case 0x08: // RX buffer overrun count
     case 0x0A: // CAN error frames detected
+      diagnosticsValue = canTransport->errorFramesDetected();
+      break;
     case 0x0B: // CAN error frames generated (both active and passive ?)
-    case 0x0C: // number of times CAN arbitration was lost
+      diagnosticsValue = canTransport->errorFramesGenerated();
+      break;
+    case 0x0C: // number of times CAN arbitration was lost. Approximated by the number of frames
+               // that had to wait for a free transmit buffer.
+      diagnosticsValue = canTransport->transmitRetryCounter();
+      break;
     case 0x0D: // number of CANID enumerations
+      diagnosticsValue = diagEnumerations;
+      break;
     case 0x0E: // number of CANID conflicts detected
+      diagnosticsValue = diagCanidConflicts;
+      break;
     case 0x0F: // the number of CANID changes
+      diagnosticsValue = diagCanidChanges;
+      break;
     case 0x10: // the number of CANID enumeration failures
-      diagnosticsValue = 0;
+      diagnosticsValue = diagEnumerationFailures;
+      break;
+    case 0x11: // Transmit buffers used high watermark - Added in service version 2
+      diagnosticsValue = canTransport->transmitBufferPeak();
+      break;
+    case 0x12: // Receive buffers used high watermark - Added in service version 2
+      diagnosticsValue = canTransport->receiveBufferPeak();
+      break;
+    // Codes below were added in service version 3. Loads are in units of 0.1%.
+    case 0x13: // RX bus load over the last second
+      diagnosticsValue = busLoadMeter.getReceiveLoad();
+      break;
+    case 0x14: // TX bus load over the last second
+      diagnosticsValue = busLoadMeter.getTransmitLoad();
+      break;
+    case 0x15: // RX bus load averaged over the last 10 seconds
+      diagnosticsValue = busLoadMeter.getReceiveLoad10s();
+      break;
+    case 0x16: // TX bus load averaged over the last 10 seconds
+      diagnosticsValue = busLoadMeter.getTransmitLoad10s();
+      break;
+    case 0x17: // Frames per second, RX and TX
+      diagnosticsValue = busLoadMeter.getFramesPerSecond();
+      break;
+    case 0x18: // Peak number of frames in any 100ms period
+      diagnosticsValue = busLoadMeter.getPeakFramesPerSlot();
+      break;
+    case 0x19: // Incoming messages dropped as no service would act on them
+      diagnosticsValue = diagFilteredFrames;
+      break;
+    case 0x1A: // Frames dropped as a transport's transmit queue was full, all transports
+      diagnosticsValue = getTotalTransmitDrops();
       break;
 
     default:
@@ -69,7 +109,7 @@ void CanServiceWithDiagnostics::reportDiagnostics(byte serviceIndex, byte diagno
 
 void CanServiceWithDiagnostics::reportAllDiagnostics(byte serviceIndex)
 {
-  byte diagCount = 18;
+  byte diagCount = 0x1A;
   controller->sendDGN(serviceIndex, 0, diagCount);
   for (byte i = 1; i <= diagCount ; ++i)
   {
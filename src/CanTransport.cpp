@@ -0,0 +1,83 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+#include "CanTransport.h"
+
+namespace VLCB
+{
+
+bool CanTransport::setAcceptanceFilters(const CanAcceptanceFilter filters[], byte count)
+{
+  if (count > MAX_ACCEPTANCE_FILTERS)
+  {
+    return false;
+  }
+
+  for (byte i = 0; i < count; ++i)
+  {
+    acceptanceFilters[i] = filters[i];
+  }
+  numAcceptanceFilters = count;
+  return true;
+}
+
+CanFrameHeader CanTransport::receiveCanFrame(uint8_t data[])
+{
+  CANFrame frame = getNextCanFrame();
+  return CanFrameAdapter<CANFrame>::read(frame, data);
+}
+
+bool CanTransport::transmitCanFrame(const CanFrameHeader & header, const uint8_t data[])
+{
+  CANFrame frame;
+  CanFrameAdapter<CANFrame>::write(frame, header, data);
+  return sendCanFrame(&frame);
+}
+
+bool CanTransport::acceptsFrame(const CanFrameHeader & header)
+{
+  if (numAcceptanceFilters == 0)
+  {
+    return true;
+  }
+
+  // Filters only match standard frames.
+  if (header.ext)
+  {
+    return false;
+  }
+
+  // CANID enumeration needs these from all nodes.
+  if (header.rtr || header.len == 0)
+  {
+    return true;
+  }
+
+  for (byte i = 0; i < numAcceptanceFilters; ++i)
+  {
+    const CanAcceptanceFilter & filter = acceptanceFilters[i];
+    if (((header.id ^ filter.id) & filter.mask) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool CanTransport::filtersPassEnumeration()
+{
+  for (byte i = 0; i < numAcceptanceFilters; ++i)
+  {
+    const CanAcceptanceFilter & filter = acceptanceFilters[i];
+    if ((filter.mask & ~ENUMERATION_ACCEPTANCE_FILTER.mask & 0x7FF) == 0
+        && ((filter.id ^ ENUMERATION_ACCEPTANCE_FILTER.id) & filter.mask & 0x7FF) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+}
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <Arduino.h>
+#include <string.h>
 #include "Transport.h"
 
 namespace VLCB
@@ -25,6 +26,55 @@ struct CANFrame
   uint8_t len;
   uint8_t data[8];
 };
+
+/// The header fields of a CAN frame.
+/// Used with a separate payload buffer so that the payload is copied only once
+/// between the transport's own data structure and the action queue.
+struct CanFrameHeader
+{
+  uint32_t id;
+  bool ext;
+  bool rtr;
+  uint8_t len;
+};
+
+/// @brief Copies between a transport specific frame type and a header with payload.
+///
+/// Works with any frame type that has id, ext, rtr, len and data members
+/// such as CANFrame and the ACAN2515 CANMessage.
+/// Specialise this template for frame types with a different layout.
+template <typename Frame>
+struct CanFrameAdapter
+{
+  static CanFrameHeader read(const Frame & frame, uint8_t data[])
+  {
+    memcpy(data, frame.data, frame.len);
+    return {frame.id, frame.ext, frame.rtr, frame.len};
+  }
+
+  static void write(Frame & frame, const CanFrameHeader & header, const uint8_t data[])
+  {
+    frame.id = header.id;
+    frame.ext = header.ext;
+    frame.rtr = header.rtr;
+    frame.len = header.len;
+    memcpy(frame.data, data, header.len);
+  }
+};
+
+/// An acceptance filter for standard CAN frames.
+/// A frame matches if the bits selected by mask are equal in the frame id and the filter id.
+struct CanAcceptanceFilter
+{
+  uint16_t mask;
+  uint16_t id;
+};
+
+const byte MAX_ACCEPTANCE_FILTERS = 6;  // as many as the MCP2515 has
+
+/// Passes CANID enumeration requests and replies from all CANIDs. These are sent with normal priority (0xB).
+/// Hardware filters must include this filter as they cannot select frames by RTR or length.
+const CanAcceptanceFilter ENUMERATION_ACCEPTANCE_FILTER = {0x780, 0x580};
 /// @endcond 
 
 /// @brief Interface base class for CAN transport implementations.
@@ -37,8 +87,39 @@ public:
   virtual bool available() = 0; ///< Check if an incoming CAN frame is available on the CAN bus.
   virtual CANFrame getNextCanFrame() = 0; ///< Get the next CAN frame from the CAN bus.
   virtual bool sendCanFrame(CANFrame *msg) = 0; ///< Send a CAN frame to the CAN bus. 
+  /// Get the next CAN frame with its payload copied to data which has room for 8 bytes.
+  /// Override to copy straight from the transport's own frame type.
+  virtual CanFrameHeader receiveCanFrame(uint8_t data[]);
+  /// Send a CAN frame given as a header and payload.
+  /// Override to copy straight into the transport's own frame type.
+  virtual bool transmitCanFrame(const CanFrameHeader & header, const uint8_t data[]);
 
   inline virtual byte getHardwareType() { return 0; } ///< Get the hardware type of the concrete transport class.
+
+  virtual unsigned int transmitRetryCounter() { return 0; } ///< Number of frames that had to wait for a free transmit buffer.
+  virtual unsigned int transmitDropCounter() { return 0; } ///< Number of frames dropped as all transmit buffers were full.
+  virtual unsigned int receiveOverrunCounter() { return 0; } ///< Number of times received frames were lost as the receive buffer was full.
+  virtual unsigned int errorFramesDetected() { return 0; } ///< Number of CAN error frames seen on the bus.
+  virtual unsigned int errorFramesGenerated() { return 0; } ///< Number of CAN error frames sent by this node.
+  /// @endcond 
+
+  /// Only receive standard frames that match one of the given filters.
+  /// A count of 0 receives all frames.
+  /// Implementations may filter in hardware. Otherwise frames are filtered by CanService.
+  /// Returns false if there are more than MAX_ACCEPTANCE_FILTERS filters.
+  virtual bool setAcceptanceFilters(const CanAcceptanceFilter filters[], byte count);
+  /// @cond LIBRARY
+  /// Software filtering for frames that were not filtered in hardware.
+  /// CANID enumeration requests (RTR) and replies (zero length) are always accepted.
+  virtual bool acceptsFrame(const CanFrameHeader & header);
+  /// @endcond 
+
+protected:
+  /// @cond LIBRARY
+  /// True if a filter passes ENUMERATION_ACCEPTANCE_FILTER.
+  bool filtersPassEnumeration();
+  CanAcceptanceFilter acceptanceFilters[MAX_ACCEPTANCE_FILTERS];
+  byte numAcceptanceFilters = 0;
   /// @endcond 
 };
 
@@ -21,7 +21,10 @@ public:
   E *peek();
   const E & pop();
   void put(const E &entry);
+  E *reserve();
+  void commit();
   void clear();
+  uint8_t bufUse();
 
   // Diagnostic metrics access
   unsigned int getNumberOfPuts();
@@ -30,8 +33,6 @@ public:
   unsigned int getHighWaterMark();   // High Watermark
 
 private:
-  uint8_t bufUse();
-
   uint8_t capacity;
   uint8_t head = 0;
   uint8_t tail = 0;
@@ -73,7 +74,21 @@ void CircularBuffer<E>::put(const E &msg)
 {
 //  E msg;
   buffer[head] = msg;
+  commit();
+}
+
+/// the slot that the next item will be stored in, or nullptr if the buffer is full
+/// fill in the slot and call commit() to store it without copying
+template <typename E>
+E *CircularBuffer<E>::reserve()
+{
+  return full ? nullptr : &buffer[head];
+}
 
+/// store the item that has been filled in at the reserved slot
+template <typename E>
+void CircularBuffer<E>::commit()
+{
   if (full)
   {
     // if the buffer is full, this put will overwrite the oldest item
@@ -484,6 +484,9 @@ void (*rebootFunc)() = 0;  // just causes a jump to address zero - not a full ch
 
 void Configuration::reboot()
 {
+  // don't lose any writes that are waiting to be committed
+  storage->flush();
+
 #ifdef __AVR__
 
 // for newer AVR Xmega, e.g. AVR-DA
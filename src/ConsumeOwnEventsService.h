@@ -32,6 +32,7 @@ public:
 
   virtual void process(const Action * action) override
   {}
+  virtual bool acceptsMessage(const VlcbMessage * /*msg*/) override { return false; }
   /// @endcond 
 };
 
@@ -27,6 +27,30 @@ namespace VLCB
 // be sent through the transport without requiring this buffering. 
 const int ACTION_QUEUE_SIZE = 30;
 
+//
+/// true for incoming messages that may change which messages the services accept
+//
+static bool changesModuleState(const Action & action)
+{
+  if (action.actionType != ACT_MESSAGE_IN)
+  {
+    return false;
+  }
+
+  switch (action.vlcbMessage.data[0])
+  {
+    case OPC_EVLRN:
+    case OPC_EVLRNI:
+    case OPC_EVULN:
+    case OPC_NNCLR:
+    case OPC_SNN:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
 
 //Controller::Controller()
 //  : services()
@@ -162,13 +186,9 @@ void Controller::indicateActivity()
 void Controller::process()
 {
   //Serial << F("Ctrl::process() start, pAction queue size = ") << actionQueue.size();
-  const Action * pAction = nullptr;
-  Action action;
-  if (actionQueue.available())
-  {
-    action = actionQueue.pop();
-    pAction = &action;
-  }
+  // Services see the action where it is in the queue. It stays there until all services
+  // have processed it so that new actions cannot be stored on top of it.
+  const Action * pAction = actionQueue.peek();
   //Serial << F(" pAction type = ");
   //if (pAction) Serial << pAction->actionType; else Serial << F("null");
   //Serial << endl;
@@ -177,14 +197,30 @@ void Controller::process()
   {
     service->process(pAction);
   }
+  if (pAction != nullptr)
+  {
+    if (changesModuleState(*pAction))
+    {
+      --pendingStateChanges;
+    }
+    actionQueue.pop();
+  }
   
   module_config->commitToEEPROM();
 }
 
-bool Controller::sendMessage(const VlcbMessage *msg)
+bool Controller::sendMessage(const VlcbMessage *msg, MessagePriority priority)
 {
-  Action action = {ACT_MESSAGE_OUT, *msg};
-  actionQueue.put(action);
+  // Copy the message straight into the queue.
+  Action * action = reserveAction();
+  if (action == nullptr)
+  {
+    return false;
+  }
+  action->actionType = ACT_MESSAGE_OUT;
+  action->vlcbMessage = *msg;
+  action->priority = priority;
+  putReservedAction();
   return true;
 }
 
@@ -235,7 +271,13 @@ void Controller::sendDGN(byte serviceIndex, byte diagCode, unsigned int counter)
 void Controller::putAction(const Action &action)
 {
   // Serial << F("C>put action with type=") << action.actionType << endl;
-  actionQueue.put(action);
+  // Drop the new action if the queue is full. The oldest action may be in use by a service.
+  Action * slot = reserveAction();
+  if (slot != nullptr)
+  {
+    *slot = action;
+    putReservedAction();
+  }
 }
 
 void Controller::putAction(ACTION action)
@@ -243,11 +285,47 @@ void Controller::putAction(ACTION action)
   putAction(Action{action});
 }
 
+void Controller::putReservedAction()
+{
+  const Action * action = actionQueue.reserve();
+  if (action != nullptr && changesModuleState(*action))
+  {
+    ++pendingStateChanges;
+  }
+  actionQueue.commit();
+}
+
 bool Controller::pendingAction()
 {
   return actionQueue.available();
 }
 
+bool Controller::actionQueueHasSpace(byte count)
+{
+  return actionQueue.bufUse() + count <= ACTION_QUEUE_SIZE;
+}
+
+//
+/// true if any service would act on this incoming message
+//
+bool Controller::acceptsMessage(const VlcbMessage *msg)
+{
+  // A queued message may add the event or set the node number that this message is for.
+  if (pendingStateChanges > 0)
+  {
+    return true;
+  }
+
+  for (Service *service: services)
+  {
+    if (service->acceptsMessage(msg))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
 void Controller::messageActedOn()
 {
   putAction(ACT_INDICATE_WORK);
@@ -42,8 +42,24 @@ enum ACTION : byte
   // ...
 };
 
+/// Priority class for outgoing messages.
+/// Transports map these to their own priority scheme, e.g. CAN arbitration priority.
+enum MessagePriority : byte
+{
+  PRIORITY_DEFAULT = 0, // Use the priority that is set for the op-code.
+  PRIORITY_EMERGENCY,   // Emergency stop and track control.
+  PRIORITY_EVENT,       // Accessory events. Shall win over bulk data.
+  PRIORITY_NORMAL,      // Anything else.
+  PRIORITY_BULK         // Configuration replies and streamed data.
+};
+
 struct Action
 {
+  Action() = default;
+  Action(ACTION actionType) : actionType(actionType) {}
+  Action(ACTION actionType, const VlcbMessage & vlcbMessage) : actionType(actionType), vlcbMessage(vlcbMessage) {}
+  Action(ACTION actionType, bool fromENUM) : actionType(actionType), fromENUM(fromENUM) {}
+
   enum ACTION actionType;
   union
   {
@@ -51,6 +67,7 @@ struct Action
     bool fromENUM; // with ACT_START_CAN_ENUMERATION
     VlcbModeParams mode; // with ACT_INDICATE_MODE
   };
+  MessagePriority priority = PRIORITY_DEFAULT; // with ACT_MESSAGE_OUT
 };
 
 class Service;
@@ -79,7 +96,7 @@ public:
   Parameters & getParams() { return module_config->getParams(); }
   unsigned char getParam(VlcbParams param) const { return module_config->getParam(param); }
 
-  bool sendMessage(const VlcbMessage *msg);
+  bool sendMessage(const VlcbMessage *msg, MessagePriority priority = PRIORITY_DEFAULT);
 
   void begin();
   inline bool sendMessageWithNN(VlcbOpCodes opc);
@@ -94,13 +111,23 @@ public:
   void sendDGN(byte serviceIndex, byte diagCode, unsigned int counter);
 
   byte getModuleCANID() const { return module_config->CANID; }
+  /// Delay within a window for this node's reply to a broadcast request.
+  /// Nodes are spread by CANID so that nodes with different CANIDs do not reply at the same time.
+  unsigned int responseDelay(unsigned int windowMillis) const { return (unsigned long) (getModuleCANID() & 0x7F) * windowMillis / 128; }
   void process();
   void indicateMode(VlcbModeParams mode);
   void indicateActivity();
   
   void putAction(const Action & action);
   void putAction(ACTION action);
+  /// Next free slot in the action queue, or nullptr if the queue is full.
+  /// Fill it in place and call putReservedAction() to avoid copying the action.
+  Action * reserveAction() { return actionQueue.reserve(); }
+  void putReservedAction();
   bool pendingAction();
+  bool actionQueueHasSpace(byte count);
+  bool acceptsMessage(const VlcbMessage *msg);
+  unsigned int getActionQueuePeak() { return actionQueue.getHighWaterMark(); }
 
   void messageActedOn();
   unsigned int getMessagesActedOn() { return diagMsgsActed; }
@@ -110,6 +137,8 @@ private:
   ArrayHolder<Service *> services;
 
   CircularBuffer<Action> actionQueue;
+  // Incoming messages in the action queue that change the event table or node number.
+  byte pendingStateChanges = 0;
 
   bool sendMessageWithNNandData(VlcbOpCodes opc) { return sendMessageWithNNandData(opc, 0, 0); }
   bool sendMessageWithNNandData(VlcbOpCodes opc, int len, ...);
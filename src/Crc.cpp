@@ -0,0 +1,68 @@
+// Copyright (C) Sven Rosvall (sven@rosvall.ie)
+// This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+// Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0/
+
+//
+// Table driven CRC functions that can be updated a part of the data at a time
+//
+
+// Both CRCs are reflected, i.e. the least significant bit of each byte is processed first.
+// They use a table of 16 entries and process a byte as two nibbles.
+// This is more than twice as fast as a bitwise CRC while the tables only take 32 and 64 bytes
+// of RAM. Tables of 256 entries would take 512 and 1024 bytes which is too much for small AVRs.
+
+#include "Crc.h"
+
+namespace VLCB
+{
+  // CCITT polynomial X^16 + X^12 + X^5 + 1, 0x1021 reversed to 0x8408.
+  static const uint16_t crc16Table[16] = {
+    0x0000, 0x1081, 0x2102, 0x3183, 0x4204, 0x5285, 0x6306, 0x7387,
+    0x8408, 0x9489, 0xA50A, 0xB58B, 0xC60C, 0xD68D, 0xE70E, 0xF78F
+  };
+
+  // Polynomial 0x04C11DB7 reversed to 0xEDB88320.
+  static const uint32_t crc32Table[16] = {
+    0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL, 0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+    0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL, 0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL
+  };
+
+  uint16_t crc16Update(uint16_t crc, const uint8_t *data, unsigned int length)
+  {
+    while (length--)
+    {
+      crc ^= *data++;
+      crc = (crc >> 4) ^ crc16Table[crc & 0x0F];
+      crc = (crc >> 4) ^ crc16Table[crc & 0x0F];
+    }
+    return crc;
+  }
+
+  uint16_t crc16Result(uint16_t crc)
+  {
+    crc = ~crc;
+    return (crc << 8) | (crc >> 8);
+  }
+
+  uint16_t crc16(const uint8_t *data, unsigned int length)
+  {
+    return crc16Result(crc16Update(CRC16_INITIAL, data, length));
+  }
+
+  uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t length)
+  {
+    while (length--)
+    {
+      crc ^= *data++;
+      crc = (crc >> 4) ^ crc32Table[crc & 0x0F];
+      crc = (crc >> 4) ^ crc32Table[crc & 0x0F];
+    }
+    return crc;
+  }
+
+  uint32_t crc32(const uint8_t *data, size_t length)
+  {
+    return crc32Result(crc32Update(CRC32_INITIAL, data, length));
+  }
+}
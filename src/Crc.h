@@ -0,0 +1,26 @@
+// Copyright (C) Sven Rosvall (sven@rosvall.ie)
+// This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+// Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#pragma once
+
+#include <Arduino.h>
+
+namespace VLCB
+{
+  // CRC-16 as used for long messages: CCITT polynomial, reflected, initial value 0xFFFF.
+  // The result is complemented and has its bytes swapped.
+  // Start with CRC16_INITIAL, call crc16Update() for each part of the data
+  // and crc16Result() to get the CRC of all the data.
+  const uint16_t CRC16_INITIAL = 0xFFFF;
+  uint16_t crc16Update(uint16_t crc, const uint8_t *data, unsigned int length);
+  uint16_t crc16Result(uint16_t crc);
+  uint16_t crc16(const uint8_t *data, unsigned int length);
+
+  // CRC-32 as used by Ethernet and zip, used the same way as the CRC-16 functions.
+  const uint32_t CRC32_INITIAL = 0xFFFFFFFF;
+  uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t length);
+  inline uint32_t crc32Result(uint32_t crc) { return ~crc; }
+  uint32_t crc32(const uint8_t *data, size_t length);
+}
@@ -0,0 +1,33 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+#include "DeferredCommit.h"
+
+namespace VLCB
+{
+
+void DeferredCommit::markDirty()
+{
+  lastWriteTime = millis();
+  if (!dirty)
+  {
+    firstWriteTime = lastWriteTime;
+  }
+  dirty = true;
+}
+
+bool DeferredCommit::isCommitDue() const
+{
+  unsigned long now = millis();
+  return dirty && ((now - lastWriteTime) >= commitDelay || (now - firstWriteTime) >= maxCommitDelay);
+}
+
+void DeferredCommit::committed()
+{
+  dirty = false;
+  ++commitCount;
+}
+
+}
@@ -0,0 +1,47 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+#pragma once
+
+#include <Arduino.h>
+
+namespace VLCB
+{
+
+const unsigned int EEPROM_COMMIT_DELAY = 200;           // quiet period in ms before written data is committed to flash
+const unsigned int EEPROM_MAX_COMMIT_DELAY = 2000;      // longest time in ms that written data waits for a commit
+
+/// @brief Decides when writes to storage that needs an explicit commit shall be committed.
+///
+/// A commit is due once there have been no writes for the commit delay.
+/// Thus a burst of writes such as a series of EVLRN or NVSET messages costs a single commit.
+/// Writes that never pause are committed once the maximum commit delay has passed since the first of them.
+class DeferredCommit
+{
+public:
+  /// Set how long writes must have been quiet before a commit is due.
+  void setCommitDelay(unsigned int delay_in_millis) { commitDelay = delay_in_millis; }
+  /// Set how long changes may wait for a commit while writes keep coming.
+  void setMaxCommitDelay(unsigned int delay_in_millis) { maxCommitDelay = delay_in_millis; }
+  /// Record that data has changed and needs committing.
+  void markDirty();
+  bool isDirty() const { return dirty; }
+  /// True if there are changes and there have been no writes for the commit delay,
+  /// or the first change was made at least the maximum commit delay ago.
+  bool isCommitDue() const;
+  /// Record that the changes have been committed.
+  void committed();
+  unsigned int getCommitCount() const { return commitCount; }
+
+private:
+  bool dirty = false;
+  unsigned long firstWriteTime = 0;
+  unsigned long lastWriteTime = 0;
+  unsigned int commitDelay = EEPROM_COMMIT_DELAY;
+  unsigned int maxCommitDelay = EEPROM_MAX_COMMIT_DELAY;
+  unsigned int commitCount = 0;
+};
+
+}
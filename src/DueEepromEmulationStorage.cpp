@@ -44,6 +44,10 @@ byte DueEepromEmulationStorage::readBytes(unsigned int eeaddress, byte nbytes, b
 
 byte DueEepromEmulationStorage::getChipEEPROMVal(unsigned int eeaddress)
 {
+  if (eeaddress / DUE_FLASH_PAGE_SIZE == stagedPage)
+  {
+    return pageBuffer[eeaddress % DUE_FLASH_PAGE_SIZE];
+  }
 #ifdef __SAM3X8E__
   return dueFlashStorage.read(eeaddress);
 #else
@@ -80,9 +84,56 @@ void DueEepromEmulationStorage::writeBytes(unsigned int eeaddress, const byte sr
 //
 void DueEepromEmulationStorage::setChipEEPROMVal(unsigned int eeaddress, byte val)
 {
+  stagePage(eeaddress / DUE_FLASH_PAGE_SIZE);
+  byte & staged = pageBuffer[eeaddress % DUE_FLASH_PAGE_SIZE];
+  if (staged != val)
+  {
+    staged = val;
+    pageDirty = true;
+  }
+}
+
+//
+/// make the given page the one that is staged in RAM
+/// any changes to the previously staged page are written to flash first
+//
+void DueEepromEmulationStorage::stagePage(unsigned int page)
+{
+  if (page == stagedPage)
+  {
+    return;
+  }
+
+  flushPage();
+
+#ifdef __SAM3X8E__
+  memcpy(pageBuffer, dueFlashStorage.readAddress(page * DUE_FLASH_PAGE_SIZE), DUE_FLASH_PAGE_SIZE);
+#endif
+  stagedPage = page;
+}
+
+void DueEepromEmulationStorage::flushPage()
+{
+  if (!pageDirty)
+  {
+    return;
+  }
+
+  // DEBUG_SERIAL << F("> flushing page ") << stagedPage << endl;
 #ifdef __SAM3X8E__
-  dueFlashStorage.write(eeaddress, val);
+  dueFlashStorage.write(stagedPage * DUE_FLASH_PAGE_SIZE, pageBuffer, DUE_FLASH_PAGE_SIZE);
 #endif
+  ++pageWriteCount;
+  pageDirty = false;
+}
+
+//
+/// called from every Controller::process() loop
+/// programs the staged page to flash if it has been changed
+//
+void DueEepromEmulationStorage::commitWriteEEPROM()
+{
+  flushPage();
 }
 
 //
@@ -14,6 +14,10 @@
 namespace VLCB
 {
 
+const unsigned int DUE_FLASH_PAGE_SIZE = 256;  // IFLASH1_PAGE_SIZE on SAM3X
+
+// Writes are staged in a page sized RAM buffer and programmed to flash
+// one page at a time when commitWriteEEPROM() is called.
 class DueEepromEmulationStorage : public Storage
 {
 public:
@@ -28,10 +32,21 @@ public:
   virtual void write(unsigned int eeaddress, byte data) override;
   virtual void writeBytes(unsigned int eeaddress, const byte src[], byte numbytes) override;
   virtual void reset() override;
+  virtual void commitWriteEEPROM() override;
+
+  unsigned int getPageWriteCount() const { return pageWriteCount; }
 
 private:
   byte getChipEEPROMVal(unsigned int eeaddress);
   void setChipEEPROMVal(unsigned int eeaddress, byte val);
+  void stagePage(unsigned int page);
+  void flushPage();
+
+  static const unsigned int NO_PAGE = 0xFFFF;
+  unsigned int stagedPage = NO_PAGE;
+  bool pageDirty = false;
+  byte pageBuffer[DUE_FLASH_PAGE_SIZE];
+  unsigned int pageWriteCount = 0;
 
 #ifdef __SAM3X8E__
   DueFlashStorage dueFlashStorage;
@@ -88,17 +88,49 @@ void EepromInternalStorage::writeBytes(unsigned int eeaddress, const byte src[],
 //
 void EepromInternalStorage::setChipEEPROMVal(unsigned int eeaddress, byte val)
 {
-  #ifndef __SAM3X8E__
+  #ifdef VLCB_EEPROM_NEEDS_COMMIT
+  if (EEPROM.read(eeaddress) == val)
+  {
+    // Unchanged, no need to commit this.
+    return;
+  }
+  EEPROM.write(eeaddress, val);
+  deferredCommit.markDirty();
+  #elif !defined(__SAM3X8E__)
   EEPROM.write(eeaddress, val);
   #endif  
 }
 
+//
+/// called from every Controller::process() loop
+/// only commits once writes have been quiet for the commit delay so that a burst
+/// of writes such as a series of EVLRN or NVSET messages costs a single flash program
+//
 void EepromInternalStorage::commitWriteEEPROM()
 {
-  #if defined ESP32 || defined ESP8266 || defined ARDUINO_ARCH_RP2040
+  if (deferredCommit.isCommitDue())
+  {
+    commit();
+  }
+}
+
+void EepromInternalStorage::flush()
+{
+  if (deferredCommit.isDirty())
+  {
+    commit();
+  }
+}
+
+void EepromInternalStorage::commit()
+{
+  #ifdef VLCB_EEPROM_NEEDS_COMMIT
   EEPROM.commit();
   #endif
+
+  deferredCommit.committed();
 }
+
 //
 /// clear all event data in external EEPROM chip
 //
@@ -6,6 +6,12 @@
 #pragma once
 
 #include "Storage.h"
+#include "DeferredCommit.h"
+
+// These platforms emulate EEPROM in flash and need an explicit commit.
+#if defined ESP32 || defined ESP8266 || defined ARDUINO_ARCH_RP2040
+#define VLCB_EEPROM_NEEDS_COMMIT
+#endif
 
 namespace VLCB
 {
@@ -27,10 +33,21 @@ public:
   virtual void writeBytes(unsigned int eeaddress, const byte src[], byte numbytes) override;
   virtual void reset() override;
   virtual void commitWriteEEPROM() override;
+  virtual void flush() override;
+
+  /// Set how long writes must have been quiet before they are committed to flash.
+  /// A burst of writes is then committed with a single flash program.
+  /// Each commit rewrites the whole emulated EEPROM area in flash.
+  void setCommitDelay(unsigned int delay_in_millis) { deferredCommit.setCommitDelay(delay_in_millis); }
+  void setMaxCommitDelay(unsigned int delay_in_millis) { deferredCommit.setMaxCommitDelay(delay_in_millis); }
+  unsigned int getCommitCount() const { return deferredCommit.getCommitCount(); }
 
 private:
   byte getChipEEPROMVal(unsigned int eeaddress);
   void setChipEEPROMVal(unsigned int eeaddress, byte val);
+  void commit();
+
+  DeferredCommit deferredCommit;
 };
 
 }
\ No newline at end of file
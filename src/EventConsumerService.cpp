@@ -73,6 +73,50 @@ void EventConsumerService::process(const Action *action)
   }
 }
 
+//
+/// only accept events that are in the event table
+//
+bool EventConsumerService::acceptsMessage(const VlcbMessage *msg)
+{
+  unsigned int nn = Configuration::getTwoBytes(&msg->data[1]);
+  unsigned int en = Configuration::getTwoBytes(&msg->data[3]);
+  Configuration *modconfig = controller->getModuleConfig();
+
+  switch (msg->data[0])
+  {
+    case OPC_ACON:
+    case OPC_ACON1:
+    case OPC_ACON2:
+    case OPC_ACON3:
+
+    case OPC_ACOF:
+    case OPC_ACOF1:
+    case OPC_ACOF2:
+    case OPC_ACOF3:
+
+    case OPC_ARON:
+    case OPC_AROF:
+      return eventhandler && modconfig->findExistingEvent(nn, en) < modconfig->getNumEvents();
+
+    case OPC_ASON:
+    case OPC_ASON1:
+    case OPC_ASON2:
+    case OPC_ASON3:
+
+    case OPC_ASOF:
+    case OPC_ASOF1:
+    case OPC_ASOF2:
+    case OPC_ASOF3:
+      return eventhandler && modconfig->findExistingEvent(0, en) < modconfig->getNumEvents();
+
+    case OPC_MODE:
+      return isThisNodeNumber(nn);
+
+    default:
+      return false;
+  }
+}
+
 void EventConsumerService::handleConsumedMessage(const VlcbMessage *msg)
 {
   //DEBUG_SERIAL << ">Handle Message " << endl;
@@ -29,6 +29,7 @@ public:
   void setEventHandler(void (*fptr)(byte index, const VlcbMessage *msg));
   /// @cond LIBRARY
   virtual void process(const Action * action) override;
+  virtual bool acceptsMessage(const VlcbMessage *msg) override;
 
   virtual VlcbServiceTypes getServiceID() const override 
   {
@@ -31,6 +31,34 @@ void EventProducerService::process(const Action * action)
   }
 }
 
+//
+/// only accept requests for events that are in the event table
+//
+bool EventProducerService::acceptsMessage(const VlcbMessage *msg)
+{
+  if (requesteventhandler == nullptr)
+  {
+    return false;
+  }
+
+  unsigned int nn = Configuration::getTwoBytes(&msg->data[1]);
+  unsigned int en = Configuration::getTwoBytes(&msg->data[3]);
+  Configuration *module_config = controller->getModuleConfig();
+
+  switch (msg->data[0])
+  {
+    case OPC_ASRQ:
+      return (isThisNodeNumber(nn) || nn == 0000)
+             && module_config->findExistingEvent(0000, en) < module_config->getNumEvents();
+
+    case OPC_AREQ:
+      return module_config->findExistingEvent(nn, en) < module_config->getNumEvents();
+
+    default:
+      return false;
+  }
+}
+
 void EventProducerService::sendMessage(VlcbMessage &msg, byte opCode, const byte *nn_en)
 {
   msg.data[0] = opCode;
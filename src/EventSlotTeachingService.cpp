@@ -18,6 +18,21 @@ void EventSlotTeachingService::process(const Action *action)
   }
 }
 
+bool EventSlotTeachingService::acceptsMessage(const VlcbMessage *msg)
+{
+  switch (msg->data[0])
+  {
+    case OPC_EVLRNI:
+      return true;
+
+    case OPC_NENRD:
+      return isThisNodeNumber(Configuration::getTwoBytes(&msg->data[1]));
+
+    default:
+      return AbstractEventTeachingService::acceptsMessage(msg);
+  }
+}
+
 void EventSlotTeachingService::handleMessage(const VlcbMessage *msg) 
 {
   unsigned int opc = msg->data[0];
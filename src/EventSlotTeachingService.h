@@ -27,6 +27,7 @@ class EventSlotTeachingService : public AbstractEventTeachingService
 public:
   /// @cond LIBRARY
   virtual void process(const Action * action) override;
+  virtual bool acceptsMessage(const VlcbMessage *msg) override;
   virtual VlcbServiceTypes getServiceID() const override { return SERVICE_ID_TEACH; }
   virtual byte getServiceVersionID() const override { return 1; }
   /// @endcond
@@ -19,6 +19,19 @@ void EventTeachingService::process(const Action *action)
   }
 }
 
+bool EventTeachingService::acceptsMessage(const VlcbMessage *msg)
+{
+  switch (msg->data[0])
+  {
+    case OPC_REQEV:
+    case OPC_EVLRN:
+      return true;
+
+    default:
+      return AbstractEventTeachingService::acceptsMessage(msg);
+  }
+}
+
 void EventTeachingService::handleMessage(const VlcbMessage *msg) 
 {
   unsigned int opc = msg->data[0];
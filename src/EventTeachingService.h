@@ -25,6 +25,7 @@ class EventTeachingService : public AbstractEventTeachingService
 /// @cond LIBRARY
 public:
   virtual void process(const Action * action) override;
+  virtual bool acceptsMessage(const VlcbMessage *msg) override;
   virtual VlcbServiceTypes getServiceID() const override { return SERVICE_ID_OLD_TEACH; }
   virtual byte getServiceVersionID() const override { return 3; }
 
@@ -0,0 +1,93 @@
+// Copyright (C) Sven Rosvall (sven@rosvall.ie)
+// This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+// Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include "FramI2cStorage.h"
+
+#include <Wire.h>
+
+namespace VLCB
+{
+
+// Size of the transmit and receive buffers in the Arduino Wire library.
+const byte FRAM_I2C_BUFFER_LENGTH = 32;
+
+FramI2cStorage::FramI2cStorage(byte address, unsigned long size, byte addressBytes)
+  : FramI2cStorage(address, size, addressBytes, &Wire)
+{
+}
+
+FramI2cStorage::FramI2cStorage(byte address, unsigned long size, byte addressBytes, TwoWire *bus)
+  : FramStorage(size, addressBytes)
+  , external_address(address)
+  , I2Cbus(bus)
+{
+}
+
+void FramI2cStorage::begin()
+{
+  I2Cbus->begin();
+  // Address the chip once. Storage::begin() has no way to report a missing chip.
+  I2Cbus->beginTransmission(external_address);
+  I2Cbus->endTransmission();
+}
+
+byte FramI2cStorage::readBurst(unsigned long address, byte nbytes, byte dest[])
+{
+  byte device = deviceAddress(address);
+  I2Cbus->beginTransmission(device);
+  sendAddress(address);
+  byte r = I2Cbus->endTransmission();
+
+  if (r != 0) {
+    // DEBUG_SERIAL << F("> readBurst: I2C write error = ") << r << endl;
+    return 0;
+  }
+
+  I2Cbus->requestFrom((int)device, (int)nbytes);
+
+  byte count = 0;
+  while (I2Cbus->available() && count < nbytes) {
+    dest[count++] = I2Cbus->read();
+  }
+  return count;
+}
+
+void FramI2cStorage::writeBurst(unsigned long address, const byte src[], byte nbytes)
+{
+  I2Cbus->beginTransmission(deviceAddress(address));
+  sendAddress(address);
+  I2Cbus->write(src, nbytes);
+  byte r = I2Cbus->endTransmission();
+
+  if (r != 0) {
+    // DEBUG_SERIAL << F("> writeBurst: I2C write error = ") << r << endl;
+  }
+}
+
+byte FramI2cStorage::maxReadBurst()
+{
+  return FRAM_I2C_BUFFER_LENGTH;
+}
+
+byte FramI2cStorage::maxWriteBurst()
+{
+  // The address bytes share the transmit buffer with the data.
+  return FRAM_I2C_BUFFER_LENGTH - addressBytes;
+}
+
+byte FramI2cStorage::deviceAddress(unsigned long address)
+{
+  return external_address | (address >> (8 * addressBytes));
+}
+
+void FramI2cStorage::sendAddress(unsigned long address)
+{
+  for (byte i = addressBytes; i > 0; --i)
+  {
+    I2Cbus->write((int)((address >> (8 * (i - 1))) & 0xFF));
+  }
+}
+
+}
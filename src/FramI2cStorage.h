@@ -0,0 +1,45 @@
+// Copyright (C) Sven Rosvall (sven@rosvall.ie)
+// This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+// Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#pragma once
+
+#include "FramStorage.h"
+
+#include <Wire.h>
+
+namespace VLCB
+{
+
+/// @brief Storage on an I2C FRAM chip such as MB85RC256V or MB85RC1MT.
+///
+/// Address bits above the address bytes are sent in the low bits of the
+/// device address, as done by chips larger than 64KB.
+class FramI2cStorage : public FramStorage
+{
+public:
+  /// @param address I2C device address of the chip.
+  /// @param size Number of bytes on the FRAM chip.
+  /// @param addressBytes Number of address bytes, 1 or 2.
+  FramI2cStorage(byte address, unsigned long size, byte addressBytes = 2);
+  FramI2cStorage(byte address, unsigned long size, byte addressBytes, TwoWire *bus);
+  virtual void begin() override;
+
+protected:
+  /// @cond LIBRARY
+  virtual byte readBurst(unsigned long address, byte nbytes, byte dest[]) override;
+  virtual void writeBurst(unsigned long address, const byte src[], byte nbytes) override;
+  virtual byte maxReadBurst() override;
+  virtual byte maxWriteBurst() override;
+  /// @endcond
+
+private:
+  byte deviceAddress(unsigned long address);
+  void sendAddress(unsigned long address);
+
+  byte external_address;
+  TwoWire *I2Cbus;
+};
+
+}
@@ -0,0 +1,99 @@
+// Copyright (C) Sven Rosvall (sven@rosvall.ie)
+// This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+// Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include "FramSpiStorage.h"
+
+#include <SPI.h>
+
+namespace VLCB
+{
+
+// FRAM SPI op-codes
+const byte FRAM_OPC_WREN = 0x06;
+const byte FRAM_OPC_READ = 0x03;
+const byte FRAM_OPC_WRITE = 0x02;
+
+const unsigned long FRAM_SPI_CLOCK = 8000000UL;
+
+FramSpiStorage::FramSpiStorage(byte csPin, unsigned long size, byte addressBytes)
+  : FramSpiStorage(csPin, size, addressBytes, &SPI)
+{
+}
+
+FramSpiStorage::FramSpiStorage(byte csPin, unsigned long size, byte addressBytes, SPIClass *bus)
+  : FramStorage(size, addressBytes)
+  , csPin(csPin)
+  , SPIbus(bus)
+{
+}
+
+void FramSpiStorage::begin()
+{
+  pinMode(csPin, OUTPUT);
+  digitalWrite(csPin, HIGH);
+  SPIbus->begin();
+}
+
+byte FramSpiStorage::readBurst(unsigned long address, byte nbytes, byte dest[])
+{
+  select();
+  SPIbus->transfer(FRAM_OPC_READ);
+  sendAddress(address);
+  for (byte i = 0; i < nbytes; ++i)
+  {
+    dest[i] = SPIbus->transfer(0);
+  }
+  deselect();
+  return nbytes;
+}
+
+void FramSpiStorage::writeBurst(unsigned long address, const byte src[], byte nbytes)
+{
+  // The write enable latch is cleared after each write.
+  select();
+  SPIbus->transfer(FRAM_OPC_WREN);
+  deselect();
+
+  select();
+  SPIbus->transfer(FRAM_OPC_WRITE);
+  sendAddress(address);
+  for (byte i = 0; i < nbytes; ++i)
+  {
+    SPIbus->transfer(src[i]);
+  }
+  deselect();
+}
+
+byte FramSpiStorage::maxReadBurst()
+{
+  return 0xFF;
+}
+
+byte FramSpiStorage::maxWriteBurst()
+{
+  return 0xFF;
+}
+
+void FramSpiStorage::select()
+{
+  SPIbus->beginTransaction(SPISettings(FRAM_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+  digitalWrite(csPin, LOW);
+}
+
+void FramSpiStorage::deselect()
+{
+  digitalWrite(csPin, HIGH);
+  SPIbus->endTransaction();
+}
+
+void FramSpiStorage::sendAddress(unsigned long address)
+{
+  for (byte i = addressBytes; i > 0; --i)
+  {
+    SPIbus->transfer((address >> (8 * (i - 1))) & 0xFF);
+  }
+}
+
+}
@@ -0,0 +1,43 @@
+// Copyright (C) Sven Rosvall (sven@rosvall.ie)
+// This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+// Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#pragma once
+
+#include "FramStorage.h"
+
+#include <SPI.h>
+
+namespace VLCB
+{
+
+/// @brief Storage on an SPI FRAM chip such as MB85RS256B or MB85RS2MT.
+class FramSpiStorage : public FramStorage
+{
+public:
+  /// @param csPin Chip select pin for the chip.
+  /// @param size Number of bytes on the FRAM chip.
+  /// @param addressBytes Number of address bytes, 2 for chips up to 64KB, 3 for larger chips.
+  FramSpiStorage(byte csPin, unsigned long size, byte addressBytes = 2);
+  FramSpiStorage(byte csPin, unsigned long size, byte addressBytes, SPIClass *bus);
+  virtual void begin() override;
+
+protected:
+  /// @cond LIBRARY
+  virtual byte readBurst(unsigned long address, byte nbytes, byte dest[]) override;
+  virtual void writeBurst(unsigned long address, const byte src[], byte nbytes) override;
+  virtual byte maxReadBurst() override;
+  virtual byte maxWriteBurst() override;
+  /// @endcond
+
+private:
+  void select();
+  void deselect();
+  void sendAddress(unsigned long address);
+
+  byte csPin;
+  SPIClass *SPIbus;
+};
+
+}
@@ -0,0 +1,116 @@
+// Copyright (C) Sven Rosvall (sven@rosvall.ie)
+// This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+// Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include "FramStorage.h"
+
+namespace VLCB
+{
+
+const byte FRAM_RESET_BURST = 32;
+
+FramStorage::FramStorage(unsigned long size, byte addressBytes)
+  : size(size)
+  , addressBytes(addressBytes)
+{
+}
+
+//
+/// read a single byte from FRAM
+//
+byte FramStorage::read(unsigned int eeaddress)
+{
+  byte rdata = 0;
+  readBurst(eeaddress, 1, &rdata);
+  return rdata;
+}
+
+//
+/// read a number of bytes from FRAM in as few bus transactions as possible
+//
+byte FramStorage::readBytes(unsigned int eeaddress, byte nbytes, byte dest[])
+{
+  byte count = 0;
+  while (count < nbytes)
+  {
+    byte len = burstLength(eeaddress + count, nbytes - count, maxReadBurst());
+    byte got = readBurst(eeaddress + count, len, dest + count);
+    count += got;
+    if (got < len)
+    {
+      // DEBUG_SERIAL << F("> readBytes: short read at addr = ") << eeaddress + count << endl;
+      break;
+    }
+  }
+  return count;
+}
+
+//
+/// write a byte. No need to wait for a write cycle with FRAM.
+//
+void FramStorage::write(unsigned int eeaddress, byte data)
+{
+  writeBurst(eeaddress, &data, 1);
+}
+
+//
+/// write a number of bytes to FRAM in as few bus transactions as possible
+//
+void FramStorage::writeBytes(unsigned int eeaddress, const byte src[], byte numbytes)
+{
+  byte count = 0;
+  while (count < numbytes)
+  {
+    byte len = burstLength(eeaddress + count, numbytes - count, maxWriteBurst());
+    writeBurst(eeaddress + count, src + count, len);
+    count += len;
+  }
+}
+
+//
+/// clear the whole FRAM chip
+//
+void FramStorage::reset()
+{
+  // DEBUG_SERIAL << F("> clearing data from FRAM ...") << endl;
+
+  byte blank[FRAM_RESET_BURST];
+  memset(blank, 0xFF, sizeof(blank));
+  byte maxBurst = maxWriteBurst();
+  if (maxBurst > FRAM_RESET_BURST)
+  {
+    maxBurst = FRAM_RESET_BURST;
+  }
+
+  for (unsigned long addr = 0; addr < size; )
+  {
+    unsigned long remaining = size - addr;
+    byte len = burstLength(addr, remaining > maxBurst ? maxBurst : remaining, maxBurst);
+    writeBurst(addr, blank, len);
+    addr += len;
+  }
+}
+
+//
+/// number of bytes to transfer in the next burst
+/// bursts are limited by the bus and must not wrap around the address range
+/// that can be expressed by the address bytes
+//
+byte FramStorage::burstLength(unsigned long address, unsigned int remaining, byte maxBurst)
+{
+  unsigned long bankSize = 1UL << (8 * addressBytes);
+  unsigned long toBankEnd = bankSize - (address & (bankSize - 1));
+  unsigned long len = remaining;
+  if (len > maxBurst)
+  {
+    len = maxBurst;
+  }
+  if (len > toBankEnd)
+  {
+    len = toBankEnd;
+  }
+  return len;
+}
+
+}
@@ -0,0 +1,54 @@
+// Copyright (C) Sven Rosvall (sven@rosvall.ie)
+// This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+// Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#pragma once
+
+#include "Storage.h"
+
+#include <Arduino.h>                // for definition of byte datatype
+
+namespace VLCB
+{
+
+/// @brief Base class for storage on an external FRAM chip.
+///
+/// FRAM has no write cycle delay, is byte addressable and comes in sizes
+/// of 32KB up to 256KB.
+/// Storage addresses are unsigned int. On AVR these are 16 bits so only the
+/// first 64KB of a larger chip can be read and written. reset() clears the whole chip.
+/// Reads and writes are split into bursts as large as the bus allows.
+/// Subclasses implement the bus specific transfer of a single burst.
+class FramStorage : public Storage
+{
+public:
+  /// @cond LIBRARY
+  virtual byte read(unsigned int eeaddress) override;
+  virtual byte readBytes(unsigned int eeaddress, byte nbytes, byte dest[]) override;
+  virtual void write(unsigned int eeaddress, byte data) override;
+  virtual void writeBytes(unsigned int eeaddress, const byte src[], byte numbytes) override;
+  virtual void reset() override;
+  /// @endcond
+
+  unsigned long getSize() const { return size; }
+
+protected:
+  /// @param size Number of bytes on the FRAM chip.
+  /// @param addressBytes Number of address bytes sent to the chip for each transfer.
+  FramStorage(unsigned long size, byte addressBytes);
+
+  // Transfer bytes in a single bus transaction. A burst never crosses a
+  // boundary that the address bytes cannot express.
+  virtual byte readBurst(unsigned long address, byte nbytes, byte dest[]) = 0;
+  virtual void writeBurst(unsigned long address, const byte src[], byte nbytes) = 0;
+  virtual byte maxReadBurst() = 0;
+  virtual byte maxWriteBurst() = 0;
+
+  byte burstLength(unsigned long address, unsigned int remaining, byte maxBurst);
+
+  unsigned long size;
+  byte addressBytes;
+};
+
+}
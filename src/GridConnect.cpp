@@ -46,200 +46,217 @@
 // And the GridConnect Identifier field is also leading zero padded, so always 8 characters for an extended message
 // 
 
-#include <ctype.h>
 #include "GridConnect.h"
 
 namespace VLCB
 {
 
-  bool encodeGridConnect(char * gcBuffer, CANFrame *frame)
+  // Digits used when encoding. GridConnect uses upper case hex only.
+  static const char hexDigits[] = "0123456789ABCDEF";
+
+  // Value of each character from '0' to 'F'. Characters that are not upper case
+  // hex digits map to HEX_INVALID.
+  static const byte HEX_INVALID = 0xFF;
+  static const byte hexValues['F' - '0' + 1] =
   {
-      byte offset = 0;
-      gcBuffer[0] = 0;  // null terminate buffer to start with
-      // set starting character & standard or extended CAN identifier
-      if (frame->ext)
-      {
-        if (frame->id > 0x1FFFFFFF)
-        {
-          // id is greater than 29 bits, so fail the encoding
-          return false;
-        }
-        // mark as extended frame
-        strcpy (gcBuffer,":X");
-        // extended 29 bit CAN idenfier in bytes 2 to 9
-        // chars 2 & 3 are ID bits 21 to 28
-        sprintf(gcBuffer + 2, "%02X", (frame->id) >> 21);
-        // char 4 -  bits 1 to 3 are ID bits 18 to 20
-        sprintf(gcBuffer + 4, "%01X", ((frame->id) >> 17) & 0xE);
-        // char 5 -  bits 0 to 1 are ID bits 16 & 17
-        sprintf(gcBuffer + 5, "%01X", ((frame->id) >> 16) & 0x3);
-        // chars 6 to 9 are ID bits 0 to 15
-        sprintf(gcBuffer + 6, "%04X", frame->id & 0xFFFF);
-        offset = 10;
-      } 
-      else
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9,                                         // '0' - '9'
+    HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, // ':' - '@'
+    10, 11, 12, 13, 14, 15                                                // 'A' - 'F'
+  };
+
+  //
+  /// value of a hex character or HEX_INVALID
+  //
+  static inline byte hexValue(char c)
+  {
+    // Characters below '0' wrap around to large values.
+    byte index = (byte)(c - '0');
+    return (index < sizeof(hexValues)) ? hexValues[index] : HEX_INVALID;
+  }
+
+  //
+  /// convert count hex characters into value
+  /// returns false if any character is not an upper case hex digit
+  //
+  static bool hexToValue(const char * hex, byte count, uint32_t & value)
+  {
+    uint32_t result = 0;
+    for (byte i = 0; i < count; ++i)
+    {
+      byte digit = hexValue(hex[i]);
+      if (digit == HEX_INVALID)
       {
-        // mark sas standard frame
-        if (frame->id > 0x7FF)
-        {
-          // id is greater than 11 bits, so fail the encoding
-          return false;
-        }
-        strcpy (gcBuffer,":S");
-        // standard 11 bit CAN idenfier in bytes 2 to 5, left shifted 5 to occupy highest bits
-        sprintf(gcBuffer + 2, "%04X", frame->id << 5);
-        offset = 6;
-      }
-      // set RTR or normal - byte 6 or 10
-      strcpy(gcBuffer + offset++, frame->rtr ? "R" : "N");
-      if (frame->len > 8)
-      { 
-        // if greater than 8 then faulty frame
-        gcBuffer[0] = 0;
         return false;
       }
-      //now add hex data from byte 7 if len > 0
-      for (int i=0; i < frame->len; i++)
-      {
-        sprintf(gcBuffer + offset, "%02X", frame->data[i]);
-        offset += 2;
-      }
-      // add terminator
-      strcpy (gcBuffer + offset,";");
-      return true;
+      result = (result << 4) | digit;
+    }
+    value = result;
+    return true;
   }
 
-  // Function to convert a pair of hexadecimal characters to a byte value
   //
-  int ascii_pair_to_byte(const char *pair)
+  /// write a byte as two hex characters and return the position after them
+  //
+  static inline char * putHexByte(char * gcBuffer, byte value)
   {
-      unsigned char* data = (unsigned char*)pair;
-      int result;
-      if (data[1] < 'A') { result = data[1] - '0'; }
-      else { result = data[1] - 'A' + 10; }
-      if (data[0] < 'A') { result += (data[0] - '0') << 4; }
-      else { result += (data[0] - 'A' + 10) << 4; }
-      return result;
+    *gcBuffer++ = hexDigits[value >> 4];
+    *gcBuffer++ = hexDigits[value & 0x0F];
+    return gcBuffer;
   }
 
+  bool encodeGridConnect(char * gcBuffer, CANFrame *frame)
+  {
+    return encodeGridConnect(gcBuffer, {frame->id, frame->ext, frame->rtr, frame->len}, frame->data) > 0;
+  }
 
-  // check supplied array is comprised of only hexadecimal characters
   //
-  bool checkHexChars(const char *charBuff, int count)
+  /// encode a frame into gcBuffer which must hold GRIDCONNECT_MAX_LENGTH + 1 characters
+  /// returns the number of characters encoded, not counting the null terminator
+  /// returns 0 and an empty string if the frame cannot be encoded
+  //
+  byte encodeGridConnect(char * gcBuffer, const CanFrameHeader & header, const uint8_t data[])
   {
-    for (int i = 0 ; i< count; i++)
+    gcBuffer[0] = 0;  // null terminate buffer to start with
+    if (header.len > 8)
     {
-      // must be upper case, so fail if lower case
-      if (islower(charBuff[i]))
-      {
-        return false;
-      }
-      if (!isxdigit(charBuff[i]))
-      {
-        return false;
-      }
+      // if greater than 8 then faulty frame
+      return 0;
     }
-    return true;
+    if (header.id > (header.ext ? 0x1FFFFFFF : 0x7FF))
+    {
+      // id is greater than 29 or 11 bits, so fail the encoding
+      return 0;
+    }
+
+    char * pos = gcBuffer;
+    *pos++ = ':';
+    // set standard or extended CAN identifier
+    if (header.ext)
+    {
+      // mark as extended frame
+      *pos++ = 'X';
+      // chars 2 & 3 are ID bits 21 to 28
+      pos = putHexByte(pos, header.id >> 21);
+      // char 4 - bits 1 to 3 are ID bits 18 to 20
+      // char 5 - bits 0 to 1 are ID bits 16 & 17
+      pos = putHexByte(pos, ((header.id >> 13) & 0xE0) | ((header.id >> 16) & 0x03));
+      // chars 6 to 9 are ID bits 0 to 15
+      pos = putHexByte(pos, header.id >> 8);
+      pos = putHexByte(pos, header.id);
+    }
+    else
+    {
+      // mark as standard frame
+      *pos++ = 'S';
+      // standard 11 bit CAN idenfier in chars 2 to 5, left shifted 5 to occupy highest bits
+      uint16_t shiftedId = header.id << 5;
+      pos = putHexByte(pos, shiftedId >> 8);
+      pos = putHexByte(pos, shiftedId);
+    }
+    // set RTR or normal - char 6 or 10
+    *pos++ = header.rtr ? 'R' : 'N';
+    // now add hex data
+    for (byte i = 0; i < header.len; i++)
+    {
+      pos = putHexByte(pos, data[i]);
+    }
+    // add terminator
+    *pos++ = ';';
+    *pos = 0;
+    return pos - gcBuffer;
   }
 
 
-  // convert a gridconnect message to CANFrame object
-  // see Gridconnect format at beginning of file for byte positions
+  // convert a null terminated gridconnect message to CANFrame object
   //
-  bool decodeGridConnect(const char * gcBuffer, CANFrame *frame) 
+  bool decodeGridConnect(const char * gcBuffer, CANFrame *frame)
   {
-    int gcIndex = 0;                          // index used to 'walk' gc frame
-    int gcBufferLength = strlen(gcBuffer);    // save for later use
+    size_t length = strlen(gcBuffer);
+    if (length > GRIDCONNECT_MAX_LENGTH)
+    {
+      return false;
+    }
+    return decodeGridConnect(gcBuffer, length, frame);
+  }
 
-    // must have start of frame character
-    if (gcBuffer[gcIndex++] != ':') 
+
+  // convert a gridconnect message of known length to CANFrame object
+  // characters are validated and converted in the same pass
+  // see Gridconnect format at beginning of file for byte positions
+  //
+  bool decodeGridConnect(const char * gcBuffer, byte length, CANFrame *frame)
+  {
+    // shortest message is ":S0000N;". Must have start and end of frame characters
+    if (length < 8 || gcBuffer[0] != ':' || gcBuffer[length - 1] != ';')
     {
       return false;
     }
+
+    const char * pos = gcBuffer + 2;
+    uint32_t value;
     //
     // do CAN Identifier, must be either 'X' or 'S'
-    if (gcBuffer[gcIndex] == 'X') 
+    if (gcBuffer[1] == 'X')
     {
-      frame->ext = true;
-      // now get 29 bit ID - convert from hex, but check they are all hex first
-      if (checkHexChars(&gcBuffer[2], 8) == false)
+      // 8 hex characters for the 29 bit ID
+      if (length < 12 || !hexToValue(pos, 8, value))
       {
         return false;
       }
-      // ok, all hex, so build up id from characters 2 to 9
-      // chars 2 & 3 are bits 21 to 28
-      frame->id = uint32_t(ascii_pair_to_byte(&gcBuffer[2])) << 21;
-      // chars 4 & 5 -  bits 5 to 7 are bits 18 to 20
-      frame->id += uint32_t(ascii_pair_to_byte(&gcBuffer[4]) & 0xE0) << 13;
-      // chars 4 & 5 -  bits 0 to 1 are bits 16 & 17
-      frame->id += uint32_t(ascii_pair_to_byte(&gcBuffer[4]) & 0x3) << 16;
-      // chars 6 & 7 are bits 8 to 15
-      frame->id += uint32_t(ascii_pair_to_byte(&gcBuffer[6])) << 8;
-      // chars 8 & 9 are bits 0 to 7 
-      frame->id += ascii_pair_to_byte(&gcBuffer[8]);
-      gcIndex = 10;
-    }
-    else if (gcBuffer[gcIndex] == 'S') 
+      frame->ext = true;
+      // chars 2 to 4 hold bits 18 to 28 with a gap of 3 bits, chars 5 to 9 hold bits 0 to 17
+      frame->id = ((value >> 3) & 0x1FFC0000) | (value & 0x3FFFF);
+      pos += 8;
+    }
+    else if (gcBuffer[1] == 'S')
     {
-      frame->ext = false;
-      // now get 11 bit ID - convert from hex, but check they are all hex first
-      if (checkHexChars(&gcBuffer[2], 4) == false)
+      if (!hexToValue(pos, 4, value))
       {
         return false;
       }
+      frame->ext = false;
       // 11 bit identifier needs to be shifted right by 5
-      frame->id = strtol(&gcBuffer[2], NULL, 16) >> 5;
-      gcIndex = 6;
-    } 
-    else 
+      frame->id = value >> 5;
+      pos += 4;
+    }
+    else
     {
       return false;
     }
     //
     // do RTR flag
-    if (gcBuffer[gcIndex] == 'R') 
+    if (*pos == 'R')
     {
       frame->rtr = true;
-    } 
-    else if (gcBuffer[gcIndex] == 'N')
+    }
+    else if (*pos == 'N')
     {
       frame->rtr = false;
-    } 
-    else 
+    }
+    else
     {
       return false;
     }
-    gcIndex++;  // set to next character afert RTR flag
+    ++pos;
     //
     // Do data segment - convert hex array to byte array
-    // find out how many chars in data segment (0 to 16, in multiples of 2) 
-    // should be gcBufferLength minus gcIndex as it is now (after RTR flag), minus 1
-    int dataLength = gcBufferLength - gcIndex - 1;
+    // the data characters lie between the RTR flag and the end of frame character
+    byte dataLength = gcBuffer + length - 1 - pos;
     // must be even number of hex characters, and no more than 16
-    if ((dataLength % 2 ) || (dataLength > 16 )) 
+    if ((dataLength % 2) || (dataLength > 16))
     {
       return false;
-    } 
-    // set length of data segment
+    }
     frame->len = dataLength / 2;
-    // now convert hex data into bytes
-    for (int i = 0; i < dataLength/2; i++) 
+    for (byte i = 0; i < frame->len; i++)
     {
-      // check they are hex chars first
-      if (checkHexChars(&gcBuffer[gcIndex], 2) == false)
+      if (!hexToValue(pos, 2, value))
       {
         return false;
       }
-      frame->data[i] = ascii_pair_to_byte(&gcBuffer[gcIndex]);
-      gcIndex += 2;
-    }
-    //
-    // must have end of frame character
-    if (gcBuffer[gcBufferLength-1] != ';') 
-    {
-      return false;
+      frame->data[i] = value;
+      pos += 2;
     }
-    //
-    return true; 
+    return true;
   }
-}
\ No newline at end of file
+}
@@ -8,6 +8,12 @@
 
 namespace VLCB
 {
+  // Longest GridConnect message, an extended frame with 8 data bytes.
+  // Buffers need one more character for the null terminator.
+  const byte GRIDCONNECT_MAX_LENGTH = 28;
+
   bool decodeGridConnect(const char * gcBuffer, CANFrame *frame);
+  bool decodeGridConnect(const char * gcBuffer, byte length, CANFrame *frame);
   bool encodeGridConnect(char * txBuffer, CANFrame *frame);
+  byte encodeGridConnect(char * txBuffer, const CanFrameHeader & header, const uint8_t data[]);
 }
@@ -0,0 +1,150 @@
+// Copyright (C) Sven Rosvall (sven@rosvall.ie)
+// This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+// Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include "InstrumentedStorage.h"
+#include "Configuration.h"
+
+namespace VLCB
+{
+
+// Read: 1us per byte. Write: 3.4ms erase/write cycle per byte.
+const StorageLatencyModel LATENCY_INTERNAL_EEPROM = {0, 1, 0, 3400, 0};
+// Each byte on a 100kHz bus takes 90us. A read transaction sends device address
+// and two address bytes, then a repeated start and device address.
+// A write transaction sends device address and two address bytes followed by the
+// 5ms write cycle.
+const StorageLatencyModel LATENCY_I2C_EEPROM = {450, 90, 5270, 90, 0};
+// Reads and writes only touch the RAM copy. A commit erases and programs a sector.
+const StorageLatencyModel LATENCY_FLASH = {0, 1, 0, 1, 20000};
+
+InstrumentedStorage::InstrumentedStorage(Storage *backend, const StorageLatencyModel *latency)
+  : backend(backend)
+  , latencyModel(latency)
+{
+  // Until told otherwise, treat everything after the reserved area as NVs.
+  setRegionBoundaries(LOCATION_RESERVED_SIZE, 0xFFFF, 0xFFFF);
+  resetCounters();
+}
+
+void InstrumentedStorage::begin()
+{
+  backend->begin();
+}
+
+byte InstrumentedStorage::read(unsigned int eeaddress)
+{
+  countRead(eeaddress, 1);
+  return backend->read(eeaddress);
+}
+
+void InstrumentedStorage::write(unsigned int eeaddress, byte data)
+{
+  countWrite(eeaddress, 1);
+  backend->write(eeaddress, data);
+}
+
+byte InstrumentedStorage::readBytes(unsigned int eeaddress, byte nbytes, byte dest[])
+{
+  countRead(eeaddress, nbytes);
+  return backend->readBytes(eeaddress, nbytes, dest);
+}
+
+void InstrumentedStorage::writeBytes(unsigned int eeaddress, const byte src[], byte numbytes)
+{
+  countWrite(eeaddress, numbytes);
+  backend->writeBytes(eeaddress, src, numbytes);
+}
+
+void InstrumentedStorage::reset()
+{
+  ++resetCalls;
+  backend->reset();
+}
+
+void InstrumentedStorage::commitWriteEEPROM()
+{
+  ++commitCalls;
+  if (latencyModel)
+  {
+    simulatedMicros += latencyModel->commitMicros;
+  }
+  backend->commitWriteEEPROM();
+}
+
+void InstrumentedStorage::flush()
+{
+  ++commitCalls;
+  if (latencyModel)
+  {
+    simulatedMicros += latencyModel->commitMicros;
+  }
+  backend->flush();
+}
+
+void InstrumentedStorage::setRegionBoundaries(unsigned int nvsStart, unsigned int eventsStart, unsigned int freeBase)
+{
+  regionStart[STORAGE_REGION_HEADER] = 0;
+  regionStart[STORAGE_REGION_NVS] = nvsStart;
+  regionStart[STORAGE_REGION_EVENTS] = eventsStart;
+  regionStart[STORAGE_REGION_USER] = freeBase;
+}
+
+void InstrumentedStorage::resetCounters()
+{
+  memset(counters, 0, sizeof(counters));
+  commitCalls = 0;
+  resetCalls = 0;
+  simulatedMicros = 0;
+}
+
+StorageCounters InstrumentedStorage::getTotals() const
+{
+  StorageCounters totals = {0, 0, 0, 0};
+  for (byte r = 0; r < STORAGE_REGION_COUNT; ++r)
+  {
+    totals.readCalls += counters[r].readCalls;
+    totals.writeCalls += counters[r].writeCalls;
+    totals.bytesRead += counters[r].bytesRead;
+    totals.bytesWritten += counters[r].bytesWritten;
+  }
+  return totals;
+}
+
+StorageRegion InstrumentedStorage::regionOf(unsigned int eeaddress) const
+{
+  // Search from the top as regions may be empty, i.e. share a start address.
+  for (byte r = STORAGE_REGION_COUNT - 1; r > 0; --r)
+  {
+    if (eeaddress >= regionStart[r])
+    {
+      return (StorageRegion) r;
+    }
+  }
+  return STORAGE_REGION_HEADER;
+}
+
+void InstrumentedStorage::countRead(unsigned int eeaddress, byte nbytes)
+{
+  StorageCounters &c = counters[regionOf(eeaddress)];
+  ++c.readCalls;
+  c.bytesRead += nbytes;
+  if (latencyModel)
+  {
+    simulatedMicros += latencyModel->readCallMicros + nbytes * latencyModel->readByteMicros;
+  }
+}
+
+void InstrumentedStorage::countWrite(unsigned int eeaddress, byte nbytes)
+{
+  StorageCounters &c = counters[regionOf(eeaddress)];
+  ++c.writeCalls;
+  c.bytesWritten += nbytes;
+  if (latencyModel)
+  {
+    simulatedMicros += latencyModel->writeCallMicros + nbytes * latencyModel->writeByteMicros;
+  }
+}
+
+}
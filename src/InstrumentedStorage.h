@@ -0,0 +1,103 @@
+// Copyright (C) Sven Rosvall (sven@rosvall.ie)
+// This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+// Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#pragma once
+
+#include "Storage.h"
+
+namespace VLCB
+{
+
+/// @cond LIBRARY
+/// Simulated access costs in microseconds for a type of persistent storage.
+/// Used by InstrumentedStorage to estimate how long the counted operations
+/// would have taken on real hardware.
+struct StorageLatencyModel
+{
+  unsigned long readCallMicros;   // fixed cost for each read or readBytes call
+  unsigned long readByteMicros;   // cost for each byte read
+  unsigned long writeCallMicros;  // fixed cost for each write or writeBytes call
+  unsigned long writeByteMicros;  // cost for each byte written
+  unsigned long commitMicros;     // cost for each call to commitWriteEEPROM()
+};
+
+// AVR on-chip EEPROM. Each byte written takes an erase/write cycle of 3.4ms.
+extern const StorageLatencyModel LATENCY_INTERNAL_EEPROM;
+// 24LCxx EEPROM on a 100kHz I2C bus. Each write transaction waits 5ms for the write cycle.
+extern const StorageLatencyModel LATENCY_I2C_EEPROM;
+// EEPROM emulated in flash. Reads and writes go to a RAM copy, a commit programs a flash sector.
+extern const StorageLatencyModel LATENCY_FLASH;
+
+/// Address regions of the storage as laid out by Configuration.
+enum StorageRegion : byte
+{
+  STORAGE_REGION_HEADER = 0,  // Mode, CANID, node number, flags, etc.
+  STORAGE_REGION_NVS,         // Node variables from EE_NVS_START
+  STORAGE_REGION_EVENTS,      // Event table from EE_EVENTS_START
+  STORAGE_REGION_USER,        // Anything from EE_FREE_BASE
+  STORAGE_REGION_COUNT
+};
+
+struct StorageCounters
+{
+  unsigned long readCalls;
+  unsigned long writeCalls;
+  unsigned long bytesRead;
+  unsigned long bytesWritten;
+};
+/// @endcond
+
+/// @brief Storage decorator that counts operations passed on to another Storage.
+///
+/// Wrap any Storage implementation to see how many storage calls and bytes
+/// each operation costs.
+/// Calls are attributed to the region their start address falls in.
+/// If a StorageLatencyModel is provided the simulated time for all counted
+/// operations is accumulated as well.
+class InstrumentedStorage : public Storage
+{
+public:
+  InstrumentedStorage(Storage *backend, const StorageLatencyModel *latency = nullptr);
+
+  /// @cond LIBRARY
+  virtual void begin() override;
+
+  virtual byte read(unsigned int eeaddress) override;
+  virtual void write(unsigned int eeaddress, byte data) override;
+  virtual byte readBytes(unsigned int eeaddress, byte nbytes, byte dest[]) override;
+  virtual void writeBytes(unsigned int eeaddress, const byte src[], byte numbytes) override;
+  virtual void reset() override;
+  virtual void commitWriteEEPROM() override;
+  virtual void flush() override;
+  /// @endcond
+
+  /// Set the start addresses of the NV, event and user regions.
+  /// Typically taken from Configuration after its begin() has been called.
+  void setRegionBoundaries(unsigned int nvsStart, unsigned int eventsStart, unsigned int freeBase);
+  void setLatencyModel(const StorageLatencyModel *latency) { latencyModel = latency; }
+  void resetCounters();
+
+  const StorageCounters & getCounters(StorageRegion region) const { return counters[region]; }
+  StorageCounters getTotals() const;
+  unsigned long getCommitCalls() const { return commitCalls; }
+  unsigned long getResetCalls() const { return resetCalls; }
+  unsigned long getSimulatedMicros() const { return simulatedMicros; }
+
+private:
+  StorageRegion regionOf(unsigned int eeaddress) const;
+  void countRead(unsigned int eeaddress, byte nbytes);
+  void countWrite(unsigned int eeaddress, byte nbytes);
+
+  Storage *backend;
+  const StorageLatencyModel *latencyModel;
+
+  unsigned int regionStart[STORAGE_REGION_COUNT];
+  StorageCounters counters[STORAGE_REGION_COUNT];
+  unsigned long commitCalls;
+  unsigned long resetCalls;
+  unsigned long simulatedMicros;
+};
+
+}
@@ -30,6 +30,7 @@ public:
 
   bool isButtonPressed();
   virtual void process(const Action *action) override;
+  virtual bool acceptsMessage(const VlcbMessage * /*msg*/) override { return false; }
   /// @endcond 
 
 private:
@@ -12,13 +12,11 @@
 #include <Controller.h>
 #include <vlcbdefs.hpp>
 #include <Streaming.h>
+#include <Crc.h>
 
 namespace VLCB
 {
 
-uint16_t crc16(uint8_t *data_p, uint16_t length);
-uint32_t crc32(const char *s, size_t n);
-
 //
 /// subscribe to a range of stream IDs
 //
@@ -41,6 +39,26 @@ void LongMessageService::process(const Action *action)
   }
 }
 
+//
+/// only accept fragments of subscribed streams
+//
+bool LongMessageService::acceptsMessage(const VlcbMessage *msg)
+{
+  if (msg->data[0] != OPC_DTXC)
+  {
+    return false;
+  }
+
+  for (byte i = 0; i < _num_stream_ids; i++)
+  {
+    if (_stream_ids[i] == msg->data[1])
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
 void LongMessageService::handleMessage(const VlcbMessage *msg)
 {
   unsigned int opc = msg->data[0];
@@ -70,10 +88,13 @@ bool LongMessageService::sendLongMessage(const void *msg, const unsigned int msg
 
 	// initialise variables
 	_send_buffer = (byte *)msg;
+	_producer = NULL;
 	_send_buffer_len = msg_len;
 	_send_stream_id = stream_id;
   _send_buffer_index = 0;
 	_send_sequence_num = 0;
+  _send_started = millis();
+  _send_bytes_per_second = 0;
 
 	// send the first fragment which forms the message header
 	frame.data[1] = _send_stream_id;																									// the unique stream id
@@ -85,12 +106,32 @@ bool LongMessageService::sendLongMessage(const void *msg, const unsigned int msg
 	frame.data[7] = 0;																																// flags - 0 = standard data message
 
 	bool ret = sendMessageFragment(&frame);														// send the header packet
+	if (!ret)
+	{
+		// give up this message, the caller may try again
+		_send_buffer_len = 0;
+		return false;
+	}
 	++_send_sequence_num;																															// increment the sending sequence number - it's fine if it wraps around
 
 	// DEBUG_SERIAL << F("> L: message header sent, stream id = ") << _send_stream_id << F(", message length = ") << _send_buffer_len << endl;
 	return (ret);
 }
 
+//
+/// initiate sending of a long message whose data is read from producer as each fragment is sent
+/// the producer must stay valid until its completed() method is called
+//
+bool LongMessageService::sendLongMessage(LongMessageProducer *producer, const byte stream_id)
+{
+  if (!sendLongMessage(NULL, producer->length(), stream_id))
+  {
+    return false;
+  }
+  _producer = producer;
+  return true;
+}
+
 //
 /// the process method is called regularly from the user's loop function
 /// we use this to send the individual fragments of an outgoing message and check the message receive timeout
@@ -114,30 +155,38 @@ bool LongMessageService::process()
 		// timeout error status is surfaced to the user's handler function
 	}
 
-	/// send the next outgoing fragment, after a configurable delay to avoid flooding the bus
+  /// send the next outgoing fragments, paced to avoid flooding the bus
 
-	if (_send_buffer_index < _send_buffer_len && (millis() - _last_fragment_sent >= _msg_delay))
+  for (byte burst = fragmentBurst(); burst > 0 && is_sending() && millis() - _last_fragment_sent >= fragmentDelay(); --burst)
   {
-		_last_fragment_sent = millis();
-
-		memset(&frame.data, 0, sizeof(frame.data));
-		frame.data[1] = _send_stream_id;
-		frame.data[2] = _send_sequence_num;
+    memset(&frame.data, 0, sizeof(frame.data));
+    frame.data[1] = _send_stream_id;
+    frame.data[2] = _send_sequence_num;
 
-		/// only the last fragment is potentially less than 5 bytes long
+    /// only the last fragment is potentially less than 5 bytes long
 
-		for (i = 0; i < 5 && _send_buffer_index < _send_buffer_len; i++)
-    {								// for up to 5 bytes of payload
-			frame.data[i + 3] = _send_buffer[_send_buffer_index];														// take the next byte
-			// DEBUG_SERIAL << F("> L: consumed data byte = ") << (char)_send_buffer[_send_buffer_index] << endl;
-			++_send_buffer_index;
-		}
+    i = readFragment(_send_buffer, _producer, _send_buffer_index, _send_buffer_len, &frame.data[3]);
 
-		ret = sendMessageFragment(&frame);																			// send the data packet
-		// DEBUG_SERIAL << F("> L: process: sent message fragment, seq = ") << _send_sequence_num << F(", size = ") << i << endl;
+    ret = sendMessageFragment(&frame);                                   // send the data packet
+    if (!ret)
+    {
+      // try the same fragment again next time
+      break;
+    }
+    // DEBUG_SERIAL << F("> L: process: sent message fragment, seq = ") << _send_sequence_num << F(", size = ") << i << endl;
 
-		++_send_sequence_num;
-	}
+    _send_buffer_index += i;
+    _last_fragment_sent = millis();
+    ++_send_sequence_num;
+    if (!is_sending())
+    {
+      _send_bytes_per_second = bytesPerSecond(_send_buffer_len, _send_started);
+      if (_producer != NULL)
+      {
+        _producer->completed(_send_stream_id);
+      }
+    }
+  }
 
 	return ret;
 }
@@ -316,6 +365,98 @@ void LongMessageService::setDelay(byte delay_in_millis)
 	_msg_delay = delay_in_millis;
 }
 
+//
+/// pace fragments by the usage of the transport's transmit buffer
+/// fragments are sent as fast as the buffers allow while the bus is quiet
+/// and further apart as the transmit buffer fills up
+/// min_delay_in_millis is kept between fragments for slow receivers
+//
+void LongMessageService::setAdaptivePacing(Transport *transport, byte min_delay_in_millis)
+{
+  _transport = transport;
+  _msg_delay = min_delay_in_millis;
+}
+
+//
+/// number of fragments that may be sent in one call to process()
+/// leaves room in the action queue for other messages and holds back while the transmit buffer is nearly full
+//
+byte LongMessageService::fragmentBurst()
+{
+  if (!controller->actionQueueHasSpace(LONG_MESSAGE_SPARE_ACTIONS + 1))
+  {
+    return 0;
+  }
+  if (_transport == NULL || _transport->transmitBufferSize() == 0)
+  {
+    return 1;
+  }
+
+  unsigned int usage = _transport->transmitBufferUsage();
+  unsigned int size = _transport->transmitBufferSize();
+  if (usage * 4 >= size * 3)
+  {
+    return 0;
+  }
+  return (usage * 4 < size) ? LONG_MESSAGE_MAX_BURST : 1;
+}
+
+//
+/// delay between fragments of a stream, growing with the usage of the transmit buffer
+//
+unsigned int LongMessageService::fragmentDelay()
+{
+  if (_transport == NULL || _transport->transmitBufferSize() == 0)
+  {
+    return _msg_delay;
+  }
+
+  unsigned int usage = _transport->transmitBufferUsage();
+  unsigned int size = _transport->transmitBufferSize();
+  if (usage * 4 < size)
+  {
+    return _msg_delay;
+  }
+  return _msg_delay + (unsigned long) LONG_MESSAGE_MAX_BACKOFF * usage / size;
+}
+
+//
+/// copy the next fragment of up to 5 bytes of a message from its buffer or its producer
+/// returns the number of bytes copied, only the last fragment is potentially less than 5 bytes long
+//
+byte LongMessageService::readFragment(const byte *buffer, LongMessageProducer *producer, unsigned int index, unsigned int length, byte *data)
+{
+  byte count = (length - index < 5) ? length - index : 5;
+  if (producer != NULL)
+  {
+    producer->read(index, data, count);
+  }
+  else
+  {
+    memcpy(data, buffer + index, count);
+  }
+  return count;
+}
+
+unsigned int LongMessageService::bytesPerSecond(unsigned int bytes, unsigned long started)
+{
+  unsigned long elapsed = millis() - started;
+  return (unsigned long) bytes * 1000 / (elapsed > 0 ? elapsed : 1);
+}
+
+//
+/// achieved send rate of the current or last message, in bytes per second
+/// returns 0 if this stream has not been sent
+//
+unsigned int LongMessageService::getBytesPerSecond(byte stream_id)
+{
+  if (stream_id != _send_stream_id)
+  {
+    return 0;
+  }
+  return is_sending() ? bytesPerSecond(_send_buffer_index, _send_started) : _send_bytes_per_second;
+}
+
 //
 /// set the receive timeout
 /// if an expected next fragment is not received, the user's handler function
@@ -334,125 +475,230 @@ void LongMessageService::setTimeout(unsigned int timeout_in_millis)
 //
 
 //
-/// allocate memory for receive and send contexts
+/// allocate receive and send contexts with their buffers
+/// all memory is allocated here so that sending and receiving messages later does no heap allocation
+/// the send buffers hold copies of messages passed to sendLongMessage()
+/// longer messages are copied to the heap, use the caller-owned or producer variants to avoid that
 //
-bool LongMessageServiceEx::allocateContexts(byte num_receive_contexts, unsigned int receive_buffer_len, byte num_send_contexts)
+bool LongMessageServiceEx::allocateContexts(byte num_receive_contexts, unsigned int receive_buffer_len, byte num_send_contexts, unsigned int send_buffer_len)
 {
-	byte i;
+  releaseContexts();
+
+  _receive_context = (receive_context_t *)malloc(sizeof(receive_context_t) * num_receive_contexts);
+  _receive_buffers = (byte *)malloc(receive_buffer_len * num_receive_contexts);
+  _send_context = (send_context_t *)malloc(sizeof(send_context_t) * num_send_contexts);
+  _send_buffers = (byte *)malloc(send_buffer_len * num_send_contexts);
 
-	// DEBUG_SERIAL << F("> receive_context_t * = ") << sizeof(receive_context_t *) << F(", receive_context_t = ") << sizeof(receive_context_t) << endl;
+  if (_receive_context == NULL || (receive_buffer_len > 0 && _receive_buffers == NULL) || _send_context == NULL
+      || (send_buffer_len > 0 && _send_buffers == NULL))
+  {
+    releaseContexts();
+    return false;
+  }
 
-	_num_receive_contexts = num_receive_contexts;
-	_receive_buffer_len = receive_buffer_len;
-	_num_send_contexts = num_send_contexts;
+  _num_receive_contexts = num_receive_contexts;
+  _receive_buffer_len = receive_buffer_len;
+  _num_send_contexts = num_send_contexts;
+  _send_pool_buffer_len = send_buffer_len;
+  _next_send_context = 0;
 
-	// allocate receive contexts
-	if ((_receive_context = (receive_context_t **)malloc(sizeof(receive_context_t *) * _num_receive_contexts)) == NULL)
+  for (byte i = 0; i < _num_receive_contexts; i++)
   {
-		return false;
-	}
+    _receive_context[i].in_use = false;
+    _receive_context[i].buffer = _receive_buffers + i * receive_buffer_len;
+  }
 
-	for (i = 0; i < _num_receive_contexts; i++) {
-		if ((_receive_context[i] = (receive_context_t *)malloc(sizeof(receive_context_t))) == NULL)
-    {
-			return false;
-		}
+  for (byte i = 0; i < _num_send_contexts; i++)
+  {
+    _send_context[i].in_use = false;
+    _send_context[i].buffer = NULL;
+    _send_context[i].completed = NULL;
+    _send_context[i].producer = NULL;
+    _send_context[i].send_stream_id = 0;
+    _send_context[i].bytes_per_second = 0;
+  }
 
-		if ((_receive_context[i]->buffer = (byte *)malloc(receive_buffer_len * sizeof(byte))) == NULL)
-    {
-			return false;
-		}
+  // DEBUG_SERIAL << F("> Lex: allocated send and receive contexts ok") << endl;
+  return true;
+}
 
-		_receive_context[i]->in_use = false;
-	}
+LongMessageServiceEx::~LongMessageServiceEx()
+{
+  releaseContexts();
+}
 
-	// allocate send contexts - user code provides the buffer when sending
-	if ((_send_context = (send_context_t **)malloc(sizeof(send_context_t *) * _num_send_contexts)) == NULL)
+void LongMessageServiceEx::releaseContexts()
+{
+  for (byte i = 0; i < _num_send_contexts; i++)
   {
-		return false;
-	}
-
-	for (i = 0; i < _num_send_contexts; i++) {
-		if ((_send_context[i] = (send_context_t *)malloc(sizeof(send_context_t))) == NULL)
+    if (_send_context[i].in_use && _send_context[i].heap_copy)
     {
-			return false;
-		}
+      free(_send_context[i].buffer);
+    }
+  }
+  free(_receive_context);
+  free(_receive_buffers);
+  free(_send_context);
+  free(_send_buffers);
+  _receive_context = NULL;
+  _receive_buffers = NULL;
+  _send_context = NULL;
+  _send_buffers = NULL;
+  _num_receive_contexts = 0;
+  _num_send_contexts = 0;
+}
 
-		_send_context[i]->in_use = false;
-	}
+//
+/// initiate sending of a long message
+/// the message is copied to a send buffer so the caller may reuse its buffer straight away
+/// returns true if the header packet was sent, see queueLongMessage() for the reason of a failure
+//
+bool LongMessageServiceEx::sendLongMessage(const void *msg, const unsigned int msg_len, const byte stream_id)
+{
+  return queueLongMessage(msg, msg_len, stream_id) == LONG_MESSAGE_SEND_OK;
+}
 
-	// DEBUG_SERIAL << F("> Lex: allocated send and receive contexts ok") << endl;
-	return true;
+//
+/// initiate sending of a long message by copying it to a pooled send buffer
+/// a message longer than the send buffer length given to allocateContexts() is copied to the heap instead
+//
+LongMessageSendStatus LongMessageServiceEx::queueLongMessage(const void *msg, const unsigned int msg_len, const byte stream_id)
+{
+  return startSending((const byte *)msg, NULL, msg_len, stream_id, NULL, true);
+}
+
+//
+/// initiate sending of a long message directly from a buffer owned by the caller
+/// the buffer must be left unchanged until completed is called with the message and stream ID
+//
+LongMessageSendStatus LongMessageServiceEx::queueLongMessage(const void *msg, const unsigned int msg_len, const byte stream_id, void (*completed)(const void *msg, byte stream_id))
+{
+  return startSending((const byte *)msg, NULL, msg_len, stream_id, completed, false);
+}
+
+//
+/// initiate sending of a long message whose data is read from producer as each fragment is sent
+/// the producer must stay valid until its completed() method is called
+/// if CRCs are used the producer is also read through once to calculate the CRC for the header
+//
+LongMessageSendStatus LongMessageServiceEx::queueLongMessage(LongMessageProducer *producer, const byte stream_id)
+{
+  return startSending(NULL, producer, producer->length(), stream_id, NULL, false);
+}
+
+bool LongMessageServiceEx::sendLongMessage(LongMessageProducer *producer, const byte stream_id)
+{
+  return queueLongMessage(producer, stream_id) == LONG_MESSAGE_SEND_OK;
 }
 
 //
-/// initiate sending of a long message
 /// this method sends the first message - the header packet
 /// the remainder of the message is sent in fragments from the process() method
 //
-bool LongMessageServiceEx::sendLongMessage(const void *msg, const unsigned int msg_len, const byte stream_id)
+LongMessageSendStatus LongMessageServiceEx::startSending(const byte *msg, LongMessageProducer *producer, const unsigned int msg_len, const byte stream_id, void (*completed)(const void *msg, byte stream_id), bool copy)
 {
-	byte i;
-	uint16_t msg_crc = 0;
-	VlcbMessage frame;
+  byte i, free_context = _num_send_contexts;
+  uint16_t msg_crc = 0;
+  VlcbMessage frame;
 
-	// DEBUG_SERIAL << F("> Lex: sending message header packet, stream id = ") << stream_id << F(", message length = ") << msg_len << endl;
+  // DEBUG_SERIAL << F("> Lex: sending message header packet, stream id = ") << stream_id << F(", message length = ") << msg_len << endl;
 
-	// ensure we aren't already sending a message with this stream ID
-	for (i = 0; i < _num_send_contexts; i++)
+  if (_send_context == NULL)
   {
-		if (_send_context[i]->in_use && _send_context[i]->send_stream_id == stream_id)
-    {
-			// DEBUG_SERIAL << F("> Lex: ERROR: already sending this stream ID") << endl;
-			return false;
-		}
-	}
+    return LONG_MESSAGE_SEND_NOT_ALLOCATED;
+  }
 
-	// find a free send context
-	for (i = 0; i < _num_send_contexts; i++)
+  // ensure we aren't already sending a message with this stream ID and find a free send context
+  for (i = 0; i < _num_send_contexts; i++)
   {
-		if (!_send_context[i]->in_use)
+    if (!_send_context[i].in_use)
     {
-			break;
-		}
-	}
+      if (free_context == _num_send_contexts)
+      {
+        free_context = i;
+      }
+    }
+    else if (_send_context[i].send_stream_id == stream_id)
+    {
+      // DEBUG_SERIAL << F("> Lex: ERROR: already sending this stream ID") << endl;
+      return LONG_MESSAGE_SEND_STREAM_BUSY;
+    }
+  }
 
-	if (i > _num_send_contexts)
+  if (free_context == _num_send_contexts)
   {
-		// DEBUG_SERIAL << F("> Lex: ERROR: unable to find free send context") << endl;
-		return false;
-	}
+    // DEBUG_SERIAL << F("> Lex: ERROR: unable to find free send context") << endl;
+    return LONG_MESSAGE_SEND_NO_CONTEXT;
+  }
 
-	// DEBUG_SERIAL << F("> Lex: using send context = ") << i << endl;
+  // DEBUG_SERIAL << F("> Lex: using send context = ") << free_context << endl;
 
-	// initialise context
-	_send_context[i]->in_use = true;
-	// _send_context[i]->buffer = (byte *)msg;
-	_send_context[i]->buffer = (byte *)strdup((char *)msg);														// copy the message to the send content, will free later
-	_send_context[i]->send_buffer_len = msg_len;
-	_send_context[i]->send_stream_id = stream_id;
-  _send_context[i]->send_buffer_index = 0;
+  send_context_t &context = _send_context[free_context];
+  byte *buffer = (byte *)msg;
+  bool heap_copy = false;
+  if (copy)
+  {
+    if (msg_len <= _send_pool_buffer_len)
+    {
+      buffer = _send_buffers + free_context * _send_pool_buffer_len;
+    }
+    else
+    {
+      buffer = (byte *)malloc(msg_len);
+      if (buffer == NULL)
+      {
+        // DEBUG_SERIAL << F("> Lex: ERROR: message too long for send buffer") << endl;
+        return LONG_MESSAGE_SEND_TOO_LONG;
+      }
+      heap_copy = true;
+    }
+  }
 
-	// calc CRC
-	if (_use_crc)
+  // calc CRC
+  if (_use_crc)
   {
-		msg_crc = crc16((uint8_t *)msg, msg_len);
-	}
+    msg_crc = messageCrc(msg, producer, msg_len);
+  }
 
-	// send the first fragment which forms the header message
-	frame.data[1] = _send_context[i]->send_stream_id;																	// the stream id
-	frame.data[2] = 0;																																// sequence number, 0 = header packet
-	frame.data[3] = highByte(_send_context[i]->send_buffer_len);										  // the message length
-	frame.data[4] = lowByte(_send_context[i]->send_buffer_len);
-	frame.data[5] = highByte(msg_crc);																							  // CRC, zero if not implemented
-	frame.data[6] = lowByte(msg_crc);
-	frame.data[7] = 0;																																// flags - 0 = standard data message
+  // send the first fragment which forms the header message
+  frame.data[1] = stream_id;                  // the stream id
+  frame.data[2] = 0;                          // sequence number, 0 = header packet
+  frame.data[3] = highByte(msg_len);          // the message length
+  frame.data[4] = lowByte(msg_len);
+  frame.data[5] = highByte(msg_crc);          // CRC, zero if not implemented
+  frame.data[6] = lowByte(msg_crc);
+  frame.data[7] = 0;                          // flags - 0 = standard data message
 
-	bool ret = sendMessageFragment(&frame);					// send the header packet
-	_send_context[i]->send_sequence_num = 1;																	  			// the next send sequence number - it's fine if it wraps around
+  if (!sendMessageFragment(&frame))
+  {
+    // DEBUG_SERIAL << F("> Lex: ERROR: could not send header packet") << endl;
+    if (heap_copy)
+    {
+      free(buffer);
+    }
+    return LONG_MESSAGE_SEND_FAILED;
+  }
 
-	// DEBUG_SERIAL << F("> Lex: message header sent, stream id = ") << stream_id << F(", message length = ") << msg_len << F(", ret = ") << ret << endl;
-	return (ret);
+  // initialise context
+  if (copy)
+  {
+    memcpy(buffer, msg, msg_len);
+  }
+  context.buffer = buffer;
+  context.heap_copy = heap_copy;
+  context.in_use = true;
+  context.producer = producer;
+  context.completed = completed;
+  context.send_buffer_len = msg_len;
+  context.send_stream_id = stream_id;
+  context.send_buffer_index = 0;
+  context.send_sequence_num = 1;              // the next send sequence number - it's fine if it wraps around
+  context.last_fragment_sent = millis();
+  context.send_started = context.last_fragment_sent;
+  context.bytes_per_second = 0;
+
+  // DEBUG_SERIAL << F("> Lex: message header sent, stream id = ") << stream_id << F(", message length = ") << msg_len << endl;
+  return LONG_MESSAGE_SEND_OK;
 }
 
 //
@@ -461,66 +707,133 @@ bool LongMessageServiceEx::sendLongMessage(const void *msg, const unsigned int m
 //
 bool LongMessageServiceEx::process()
 {
-	bool ret = true;
-	byte i;
-	VlcbMessage frame;
+  bool ret = true;
+  byte i;
+  VlcbMessage frame;
 
-	static byte context = 0;				// we round-robin the context list when sending
+  if (_send_context == NULL)
+  {
+    return ret;
+  }
 
-	/// check receive timeout for each active context
+  /// check receive timeout for each active context
 
-	for (i = 0; i < _num_receive_contexts; i++)
+  for (i = 0; i < _num_receive_contexts; i++)
   {
-		if (_receive_context[i]->in_use && (millis() - _receive_context[i]->last_fragment_received >= _receive_timeout))
+    if (_receive_context[i].in_use && (millis() - _receive_context[i].last_fragment_received >= _receive_timeout))
     {
-			// DEBUG_SERIAL << F("> Lex: ERROR: timed out waiting for continuation packet in context = ") << i << F(", timeout = ") << _receive_timeout << endl;
-			(void)(*_messagehandler)(_receive_context[i]->buffer, _receive_context[i]->receive_buffer_index, _receive_context[i]->receive_stream_id, LONG_MESSAGE_TIMEOUT_ERROR);
-			_receive_context[i]->in_use = false;
-			// _receive_context[i]->incoming_message_length = 0;
-			// _receive_context[i]->incoming_bytes_received = 0;
-		}
-	}
+      // DEBUG_SERIAL << F("> Lex: ERROR: timed out waiting for continuation packet in context = ") << i << F(", timeout = ") << _receive_timeout << endl;
+      endReceive(_receive_context[i], LONG_MESSAGE_TIMEOUT_ERROR);
+    }
+  }
+
+  /// send the next outgoing fragments, paced to avoid flooding the bus
+  /// concurrent streams will be interleaved, we round-robin the context list when sending
+  /// stop when the burst is used up or a whole round finds no context ready to send
 
-	/// send the next outgoing fragment from each active context, after a configurable delay to avoid flooding the bus
-	/// concurrent streams will be interleaved
-	if (_send_context[context]->in_use && millis() - _send_context[context]->last_fragment_sent >= _msg_delay)
+  byte burst = fragmentBurst();
+  unsigned int delay = fragmentDelay();
+  for (byte idle = 0; burst > 0 && idle < _num_send_contexts; )
   {
-		// DEBUG_SERIAL << F("> Lex: processing send context = ") << context << endl;
+    send_context_t &context = _send_context[_next_send_context];
 
-		memset(&frame.data, 0, sizeof(frame.data));
-		frame.data[1] = _send_context[context]->send_stream_id;
-		frame.data[2] = _send_context[context]->send_sequence_num;
+    // increment context counter and wrap
+    ++_next_send_context;
+    _next_send_context = (_next_send_context >= _num_send_contexts) ? 0 : _next_send_context;
 
-		/// only the last fragment is potentially less than 5 bytes long
-    for (i = 0; i < 5 && _send_context[context]->send_buffer_index < _send_context[context]->send_buffer_len; i++)  // for up to 5 bytes of payload
+    if (!context.in_use || millis() - context.last_fragment_sent < delay)
     {
-			frame.data[i + 3] = _send_context[context]->buffer[_send_context[context]->send_buffer_index];																// take the next byte
-			// DEBUG_SERIAL << F("> Lex: consumed data byte = ") << (char)_send_context[context]->buffer[_send_context[context]->send_buffer_index] << endl;
-			++_send_context[context]->send_buffer_index;
-		}
+      ++idle;
+      continue;
+    }
+
+    memset(&frame.data, 0, sizeof(frame.data));
+    frame.data[1] = context.send_stream_id;
+    frame.data[2] = context.send_sequence_num;
 
-		ret = sendMessageFragment(&frame);																												// send the data packet
-		// DEBUG_SERIAL << F("> Lex: process: sent message fragment, seq = ") << _send_context[context]->send_sequence_num << F(", size = ") << i << F(", ret  = ") << ret << endl;
+    /// only the last fragment is potentially less than 5 bytes long
+    i = readFragment(context.buffer, context.producer, context.send_buffer_index, context.send_buffer_len, &frame.data[3]);
 
-		// release context once message content exhausted
-		if (_send_context[context]->send_buffer_index >= _send_context[context]->send_buffer_len)
+    ret = sendMessageFragment(&frame);                                              // send the data packet
+    // DEBUG_SERIAL << F("> Lex: process: sent message fragment, seq = ") << context.send_sequence_num << F(", size = ") << i << F(", ret  = ") << ret << endl;
+    if (!ret)
     {
-			_send_context[context]->in_use = false;
-			_send_context[context]->send_buffer_len = 0;
-			free(_send_context[context]->buffer);
-			// DEBUG_SERIAL << F("> Lex: message complete, context released") << endl;
+      // try the same fragment again next time
+      break;
     }
-    else
+
+    context.send_buffer_index += i;
+    context.last_fragment_sent = millis();
+    ++context.send_sequence_num;
+    --burst;
+    idle = 0;
+
+    // release context once message content exhausted
+    if (context.send_buffer_index >= context.send_buffer_len)
     {
-			++_send_context[context]->send_sequence_num;
-			_send_context[context]->last_fragment_sent = millis();
-		}
-	}
+      context.in_use = false;
+      context.bytes_per_second = bytesPerSecond(context.send_buffer_len, context.send_started);
+      if (context.producer != NULL)
+      {
+        context.producer->completed(context.send_stream_id);
+      }
+      else if (context.completed != NULL)
+      {
+        (*context.completed)(context.buffer, context.send_stream_id);
+      }
+      if (context.heap_copy)
+      {
+        free(context.buffer);
+      }
+      // DEBUG_SERIAL << F("> Lex: message complete, context released") << endl;
+    }
+  }
 
-	// increment context counter and wrap
-	++context;
-	context = (context >= _num_send_contexts) ? 0 : context;
-	return ret;
+  return ret;
+}
+
+//
+/// CRC of a whole message, reading it from the producer a fragment at a time if there is one
+//
+uint16_t LongMessageServiceEx::messageCrc(const byte *msg, LongMessageProducer *producer, unsigned int msg_len)
+{
+  if (producer == NULL)
+  {
+    return crc16(msg, msg_len);
+  }
+
+  byte fragment[5];
+  uint16_t crc = CRC16_INITIAL;
+  for (unsigned int index = 0; index < msg_len; )
+  {
+    byte count = readFragment(NULL, producer, index, msg_len, fragment);
+    crc = crc16Update(crc, fragment, count);
+    index += count;
+  }
+  return crc16Result(crc);
+}
+
+//
+/// achieved send rate of the stream in progress or the last one sent, in bytes per second
+/// returns 0 if this stream has not been sent
+//
+unsigned int LongMessageServiceEx::getBytesPerSecond(byte stream_id)
+{
+  unsigned int last_rate = 0;
+
+  for (byte i = 0; i < _num_send_contexts; i++)
+  {
+    if (_send_context[i].send_stream_id == stream_id)
+    {
+      if (_send_context[i].in_use)
+      {
+        return bytesPerSecond(_send_context[i].send_buffer_index, _send_context[i].send_started);
+      }
+      last_rate = _send_context[i].bytes_per_second;
+    }
+  }
+
+  return last_rate;
 }
 
 //
@@ -545,7 +858,7 @@ byte LongMessageServiceEx::is_sending()
 
 	for (i = 0, num_streams = 0; i < _num_send_contexts; i++)
   {
-    if (_send_context[i]->in_use)
+    if (_send_context[i].in_use)
     {
       ++num_streams;
 		}
@@ -555,230 +868,255 @@ byte LongMessageServiceEx::is_sending()
 }
 
 //
-/// handle an incoming long message Controller message fragment
+/// subscribe a sink object to one stream ID
+/// the sink gets the data of each message on this stream as it arrives, instead of the message handler
+/// a null sink removes the subscription
+/// returns false if there are already NUM_EX_SINKS streams with sinks
 //
-void LongMessageServiceEx::processReceivedMessageFragment(const VlcbMessage *frame)
+bool LongMessageServiceEx::subscribe(byte stream_id, LongMessageSink *sink)
 {
-	byte i, j, status;
-	uint16_t tmpcrc = 0;
+  byte free_slot = NUM_EX_SINKS;
 
-	// DEBUG_SERIAL << F("> Lex: handling incoming message fragment") << endl;
-	// DEBUG_SERIAL.flush();
+  for (byte i = 0; i < NUM_EX_SINKS; i++)
+  {
+    if (_sinks[i] != NULL && _sink_stream_ids[i] == stream_id)
+    {
+      _sinks[i] = sink;
+      return true;
+    }
+    if (_sinks[i] == NULL && free_slot == NUM_EX_SINKS)
+    {
+      free_slot = i;
+    }
+  }
 
-  if (frame->data[2] == 0)
+  if (sink == NULL)
   {
-    // sequence zero = a header packet with start of new stream
+    return true;
+  }
+  if (free_slot == NUM_EX_SINKS)
+  {
+    return false;
+  }
+  _sinks[free_slot] = sink;
+  _sink_stream_ids[free_slot] = stream_id;
+  return true;
+}
 
-    if (frame->data[7] == 0)
+LongMessageSink * LongMessageServiceEx::findSink(byte stream_id)
+{
+  for (byte i = 0; i < NUM_EX_SINKS; i++)
+  {
+    if (_sinks[i] != NULL && _sink_stream_ids[i] == stream_id)
     {
-      // flags = 0, standard message
+      return _sinks[i];
+    }
+  }
+  return NULL;
+}
 
-      // DEBUG_SERIAL << F("> Lex: this is a data message header packet") << endl;
+//
+/// find the context receiving a message on this stream, there are only a few contexts so scan them all
+//
+receive_context_t *LongMessageServiceEx::findReceiveContext(byte stream_id)
+{
+  for (byte i = 0; i < _num_receive_contexts; i++)
+  {
+    if (_receive_context[i].in_use && _receive_context[i].receive_stream_id == stream_id)
+    {
+      return &_receive_context[i];
+    }
+  }
+  return NULL;
+}
 
-      for (i = 0; i < _num_stream_ids; i++)
-      {
-        if (_stream_ids[i] == frame->data[1])
-        {
-          // are we subscribed to this stream id ?
+//
+/// accept headers of subscribed streams and continuation fragments of messages being received
+//
+bool LongMessageServiceEx::acceptsMessage(const VlcbMessage *msg)
+{
+  if (msg->data[0] != OPC_DTXC || _receive_context == NULL)
+  {
+    return false;
+  }
 
-          // DEBUG_SERIAL << F("> Lex: we are subscribed to this stream ID = ") << frame->data[1] << endl;
+  if (msg->data[2] != 0)
+  {
+    return findReceiveContext(msg->data[1]) != NULL;
+  }
 
-          // find a free receive context
-          for (i = 0; i < _num_receive_contexts; i++)
-          {
-            if (!_receive_context[i]->in_use)
-            {
-              // DEBUG_SERIAL << F("> Lex: using receive context = ") << i << endl;
-              break;
-            }
-          }
+  return findSink(msg->data[1]) != NULL || LongMessageService::acceptsMessage(msg);
+}
 
-          if (i < _num_receive_contexts)
-          {
-            _receive_context[i]->in_use = true;
-            _receive_context[i]->receive_stream_id = frame->data[1];
-            _receive_context[i]->incoming_message_length = (frame->data[3] << 8) + frame->data[4];
-            _receive_context[i]->incoming_message_crc = (frame->data[5] << 8) + frame->data[6];
-            _receive_context[i]->incoming_bytes_received = 0;
-            memset(_receive_context[i]->buffer, 0, _receive_buffer_len);
-            _receive_context[i]->receive_buffer_index = 0;
-            _receive_context[i]->expected_next_receive_sequence_num = 1;
-            _receive_context[i]->last_fragment_received = millis();
-            // DEBUG_SERIAL << F("> Lex: received header packet for stream id = ") << _receive_context[i]->receive_stream_id << F(", message length = ") << _receive_context[i]->incoming_message_length << endl;
-          }
-          else
-          {
-            // DEBUG_SERIAL << F("> Lex: unable to find free receive context for new message") << endl;
-          }
+//
+/// finish receiving a message and surface it with a status to its sink or the message handler
+//
+void LongMessageServiceEx::endReceive(receive_context_t &context, byte status)
+{
+  context.in_use = false;
 
-          break;
-        }
-      }
-    }
-    else
-    {
-      // DEBUG_SERIAL << F("> Lex: not handling header packet with non-zero flags") << endl;
-    }
+  if (context.sink != NULL)
+  {
+    context.sink->end(context.receive_stream_id, status);
   }
-  else
+  else if (_messagehandler != NULL)
   {
-    // continuation packet
+    (void) (*_messagehandler)(context.buffer, context.receive_buffer_index, context.receive_stream_id, status);
+  }
+}
 
-    // DEBUG_SERIAL << F("> Lex: this is a continuation packet") << endl;
+//
+/// handle an incoming long message Controller message fragment
+//
+void LongMessageServiceEx::processReceivedMessageFragment(const VlcbMessage *frame)
+{
+  byte i;
+  byte stream_id = frame->data[1];
 
-    // find a matching receive context, using the stream ID and sender CANID
-    for (i = 0; i < _num_receive_contexts; i++)
-    {
-      if (_receive_context[i]->in_use && _receive_context[i]->receive_stream_id == frame->data[1])
-      {
-        // DEBUG_SERIAL << F("> Lex: found matching receive context = ") << i << endl;
-        break;
-      }
-    }
+  // DEBUG_SERIAL << F("> Lex: handling incoming message fragment") << endl;
 
-    // return if not found
-    if (i >= _num_receive_contexts)
+  if (_receive_context == NULL)
+  {
+    return;
+  }
+
+  if (frame->data[2] == 0)
+  {
+    // sequence zero = a header packet with start of new stream
+
+    if (frame->data[7] != 0)
     {
-      // DEBUG_SERIAL << F("> Lex: did not find matching receive context") << endl;
+      // DEBUG_SERIAL << F("> Lex: not handling header packet with non-zero flags") << endl;
       return;
     }
 
-    // error if out of sequence
-    if (frame->data[2] != _receive_context[i]->expected_next_receive_sequence_num)
+    // are we subscribed to this stream id ?
+    LongMessageSink *sink = findSink(stream_id);
+    if (sink == NULL && !LongMessageService::acceptsMessage(frame))
     {
-      // DEBUG_SERIAL << F("> Lex: ERROR: expected receive sequence num = ") << _receive_context[i]->expected_next_receive_sequence_num << F(" but got = ") << frame->data[2] << endl;
-      (void) (*_messagehandler)(_receive_context[i]->buffer, _receive_context[i]->receive_buffer_index,
-                                _receive_context[i]->receive_stream_id, LONG_MESSAGE_SEQUENCE_ERROR);
-      _receive_context[i]->in_use = false;
       return;
     }
 
-    // consume up to 5 bytes of message data from this fragment
-    for (j = 0; j < 5; j++)
+    // a new header abandons a message in progress on the same stream
+    receive_context_t *in_progress = findReceiveContext(stream_id);
+    if (in_progress != NULL)
     {
-      // DEBUG_SERIAL << F("> Lex: consuming received data byte = ") << (char)frame->data[j + 3] << endl;
-      _receive_context[i]->buffer[_receive_context[i]->receive_buffer_index] = frame->data[j + 3];
-      ++_receive_context[i]->receive_buffer_index;
-      ++_receive_context[i]->incoming_bytes_received;
-      _receive_context[i]->last_fragment_received = millis();
-
-      // if we have consumed the entire message, surface it to the user's handler
-      if (_receive_context[i]->incoming_bytes_received >= _receive_context[i]->incoming_message_length)
-      {
-        // DEBUG_SERIAL << F("> Lex: message data has been fully consumed") << endl;
-
-        if (_use_crc && _receive_context[i]->incoming_message_crc != 0)
-        {
-          // DEBUG_SERIAL << F("> Lex: calculating CRC16") << endl;
-          tmpcrc = crc16((uint8_t *) _receive_context[i]->buffer, _receive_context[i]->receive_buffer_index);
-        }
-
-        if (_receive_context[i]->incoming_message_crc != tmpcrc)
-        {
-          // DEBUG_SERIAL << F("> Lex: message CRC error, expected = ") << _receive_context[i]->incoming_message_crc << F(", calculated = ") << tmpcrc << endl;
-          status = LONG_MESSAGE_CRC_ERROR;
-        }
-        else
-        {
-          status = LONG_MESSAGE_COMPLETE;
-        }
-
-        (void) (*_messagehandler)(_receive_context[i]->buffer, _receive_context[i]->receive_buffer_index,
-                                  _receive_context[i]->receive_stream_id, status);
-        _receive_context[i]->in_use = false;
-        break;
+      endReceive(*in_progress, LONG_MESSAGE_SEQUENCE_ERROR);
+    }
 
-        // if the buffer is now full, give the user what we have with an error status
-      }
-      else if (_receive_context[i]->receive_buffer_index >= _receive_buffer_len)
+    // find a free receive context
+    for (i = 0; i < _num_receive_contexts; i++)
+    {
+      if (!_receive_context[i].in_use)
       {
-        // DEBUG_SERIAL << F("> Lex: buffer is now full, message truncated") << endl;
-        (void) (*_messagehandler)(_receive_context[i]->buffer, _receive_context[i]->receive_buffer_index,
-                                  _receive_context[i]->receive_stream_id, LONG_MESSAGE_TRUNCATED);
-        _receive_context[i]->in_use = false;
         break;
       }
     }
 
-    // increment the expected next sequence number for this stream context
-    ++_receive_context[i]->expected_next_receive_sequence_num;
-	}
-}
-
-//
-/// set whether to calculate and compare a CRC of the message
-//
-void LongMessageServiceEx::use_crc(bool use_crc)
-{
-	_use_crc = use_crc;
-}
-
-///////////////////////////////////////////////////////////////////////////////
-//////// CRC implementations
-uint32_t crc32(const byte *s, size_t n)
-{
-	uint32_t crc = 0xFFFFFFFF;
+    if (i >= _num_receive_contexts)
+    {
+      // DEBUG_SERIAL << F("> Lex: unable to find free receive context for new message") << endl;
+      return;
+    }
 
-  for (size_t i = 0; i < n; i++)
-  {
-    uint8_t ch = s[i];
-    for (size_t j = 0; j < 8; j++)
+    // DEBUG_SERIAL << F("> Lex: using receive context = ") << i << endl;
+    receive_context_t &context = _receive_context[i];
+    context.in_use = true;
+    context.sink = sink;
+    context.receive_stream_id = stream_id;
+    context.incoming_message_length = (frame->data[3] << 8) + frame->data[4];
+    context.incoming_message_crc = (frame->data[5] << 8) + frame->data[6];
+    context.incoming_bytes_received = 0;
+    context.running_crc = CRC16_INITIAL;
+    context.receive_buffer_index = 0;
+    context.expected_next_receive_sequence_num = 1;
+    context.last_fragment_received = millis();
+
+    if (sink != NULL)
     {
-      uint32_t b = (ch ^ crc) & 1;
-      crc >>= 1;
-      if (b)
-      { crc = crc ^ 0xEDB88320; }
-      ch >>= 1;
+      sink->begin(stream_id, context.incoming_message_length);
     }
+    return;
   }
 
-  return ~crc;
-}
-
-/*
-//                                      16   12   5
-// this is the CCITT CRC 16 polynomial X  + X  + X  + 1.
-// This works out to be 0x1021, but the way the algorithm works
-// lets us use 0x8408 (the reverse of the bit pattern).  The high
-// bit is always assumed to be set, thus we only use 16 bits to
-// represent the 17 bit value.
-*/
+  // continuation packet, find the receive context of this stream
+  receive_context_t *found = findReceiveContext(stream_id);
+  if (found == NULL)
+  {
+    // DEBUG_SERIAL << F("> Lex: did not find matching receive context") << endl;
+    return;
+  }
+  receive_context_t &context = *found;
 
-// http://stjarnhimlen.se/snippets/crc-16.c
+  // error if out of sequence
+  if (frame->data[2] != (byte) context.expected_next_receive_sequence_num)
+  {
+    // DEBUG_SERIAL << F("> Lex: ERROR: expected receive sequence num = ") << context.expected_next_receive_sequence_num << F(" but got = ") << frame->data[2] << endl;
+    endReceive(context, LONG_MESSAGE_SEQUENCE_ERROR);
+    return;
+  }
 
-#define POLY 0x8408
+  // consume up to 5 bytes of message data from this fragment
+  unsigned int remaining = context.incoming_message_length - context.incoming_bytes_received;
+  byte count = remaining < 5 ? remaining : 5;
+  const byte *data = &frame->data[3];
+  context.last_fragment_received = millis();
+  ++context.expected_next_receive_sequence_num;
 
-uint16_t crc16(uint8_t *data_p, uint16_t length)
-{
-	uint8_t i;
-	uint16_t data;
-	uint16_t crc = 0xffff;
-
-  if (length == 0)
+  // update the CRC with the message data in this fragment
+  if (_use_crc && context.incoming_message_crc != 0)
   {
-    return (~crc);
+    context.running_crc = crc16Update(context.running_crc, data, count);
   }
 
-  do
+  if (context.sink != NULL)
   {
-    for (i = 0, data = (uint16_t) 0xff & *data_p++;
-         i < 8;
-         i++, data >>= 1)
+    if (!context.sink->write(context.incoming_bytes_received, data, count))
     {
-      if ((crc & 0x0001) ^ (data & 0x0001))
-      {
-        crc = (crc >> 1) ^ POLY;
-      }
-      else
-      { crc >>= 1; }
+      endReceive(context, LONG_MESSAGE_TRUNCATED);
+      return;
     }
-  } while (--length);
+  }
+  else
+  {
+    // if the buffer is now full, give the user what we have with an error status
+    if (context.receive_buffer_index + count > _receive_buffer_len)
+    {
+      // DEBUG_SERIAL << F("> Lex: buffer is now full, message truncated") << endl;
+      unsigned int room = _receive_buffer_len - context.receive_buffer_index;
+      memcpy(context.buffer + context.receive_buffer_index, data, room);
+      context.receive_buffer_index += room;
+      endReceive(context, LONG_MESSAGE_TRUNCATED);
+      return;
+    }
+    memcpy(context.buffer + context.receive_buffer_index, data, count);
+    context.receive_buffer_index += count;
+  }
+  context.incoming_bytes_received += count;
 
-  crc = ~crc;
-  data = crc;
-  crc = (crc << 8) | (data >> 8 & 0xff);
+  // if we have consumed the entire message, surface it
+  if (context.incoming_bytes_received >= context.incoming_message_length)
+  {
+    // DEBUG_SERIAL << F("> Lex: message data has been fully consumed") << endl;
+    if (_use_crc && context.incoming_message_crc != 0
+        && context.incoming_message_crc != crc16Result(context.running_crc))
+    {
+      // DEBUG_SERIAL << F("> Lex: message CRC error, expected = ") << context.incoming_message_crc << F(", calculated = ") << crc16Result(context.running_crc) << endl;
+      endReceive(context, LONG_MESSAGE_CRC_ERROR);
+    }
+    else
+    {
+      endReceive(context, LONG_MESSAGE_COMPLETE);
+    }
+  }
+}
 
-  return (crc);
+//
+/// set whether to calculate and compare a CRC of the message
+//
+void LongMessageServiceEx::use_crc(bool use_crc)
+{
+	_use_crc = use_crc;
 }
 
-}
\ No newline at end of file
+}
@@ -6,6 +6,8 @@
 #pragma once
 
 #include "Service.h"
+#include "Transport.h"
+#include "Storage.h"
 #include <vlcbdefs.hpp>
 
 namespace VLCB
@@ -15,6 +17,10 @@ const int LONG_MESSAGE_DEFAULT_DELAY = 20;      // delay in milliseconds between
 const int LONG_MESSAGE_RECEIVE_TIMEOUT = 5000;  // timeout waiting for next long message packet
 const int NUM_EX_CONTEXTS = 4;                  // number of send and receive contexts for extended implementation = number of concurrent messages
 const int EX_BUFFER_LEN = 64;                   // size of extended send and receive buffers
+const int NUM_EX_SINKS = 4;                     // number of streams that can be subscribed with a sink in the extended implementation
+const byte LONG_MESSAGE_MAX_BURST = 4;          // most fragments sent per call to process() while the transmit buffer is nearly empty
+const int LONG_MESSAGE_MAX_BACKOFF = 50;        // extra delay in milliseconds between fragments when the transmit buffer is full
+const byte LONG_MESSAGE_SPARE_ACTIONS = 4;      // room left in the action queue for other messages
 
 //
 /// Controller long message status codes
@@ -29,8 +35,99 @@ enum {
   LONG_MESSAGE_TRUNCATED
 };
 
+//
+/// status codes for starting to send a long message with LongMessageServiceEx
+//
+
+enum LongMessageSendStatus : byte {
+  LONG_MESSAGE_SEND_OK = 0,
+  LONG_MESSAGE_SEND_NOT_ALLOCATED,    // allocateContexts() has not been called or failed
+  LONG_MESSAGE_SEND_STREAM_BUSY,      // a message with this stream ID is already being sent
+  LONG_MESSAGE_SEND_NO_CONTEXT,       // all send contexts are in use
+  LONG_MESSAGE_SEND_TOO_LONG,         // the message does not fit in a send buffer and could not be copied to the heap
+  LONG_MESSAGE_SEND_FAILED            // the header packet could not be sent
+};
+
 struct VlcbMessage;
 
+//
+/// supplies the data of an outgoing long message as it is sent, a fragment at a time
+/// this lets messages be sent from storage or flash without a copy in RAM
+//
+class LongMessageProducer
+{
+public:
+  /// total number of bytes in the message
+  virtual unsigned int length() = 0;
+  /// copy count bytes of the message, starting at offset, to data
+  virtual void read(unsigned int offset, byte *data, byte count) = 0;
+  /// called when the last fragment has been sent
+  virtual void completed(byte /*stream_id*/) {}
+};
+
+//
+/// receives the data of an incoming long message as it arrives, for one subscribed stream
+//
+class LongMessageSink
+{
+public:
+  /// a new message of the given length has started
+  virtual void begin(byte /*stream_id*/, unsigned int /*length*/) {}
+  /// up to 5 bytes of message data starting at offset in the message
+  /// return false to stop receiving this message, it then ends with LONG_MESSAGE_TRUNCATED
+  virtual bool write(unsigned int offset, const byte *data, byte count) = 0;
+  /// the message has ended with LONG_MESSAGE_COMPLETE or an error status
+  virtual void end(byte stream_id, byte status) = 0;
+};
+
+//
+/// collects incoming long messages in a buffer provided by the user
+/// implement end() to act on each message
+//
+class BufferLongMessageSink : public LongMessageSink
+{
+public:
+  BufferLongMessageSink(byte *buffer, unsigned int size) : buffer(buffer), size(size) {}
+
+  virtual void begin(byte /*stream_id*/, unsigned int /*length*/) override { len = 0; }
+  virtual bool write(unsigned int offset, const byte *data, byte count) override
+  {
+    if (offset + count > size)
+    {
+      return false;
+    }
+    memcpy(buffer + offset, data, count);
+    len = offset + count;
+    return true;
+  }
+
+  /// number of bytes received of the current or last message
+  unsigned int getLength() const { return len; }
+
+protected:
+  byte *buffer;
+  unsigned int size;
+  unsigned int len = 0;
+};
+
+//
+/// sends a long message straight from a range of addresses in a Storage
+//
+class StorageLongMessageProducer : public LongMessageProducer
+{
+public:
+  StorageLongMessageProducer(Storage *storage, unsigned int address, unsigned int length)
+    : storage(storage), address(address), len(length) {}
+
+  virtual unsigned int length() override { return len; }
+  virtual void read(unsigned int offset, byte *data, byte count) override { storage->readBytes(address + offset, count, data); }
+
+private:
+  Storage *storage;
+  unsigned int address;
+  unsigned int len;
+};
+
 //
 /// a basic class to send and receive Controller long messages per MERG RFC 0005
 /// See https://www.merg.org.uk/merg_wiki/doku.php?id=rfc:longmessageprotocol
@@ -43,13 +140,17 @@ class LongMessageService : public Service
 public:
 
   virtual void process(const Action * action) override;
+  virtual bool acceptsMessage(const VlcbMessage *msg) override;
   bool sendLongMessage(const void *msg, const unsigned int msg_len, const byte stream_id);
+  bool sendLongMessage(LongMessageProducer *producer, const byte stream_id);
   void subscribe(byte *stream_ids, const byte num_stream_ids, void *receive_buffer, const unsigned int receive_buffer_len, void (*messagehandler)(void *fragment, const unsigned int fragment_len, const byte stream_id, const byte status));
   bool process();
   virtual void processReceivedMessageFragment(const VlcbMessage *frame);
   bool is_sending();
   void setDelay(byte delay_in_millis);
+  void setAdaptivePacing(Transport *transport, byte min_delay_in_millis = 0);
   void setTimeout(unsigned int timeout_in_millis);
+  unsigned int getBytesPerSecond(byte stream_id);
 
   virtual VlcbServiceTypes getServiceID() const override { return SERVICE_ID_STREAMING; }
   virtual byte getServiceVersionID() const override { return 1; }
@@ -58,6 +159,10 @@ protected:
 
   void handleMessage(const VlcbMessage *msg);
   bool sendMessageFragment(VlcbMessage *frame);
+  byte fragmentBurst();
+  unsigned int fragmentDelay();
+  static unsigned int bytesPerSecond(unsigned int bytes, unsigned long started);
+  static byte readFragment(const byte *buffer, LongMessageProducer *producer, unsigned int index, unsigned int length, byte *data);
 
   bool _is_receiving = false;
   byte *_send_buffer, *_receive_buffer;
@@ -66,9 +171,12 @@ protected:
   unsigned int _send_buffer_len = 0, _incoming_message_length = 0, _receive_buffer_len = 0, _receive_buffer_index = 0;
   unsigned int _send_buffer_index = 0, _incoming_message_crc = 0, _incoming_bytes_received = 0;
   unsigned int _receive_timeout = LONG_MESSAGE_RECEIVE_TIMEOUT, _send_sequence_num = 0, _expected_next_receive_sequence_num = 0;
-  unsigned long _last_fragment_sent = 0UL, _last_fragment_received = 0UL;
+  unsigned long _last_fragment_sent = 0UL, _last_fragment_received = 0UL, _send_started = 0UL;
+  unsigned int _send_bytes_per_second = 0;
+  Transport *_transport = NULL;                   // paces fragments by its transmit buffer usage if set
+  LongMessageProducer *_producer = NULL;          // supplies the message data instead of _send_buffer if set
 
-  void (*_messagehandler)(void *fragment, const unsigned int fragment_len, const byte stream_id, const byte status);        // user callback function to receive long message fragments
+  void (*_messagehandler)(void *fragment, const unsigned int fragment_len, const byte stream_id, const byte status) = NULL; // user callback function to receive long message fragments
 };
 
 
@@ -81,15 +189,20 @@ struct receive_context_t {
   byte receive_stream_id;
   byte *buffer;
   unsigned int receive_buffer_index, incoming_bytes_received, incoming_message_length, expected_next_receive_sequence_num, incoming_message_crc;
+  uint16_t running_crc;     // CRC of the message data received so far
+  LongMessageSink *sink;    // gets the message data instead of buffer if set
   unsigned long last_fragment_received;
 };
 
 struct send_context_t {
-  bool in_use;
+  bool in_use, heap_copy;   // heap_copy is set if buffer was allocated for a message longer than the pooled buffer
   byte send_stream_id, msg_delay;
   byte *buffer;
   unsigned int send_buffer_len, send_buffer_index, send_sequence_num;
-  unsigned long last_fragment_sent;
+  unsigned long last_fragment_sent, send_started;
+  unsigned int bytes_per_second;
+  void (*completed)(const void *msg, byte stream_id);   // set when sending from a buffer owned by the caller
+  LongMessageProducer *producer;                        // supplies the message data instead of buffer if set
 };
 
 //
@@ -99,20 +212,39 @@ class LongMessageServiceEx : public LongMessageService
 {
 public:
 
-  bool allocateContexts(byte num_receive_contexts = NUM_EX_CONTEXTS, unsigned int receive_buffer_len = EX_BUFFER_LEN, byte num_send_contexts = NUM_EX_CONTEXTS);
+  ~LongMessageServiceEx();
+  bool allocateContexts(byte num_receive_contexts = NUM_EX_CONTEXTS, unsigned int receive_buffer_len = EX_BUFFER_LEN, byte num_send_contexts = NUM_EX_CONTEXTS, unsigned int send_buffer_len = EX_BUFFER_LEN);
   bool sendLongMessage(const void *msg, const unsigned int msg_len, const byte stream_id);
+  LongMessageSendStatus queueLongMessage(const void *msg, const unsigned int msg_len, const byte stream_id);
+  LongMessageSendStatus queueLongMessage(const void *msg, const unsigned int msg_len, const byte stream_id, void (*completed)(const void *msg, byte stream_id));
+  bool sendLongMessage(LongMessageProducer *producer, const byte stream_id);
+  LongMessageSendStatus queueLongMessage(LongMessageProducer *producer, const byte stream_id);
   bool process();
   void subscribe(byte *stream_ids, const byte num_stream_ids, void (*messagehandler)(void *msg, unsigned int msg_len, byte stream_id, byte status));
+  bool subscribe(byte stream_id, LongMessageSink *sink);
+  virtual bool acceptsMessage(const VlcbMessage *msg) override;
   virtual void processReceivedMessageFragment(const VlcbMessage *frame);
   byte is_sending();
   void use_crc(bool use_crc);
+  unsigned int getBytesPerSecond(byte stream_id);
 
 private:
 
+  LongMessageSendStatus startSending(const byte *msg, LongMessageProducer *producer, const unsigned int msg_len, const byte stream_id, void (*completed)(const void *msg, byte stream_id), bool copy);
+  void releaseContexts();
+  uint16_t messageCrc(const byte *msg, LongMessageProducer *producer, unsigned int msg_len);
+  LongMessageSink *findSink(byte stream_id);
+  receive_context_t *findReceiveContext(byte stream_id);
+  void endReceive(receive_context_t &context, byte status);
+
   bool _use_crc = false;
-  byte _num_receive_contexts = NUM_EX_CONTEXTS, _num_send_contexts = NUM_EX_CONTEXTS;
-  receive_context_t **_receive_context = NULL;
-  send_context_t **_send_context = NULL;
+  byte _num_receive_contexts = 0, _num_send_contexts = 0, _next_send_context = 0;
+  unsigned int _send_pool_buffer_len = 0;
+  receive_context_t *_receive_context = NULL;
+  send_context_t *_send_context = NULL;
+  byte *_receive_buffers = NULL, *_send_buffers = NULL;   // pooled buffers, one slice per context
+  byte _sink_stream_ids[NUM_EX_SINKS];
+  LongMessageSink *_sinks[NUM_EX_SINKS] = {};
 };
 
 }
\ No newline at end of file
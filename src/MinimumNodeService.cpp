@@ -34,6 +34,11 @@ void MinimumNodeService::begin()
   //Initialise instantMode
   instantMode = controller->getModuleConfig()->currentMode;
   noHeartbeat = !controller->getModuleConfig()->heartbeat;
+  lastHeartbeat = millis();
+  if (spreadHeartbeat)
+  {
+    lastHeartbeat -= controller->responseDelay(heartRate);
+  }
   controller->indicateMode(instantMode);
   //DEBUG_SERIAL << F("> instant MODE initialise as: ") << instantMode << endl;
   
@@ -111,6 +116,20 @@ void MinimumNodeService::heartbeat()
   }  
 }
 
+void MinimumNodeService::checkPendingPnn()
+{
+  if (pnnPending && (millis() - qnnTime) >= controller->responseDelay(qnnResponseWindow))
+  {
+    pnnPending = false;
+    sendPnn();
+  }
+}
+
+void MinimumNodeService::sendPnn()
+{
+  controller->sendMessageWithNN(OPC_PNN, controller->getParam(PAR_MANU), controller->getParam(PAR_MTYP), controller->getParam(PAR_FLAGS));
+}
+
 //
 // MinimumNode Service processing procedure
 //
@@ -172,9 +191,35 @@ void MinimumNodeService::process(const Action *action)
     }
   }
 
+  checkPendingPnn();
   heartbeat();
 }
 
+bool MinimumNodeService::acceptsMessage(const VlcbMessage *msg)
+{
+  unsigned int nn = Configuration::getTwoBytes(&msg->data[1]);
+
+  switch (msg->data[0])
+  {
+    case OPC_RQNP:
+    case OPC_SNN:
+    case OPC_RQNN:
+    case OPC_QNN:
+    case OPC_RQMN:
+      return true;
+
+    case OPC_RQNPN:
+    case OPC_RQSD:
+    case OPC_MODE:
+    case OPC_NNRSM:
+    case OPC_NNRST:
+      return isThisNodeNumber(nn);
+
+    default:
+      return false;
+  }
+}
+
 void MinimumNodeService::handleMessage(const VlcbMessage *msg)
 {
   unsigned int opc = msg->data[0];
@@ -220,7 +265,15 @@ void MinimumNodeService::handleMessage(const VlcbMessage *msg)
       if (module_config->nodeNum > 0)
       {
         // DEBUG_SERIAL << ("> responding with PNN message") << endl;
-        controller->sendMessageWithNN(OPC_PNN, controller->getParam(PAR_MANU), controller->getParam(PAR_MTYP), controller->getParam(PAR_FLAGS));
+        if (qnnResponseWindow == 0)
+        {
+          sendPnn();
+        }
+        else if (!pnnPending)
+        {
+          pnnPending = true;
+          qnnTime = millis();
+        }
         controller->messageActedOn();
       }
       break;
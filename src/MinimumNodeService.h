@@ -33,7 +33,17 @@ public:
   virtual byte getServiceVersionID() const override { return 1; }
   
   virtual void begin() override;
+  virtual bool acceptsMessage(const VlcbMessage *msg) override;
+  /// @endcond
+
+  /// Spread replies to QNN over a window instead of replying at once.
+  /// A window of 0 (the default) replies at once.
+  void setQnnResponseWindow(unsigned int windowMillis) { qnnResponseWindow = windowMillis; }
+  /// Offset heartbeats by CANID so that nodes started together do not send
+  /// their heartbeats at the same time. Call before begin().
+  void setSpreadHeartbeat(bool spread) { spreadHeartbeat = spread; }
 
+  /// @cond LIBRARY
   ///@name Backdoors for testing
   /// Access to these functions is provided purely for the purpose of testing VLCB by forcing
   /// specific modes.
@@ -64,12 +74,19 @@ private:
   /// is not in progress, it will cause OPC_HEARTB to be sent at a frequency determined
   /// by heartRate.
   void heartbeat();
+  /// Sends a PNN that was delayed by the QNN response window.
+  void checkPendingPnn();
+  void sendPnn();
   
   unsigned long lastHeartbeat = 0;
   byte heartbeatSequence = 0;
   bool noHeartbeat = false;
   unsigned int heartRate = 5000;
   bool notFcuCompatible = false;  //Compatible is default
+  bool spreadHeartbeat = false;
+  unsigned int qnnResponseWindow = 0;
+  bool pnnPending = false;
+  unsigned long qnnTime;
 
   /// Gets and sends node parameters when ACT_MESSAGE_IN is OPC_RQNP and the node is in
   /// MODE_SETUP.
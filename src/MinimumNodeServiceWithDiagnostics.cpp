@@ -9,6 +9,15 @@
 namespace VLCB
 {
 
+bool MinimumNodeServiceWithDiagnostics::acceptsMessage(const VlcbMessage *msg)
+{
+  if (msg->data[0] == OPC_RDGN)
+  {
+    return isThisNodeNumber(Configuration::getTwoBytes(&msg->data[1]));
+  }
+  return MinimumNodeService::acceptsMessage(msg);
+}
+
 void MinimumNodeServiceWithDiagnostics::handleMessage(const VlcbMessage *msg)
 {
   unsigned int opc = msg->data[0];
@@ -24,6 +24,20 @@ Service::Data NodeVariableService::getServiceData()
   return {controller->getModuleConfig()->getNumNodeVariables(), 0, 0};
 }
 
+bool NodeVariableService::acceptsMessage(const VlcbMessage *msg)
+{
+  switch (msg->data[0])
+  {
+    case OPC_NVRD:
+    case OPC_NVSET:
+    case OPC_NVSETRD:
+      return isThisNodeNumber(Configuration::getTwoBytes(&msg->data[1]));
+
+    default:
+      return false;
+  }
+}
+
 void NodeVariableService::handleMessage(const VlcbMessage *msg)
 {
   unsigned int opc = msg->data[0];
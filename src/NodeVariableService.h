@@ -26,6 +26,7 @@ public:
   virtual VlcbServiceTypes getServiceID() const override { return SERVICE_ID_NV; }
   virtual byte getServiceVersionID() const override { return 1; }
   virtual void process(const Action * action) override;
+  virtual bool acceptsMessage(const VlcbMessage *msg) override;
   virtual Data getServiceData() override;
   /// @endcond 
 
@@ -13,81 +13,167 @@
 // Class to transfer CAN frames using the GridConnect protocol over the serial port
 //
 // see GridConnect.cpp for more details on this protocol
+// and BinaryFraming.cpp for the binary alternative
 
 namespace VLCB
 {
 
-  bool SerialGC::begin()  
+  SerialGC::SerialGC(typeof(Serial)& _serial, byte receiveQueueSize, byte transmitBufferSize)
+    : serial(_serial)
+    , rxQueue(receiveQueueSize)
+    , rxQueueSize(receiveQueueSize)
+    , txRing(new char[transmitBufferSize])
+    , txRingSize(transmitBufferSize)
   {
-    Serial << F("> ** GridConnect over serial ** ") << endl;
+  }
+
+  SerialGC::~SerialGC()
+  {
+    delete[] txRing;
+  }
+
+  bool SerialGC::begin(SerialFraming framing)
+  {
+    this->framing = framing;
+    if (framing == SERIAL_FRAMING_GRIDCONNECT)
+    {
+      // Text would only confuse the other end when binary framing is used.
+      Serial << F("> ** GridConnect over serial ** ") << endl;
+    }
     receivedCount = 0;
     transmitCount = 0;
+    rxIndex = 0;
+    rxQueue.clear();
+    txRingTail = 0;
+    txRingCount = 0;
     return true;
   }
 
 
   //
-  // parse incoming characters & assemble message
-  // return true if valid message assembled & ready
+  /// parse all incoming characters that there is room for
+  /// return true if there are decoded frames ready
   //
   bool SerialGC::available()
   {
-    bool result = false;
-    static int rxIndex = 0;
-    if (serial.available())
-    {     
-      char c = serial.read();
-      c = toupper(c);
-      //
-      // if 'start of message' already seen, save the character, and check for 'end of message'
-      if (rxIndex > 0) 
+    // Make use of any room that the serial port has made since the last call.
+    flushTransmitBuffer();
+
+    // Leave characters in the serial buffer if there is no room for another frame.
+    while (rxQueue.reserve() != nullptr && serial.available())
+    {
+      if (framing == SERIAL_FRAMING_BINARY)
       {
-        rxBuffer[rxIndex++] = c;
-        // check if end of buffer reached, and restart if so
-        if (rxIndex >= RXBUFFERSIZE) 
-        {
-          rxIndex = 0;
-        }
-        //
-        // check for 'end of message'
-        if (c == ';')
-        {
-          rxBuffer[rxIndex++] = '\0';     // null terminate
-          rxIndex = 0;
-          result = true;
-        }
+        parseBinaryByte(serial.read());
       }
-      //
-      // always check for 'start of message'
-      if (c == ':') 
+      else
       {
-        rxIndex = 0;                    // restart at beginning of buffer
-        rxBuffer[rxIndex++] = c;
+        parseCharacter(serial.read());
       }
     }
-    //
-    if (result) 
+    return rxQueue.available();
+  }
+
+  //
+  /// add a character to the message being assembled
+  /// a ':' always starts a new message so that the parser resynchronises after a broken message
+  /// must only be called when there is room in the receive queue
+  //
+  void SerialGC::parseCharacter(char c)
+  {
+    if (c == ':')
+    {
+      // restart at beginning of buffer
+      rxBuffer[0] = c;
+      rxIndex = 1;
+      return;
+    }
+    if (rxIndex == 0)
+    {
+      // not in a message, ignore anything until 'start of message'
+      return;
+    }
+    if (rxIndex >= GRIDCONNECT_MAX_LENGTH)
+    {
+      // too long for a message, so drop it and wait for the next 'start of message'
+      rxIndex = 0;
+      receiveErrorCount++;
+      return;
+    }
+
+    rxBuffer[rxIndex++] = toupper(c);
+    if (c == ';')
     {
       // We have received a message between a ':' and a ';', so increment count
       receivedCount++;
-      result = decodeGridConnect(rxBuffer, &rxCANFrame);
-      if (!result)
+      // decode straight into the next free slot of the queue
+      if (decodeGridConnect(rxBuffer, rxIndex, rxQueue.reserve()))
+      {
+        rxQueue.commit();
+      }
+      else
       {
         // must have been an error in the message, so increment error counter
         receiveErrorCount++;
       }
+      rxIndex = 0;
     }
-    return result;
   }
 
 
   //
-  /// get the available CANMessage
+  /// add a byte to the binary frame being assembled
+  /// the first byte tells the length of the frame
+  /// after an error bytes are dropped one at a time until a valid frame is found
+  /// must only be called when there is room in the receive queue
+  //
+  void SerialGC::parseBinaryByte(uint8_t b)
+  {
+    uint8_t * buffer = (uint8_t *) rxBuffer;
+    buffer[rxIndex++] = b;
+
+    while (rxIndex > 0 && rxQueue.reserve() != nullptr)
+    {
+      byte length = binaryFrameLength(buffer[0]);
+      if (length > 0)
+      {
+        if (rxIndex < length)
+        {
+          // wait for the rest of the frame
+          return;
+        }
+        receivedCount++;
+        if (decodeBinaryFrame(buffer, length, rxQueue.reserve()))
+        {
+          rxQueue.commit();
+          rxIndex -= length;
+          memmove(buffer, buffer + length, rxIndex);
+          continue;
+        }
+        // must have been an error in the frame, so increment error counter
+        receiveErrorCount++;
+      }
+      // not the start of a valid frame, try from the next byte
+      --rxIndex;
+      memmove(buffer, buffer + 1, rxIndex);
+    }
+  }
+
+  //
+  /// get the next available CANMessage
   /// must call available first to ensure there is something to get
   //
   CANFrame SerialGC::getNextCanFrame()
   {
-    return rxCANFrame;
+    return rxQueue.pop();
+  }
+
+  //
+  /// get the next available CANMessage with its payload copied straight to data
+  //
+  CanFrameHeader SerialGC::receiveCanFrame(uint8_t data[])
+  {
+    return CanFrameAdapter<CANFrame>::read(rxQueue.pop(), data);
   }
 
 
@@ -97,18 +183,95 @@ namespace VLCB
   //
   bool SerialGC::sendCanFrame(CANFrame *frame)
   {
-    transmitCount++;
-    bool result = encodeGridConnect(txBuffer, frame);
-    if (result)
+    return transmitCanFrame({frame->id, frame->ext, frame->rtr, frame->len}, frame->data);
+  }
+
+  //
+  /// encode the header and payload into the transmit buffer and write as much as
+  /// the serial port has room for
+  /// returns false if the frame cannot be encoded or there is no room for it
+  //
+  bool SerialGC::transmitCanFrame(const CanFrameHeader & header, const uint8_t data[])
+  {
+    byte length = (framing == SERIAL_FRAMING_BINARY)
+      ? encodeBinaryFrame((uint8_t *) txBuffer, header, data)
+      : encodeGridConnect(txBuffer, header, data);
+    if (length == 0)
     {
-      // output the message
-      serial.print(txBuffer);
+      transmitErrorCount++;
+      return false;
     }
-    else
+    if (length > txRingSize - txRingCount)
     {
-      transmitErrorCount++;
+      // Not even room to queue the frame. Let the caller decide what to do.
+      transmitDropCount++;
+      return false;
+    }
+
+    if (txRingCount > 0 || serial.availableForWrite() < length)
+    {
+      // The frame has to wait for earlier frames or for room in the serial port.
+      transmitWaitCount++;
+    }
+    byte head = (txRingTail + txRingCount) % txRingSize;
+    for (byte i = 0; i < length; ++i)
+    {
+      txRing[head] = txBuffer[i];
+      head = (head + 1) % txRingSize;
+    }
+    txRingCount += length;
+    if (txRingCount > transmitPeak)
+    {
+      transmitPeak = txRingCount;
+    }
+    transmitCount++;
+
+    flushTransmitBuffer();
+    return true;
+  }
+
+  //
+  /// write waiting characters without blocking, i.e. no more than the serial port has room for
+  //
+  void SerialGC::flushTransmitBuffer()
+  {
+    while (txRingCount > 0)
+    {
+      int space = serial.availableForWrite();
+      if (space <= 0)
+      {
+        return;
+      }
+      // Write the part up to the end of the ring in one go.
+      byte chunk = txRingSize - txRingTail;
+      if (chunk > txRingCount)
+      {
+        chunk = txRingCount;
+      }
+      if (chunk > space)
+      {
+        chunk = space;
+      }
+      serial.write(txRing + txRingTail, chunk);
+      txRingTail = (txRingTail + chunk) % txRingSize;
+      txRingCount -= chunk;
     }
-   return result;
+  }
+
+  //
+  /// number of decoded frames that can wait to be taken
+  //
+  unsigned int SerialGC::receiveBufferSize()
+  {
+    return rxQueueSize;
+  }
+
+  //
+  /// number of decoded frames waiting to be taken
+  //
+  unsigned int SerialGC::receiveBufferUsage()
+  {
+    return rxQueue.bufUse();
   }
 
   //
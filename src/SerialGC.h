@@ -10,6 +10,8 @@
 #include <Controller.h>
 #include <CanTransport.h>
 #include <GridConnect.h>
+#include <BinaryFraming.h>
+#include <CircularBuffer.h>
 
 namespace VLCB
 {
@@ -18,19 +20,48 @@ namespace VLCB
 
   // grid connect should be 28 characters maximum
   static const int RXBUFFERSIZE = 30;
+  // number of decoded frames waiting to be taken by CanService
+  static const byte DEFAULT_GC_RECEIVE_QUEUE_SIZE = 8;
+  // number of encoded characters waiting to be written to the serial port
+  static const byte DEFAULT_GC_TRANSMIT_BUFFER_SIZE = 128;
+
+  /// How CAN frames are represented on the serial connection.
+  enum SerialFraming : byte
+  {
+    SERIAL_FRAMING_GRIDCONNECT,  ///< GridConnect text messages such as ":S0020N9001;"
+    SERIAL_FRAMING_BINARY        ///< Compact binary frames with a CRC, see BinaryFraming.cpp
+  };
 
   /// @brief Implementation of the Transport interface class
   /// to support the gridconnect protocol over serial connection
+  ///
+  /// All characters waiting on the serial port are parsed on each call to available().
+  /// Decoded frames wait in a queue until they are taken. The receive buffer
+  /// usage and peak values refer to this queue.
+  ///
+  /// Frames to send are encoded into a transmit buffer which is written to the
+  /// serial port as far as it has room without blocking. The rest is written on
+  /// later calls. The transmit buffer usage and peak values refer to this buffer.
+  ///
+  /// Both ends can agree on a binary framing instead of GridConnect which takes
+  /// about half the number of bytes per frame.
   class SerialGC : public CanTransport
   {
   public:
-    SerialGC(typeof(Serial)& _serial = Serial) : serial(_serial) {}
+    SerialGC(typeof(Serial)& _serial = Serial, byte receiveQueueSize = DEFAULT_GC_RECEIVE_QUEUE_SIZE,
+             byte transmitBufferSize = DEFAULT_GC_TRANSMIT_BUFFER_SIZE);
+    ~SerialGC();
+    // Owns its transmit buffer so it cannot be copied.
+    SerialGC(const SerialGC &) = delete;
+    SerialGC & operator=(const SerialGC &) = delete;
     /// @cond LIBRARY
-    bool begin();
+    bool begin(SerialFraming framing = SERIAL_FRAMING_GRIDCONNECT);
 
     virtual bool available() override;
     virtual CANFrame getNextCanFrame() override;
     virtual bool sendCanFrame(CANFrame *frame) override;
+    virtual CanFrameHeader receiveCanFrame(uint8_t data[]) override;
+    virtual bool transmitCanFrame(const CanFrameHeader & header, const uint8_t data[]) override;
     virtual void reset() override;
     virtual byte getHardwareType() { return CAN_HW_SERIAL; };
 
@@ -38,25 +69,45 @@ namespace VLCB
     virtual unsigned int transmitCounter() override { return transmitCount; }
     virtual unsigned int receiveErrorCounter() override { return receiveErrorCount; }
     virtual unsigned int transmitErrorCounter() override { return transmitErrorCount; }
-    virtual unsigned int receiveBufferUsage() override { return 0; };
-    virtual unsigned int transmitBufferUsage() override { return 0; };
-    virtual unsigned int receiveBufferPeak() override { return 0; };
-    virtual unsigned int transmitBufferPeak() override { return 0; };
+    virtual unsigned int receiveBufferSize() override;
+    virtual unsigned int transmitBufferSize() override { return txRingSize; }
+    virtual unsigned int receiveBufferUsage() override;
+    virtual unsigned int transmitBufferUsage() override { return txRingCount; }
+    virtual unsigned int receiveBufferPeak() override { return rxQueue.getHighWaterMark(); };
+    virtual unsigned int transmitBufferPeak() override { return transmitPeak; };
+    virtual unsigned int transmitDropCounter() override { return transmitDropCount; }
     virtual unsigned int errorStatus() override { return 0; }
     /// @endcond
 
+    /// Number of frames that had to wait in the transmit buffer for earlier frames or for room in the serial port.
+    /// A serial link has no arbitration so this is not reported as lost CAN arbitration.
+    unsigned int transmitWaitCounter() const { return transmitWaitCount; }
+
   private:
     typeof(Serial)& serial;
 	
     char rxBuffer[RXBUFFERSIZE]; // Define a byte array to store the incoming data
     char txBuffer[RXBUFFERSIZE]; // Define a byte array to store the outgoing data
-    CANFrame rxCANFrame;
+    SerialFraming framing = SERIAL_FRAMING_GRIDCONNECT;
+    byte rxIndex = 0;            // next position in rxBuffer, 0 while waiting for ':'
+    CircularBuffer<CANFrame> rxQueue;
+    byte rxQueueSize;
+    char * txRing;               // encoded characters waiting for room in the serial port
+    byte txRingSize;
+    byte txRingTail = 0;         // next character to write to the serial port
+    byte txRingCount = 0;
 
     unsigned int receivedCount = 0;
     unsigned int transmitCount = 0;
     unsigned int receiveErrorCount = 0;
     unsigned int transmitErrorCount = 0;
+    unsigned int transmitPeak = 0;
+    unsigned int transmitWaitCount = 0;
+    unsigned int transmitDropCount = 0;
 
+    void parseCharacter(char c);
+    void parseBinaryByte(uint8_t b);
+    void flushTransmitBuffer();
     void debugCANMessage(CANFrame frame);
 
   };
@@ -5,6 +5,7 @@
 
 #include "SerialUserInterface.h"
 #include "Controller.h"
+#include "CanService.h"
 #include <Streaming.h>
 
 extern void printConfig();
@@ -123,6 +124,11 @@ void SerialUserInterface::processSerialInput()
         Serial << F("> free SRAM = ") << modconfig->freeSRAM() << F(" bytes") << endl;
         break;
 
+      case 'b':
+        // CAN bus load
+        printBusLoad();
+        break;
+
       case 's': // "s" == "setup"
         //Serial << F("SUI> Requesting mode change") << endl; Serial.flush();
         controller->putAction(ACT_CHANGE_MODE);
@@ -140,6 +146,26 @@ void SerialUserInterface::processSerialInput()
   }
 }
 
+void SerialUserInterface::printBusLoad()
+{
+  for (auto svc : controller->getServices())
+  {
+    if (svc->getServiceID() == SERVICE_ID_CAN)
+    {
+      const BusLoadMeter & meter = static_cast<CanService *>(svc)->getBusLoadMeter();
+      Serial << F("> CAN bus load at ") << meter.getBitRate() << F(" bit/s") << endl;
+      Serial << F("  RX 1s = ") << meter.getReceiveLoad() / 10 << '.' << meter.getReceiveLoad() % 10 << '%'
+             << F(", 10s = ") << meter.getReceiveLoad10s() / 10 << '.' << meter.getReceiveLoad10s() % 10 << '%' << endl;
+      Serial << F("  TX 1s = ") << meter.getTransmitLoad() / 10 << '.' << meter.getTransmitLoad() % 10 << '%'
+             << F(", 10s = ") << meter.getTransmitLoad10s() / 10 << '.' << meter.getTransmitLoad10s() % 10 << '%' << endl;
+      Serial << F("  frames/s = ") << meter.getFramesPerSecond()
+             << F(", peak frames/100ms = ") << meter.getPeakFramesPerSlot() << endl;
+      return;
+    }
+  }
+  Serial << F("> no CAN service") << endl;
+}
+
 void SerialUserInterface::handleAction(const Action *action)
 {
   if (action == nullptr)
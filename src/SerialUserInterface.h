@@ -24,12 +24,14 @@ public:
   virtual byte getServiceVersionID() const override { return 1; };
 
   virtual void process(const Action *action) override;
+  virtual bool acceptsMessage(const VlcbMessage * /*msg*/) override { return false; }
   /// @endcond
 
 private:
   void handleAction(const Action *action);
   void processSerialInput();
   void indicateMode(VlcbModeParams i);
+  void printBusLoad();
 };
 
 }
\ No newline at end of file
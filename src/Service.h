@@ -13,6 +13,7 @@ namespace VLCB
 
 class Controller;
 struct Action;
+struct VlcbMessage;
 
 /// @brief Interface base class for all VLCB services.
 /// 
@@ -33,6 +34,9 @@ public:
   virtual byte getServiceVersionID() const = 0;
 
   virtual void process(const Action * action) = 0;
+  /// Return false if process() would ignore this incoming message.
+  /// Messages that no service accepts are dropped before they are put on the action queue.
+  virtual bool acceptsMessage(const VlcbMessage * /*msg*/) { return true; }
 
   virtual void reportDiagnostics(byte serviceIndex, byte diagnosticsCode);
   virtual void reportAllDiagnostics(byte serviceIndex);
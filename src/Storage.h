@@ -22,6 +22,8 @@ public:
   virtual void writeBytes(unsigned int eeaddress, const byte src[], byte numbytes) = 0;
   virtual void reset() = 0;
   virtual void commitWriteEEPROM() {}
+  // Commit any pending writes now, regardless of any commit delay. Used before a reboot.
+  virtual void flush() { commitWriteEEPROM(); }
 };
 
 extern Storage * createDefaultStorageForPlatform();
@@ -14,6 +14,7 @@
 #include <LEDUserInterface.h>
 #include <MinimumNodeServiceWithDiagnostics.h>
 #include <CanServiceWithDiagnostics.h>
+#include <CanBridgeService.h>
 #include <NodeVariableService.h>
 #include <EventConsumerServiceWithDiagnostics.h>
 #include <EventProducerServiceWithDiagnostics.h>
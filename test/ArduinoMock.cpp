@@ -1,10 +1,14 @@
 #include <map>
+#include <deque>
+#include <vector>
+#include <string>
 #include <Arduino.h>
 #include <Streaming.h>
 #include <iostream>
 #include "Arduino.hpp"
 #include "ArduinoMock.hpp"
 #include "ACAN2515.h"
+#include "SPI.h"
 
 /* Functions provided by user sketch */
 
@@ -44,11 +48,18 @@ void addMillis(unsigned long newMillis)
         nextMillis += newMillis;
 }
 
+std::deque<char> serialInput;
+std::string serialOutput;
+int serialWriteSpace;
+
 void clearArduinoValues()
 {
         digitalReadValues.clear();
         analogWrittenValues.clear();
         nextMillis = 0L;
+        serialInput.clear();
+        serialOutput.clear();
+        serialWriteSpace = 64;
 }
 
 /* Arduino methods */
@@ -103,22 +114,63 @@ void Serial_T::begin(int baudRate)
 {
 }
 
-bool Serial_T::available()
+void setSerialInput(const char * characters)
 {
-  return true;
+  serialInput.insert(serialInput.end(), characters, characters + strlen(characters));
+}
+
+void setSerialInput(const std::string & bytes)
+{
+  serialInput.insert(serialInput.end(), bytes.begin(), bytes.end());
+}
+
+const std::string & getSerialOutput()
+{
+  return serialOutput;
+}
+
+void setSerialWriteSpace(int space)
+{
+  serialWriteSpace = space;
+}
+
+int Serial_T::available()
+{
+  return serialInput.size();
+}
+
+int Serial_T::availableForWrite()
+{
+  return serialWriteSpace;
 }
 
 char Serial_T::read()
 {
-  return ' ';
+  if (serialInput.empty())
+  {
+    return -1;
+  }
+  char c = serialInput.front();
+  serialInput.pop_front();
+  return c;
+}
+
+void Serial_T::print(const char * s)
+{
+  serialOutput += s;
 }
 
-void Serial_T::print(const char *)
+void Serial_T::println(const char * s)
 {
+  serialOutput += s;
+  serialOutput += "\n";
 }
 
-void Serial_T::println(const char *)
+size_t Serial_T::write(const char * buffer, size_t size)
 {
+  serialOutput.append(buffer, size);
+  serialWriteSpace -= size;
+  return size;
 }
 
 void Serial_T::flush()
@@ -173,6 +225,215 @@ void sei()
 
 /* ACAN2515 methods */
 
+std::deque<CANMessage> acanReceived;
+std::deque<CANMessage> acanPending;
+std::vector<CANMessage> acanSent;
+unsigned int acanTransmitCapacity;
+unsigned int acanTransmitPeak;
+
+unsigned int acanReceiveCapacity;
+uint8_t acanErrorFlags;
+
+// Hardware acceptance filters. RXB0 uses mask 0 and filters 0-1, RXB1 uses mask 1 and filters 2-5.
+uint16_t acanMasks[2];
+uint16_t acanFilters[6];
+uint8_t acanFilterCount;
+
+void clearAcan2515(unsigned int transmitCapacity, unsigned int receiveCapacity)
+{
+  acanReceiveCapacity = receiveCapacity;
+  acanErrorFlags = 0;
+  // Only the MCP2515 is on the SPI bus.
+  clearSpiBus();
+  acanFilterCount = 0;
+  acanReceived.clear();
+  acanPending.clear();
+  acanSent.clear();
+  acanTransmitCapacity = transmitCapacity;
+  acanTransmitPeak = 0;
+}
+
+static bool acan2515Accepts(const CANMessage & message)
+{
+  if (acanFilterCount == 0)
+  {
+    return true;
+  }
+  if (message.ext)
+  {
+    return false;
+  }
+  for (uint8_t i = 0; i < acanFilterCount; ++i)
+  {
+    uint16_t mask = acanMasks[i < 2 ? 0 : 1];
+    if (((message.id ^ acanFilters[i]) & mask) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void setAcan2515Received(const CANMessage & message)
+{
+  // The MCP2515 silently drops frames that do not pass its acceptance filters.
+  if (acan2515Accepts(message))
+  {
+    acanReceived.push_back(message);
+  }
+}
+
+uint8_t getAcan2515FilterCount()
+{
+  return acanFilterCount;
+}
+
+void setAcan2515ErrorFlags(uint8_t flags)
+{
+  acanErrorFlags = flags;
+}
+
+static uint16_t standardId(const ACAN2515Mask & mask)
+{
+  return (mask.mSIDH << 3) | (mask.mSIDL >> 5);
+}
+
+ACAN2515Mask standard2515Mask(const uint16_t inIdentifier, const uint8_t inByte0, const uint8_t inByte1)
+{
+  ACAN2515Mask mask;
+  mask.mSIDH = (uint8_t) (inIdentifier >> 3);
+  mask.mSIDL = (uint8_t) (inIdentifier << 5);
+  mask.mEID8 = inByte0;
+  mask.mEID0 = inByte1;
+  return mask;
+}
+
+ACAN2515Mask standard2515Filter(const uint16_t inIdentifier, const uint8_t inByte0, const uint8_t inByte1)
+{
+  return standard2515Mask(inIdentifier, inByte0, inByte1);
+}
+
+void completeAcan2515Transmissions()
+{
+  acanSent.insert(acanSent.end(), acanPending.begin(), acanPending.end());
+  acanPending.clear();
+}
+
+const std::vector<CANMessage> & getAcan2515Sent()
+{
+  return acanSent;
+}
+
+ACAN2515Settings::ACAN2515Settings(unsigned long, unsigned int)
+{
+}
+
+ACAN2515::ACAN2515(uint8_t i, SPIClass & aClass, uint8_t i1)
+{
+}
+
+unsigned short ACAN2515::begin(const ACAN2515Settings & settings, void (*isr)())
+{
+  return setFiltersOnTheFly();
+}
+
+unsigned short ACAN2515::begin(const ACAN2515Settings & settings, void (*isr)(),
+                               const ACAN2515Mask inRXM0, const ACAN2515Mask inRXM1,
+                               const ACAN2515AcceptanceFilter inAcceptanceFilters[], const uint8_t inAcceptanceFilterCount)
+{
+  return setFiltersOnTheFly(inRXM0, inRXM1, inAcceptanceFilters, inAcceptanceFilterCount);
+}
+
+uint16_t ACAN2515::setFiltersOnTheFly()
+{
+  acanFilterCount = 0;
+  return 0;
+}
+
+uint16_t ACAN2515::setFiltersOnTheFly(const ACAN2515Mask inRXM0, const ACAN2515Mask inRXM1,
+                                      const ACAN2515AcceptanceFilter inAcceptanceFilters[], const uint8_t inAcceptanceFilterCount)
+{
+  if (inAcceptanceFilterCount < 3 || inAcceptanceFilterCount > 6)
+  {
+    return 1;
+  }
+  acanMasks[0] = standardId(inRXM0);
+  acanMasks[1] = standardId(inRXM1);
+  for (uint8_t i = 0; i < inAcceptanceFilterCount; ++i)
+  {
+    acanFilters[i] = standardId(inAcceptanceFilters[i].mMask);
+  }
+  acanFilterCount = inAcceptanceFilterCount;
+  return 0;
+}
+
+void ACAN2515::isr()
+{
+}
+
+void ACAN2515::poll()
+{
+}
+
+void ACAN2515::end()
+{
+}
+
+bool ACAN2515::available()
+{
+  return !acanReceived.empty();
+}
+
+void ACAN2515::receive(CANMessage & message)
+{
+  message = acanReceived.front();
+  acanReceived.pop_front();
+}
+
+bool ACAN2515::tryToSend(const CANMessage & message)
+{
+  if (acanPending.size() >= acanTransmitCapacity)
+  {
+    return false;
+  }
+  acanPending.push_back(message);
+  if (acanPending.size() > acanTransmitPeak)
+  {
+    acanTransmitPeak = acanPending.size();
+  }
+  return true;
+}
+
+uint16_t ACAN2515::receiveBufferCount()
+{
+  return acanReceived.size();
+}
+
+uint16_t ACAN2515::receiveBufferPeakCount()
+{
+  return 0;
+}
+
+uint16_t ACAN2515::receiveBufferSize()
+{
+  return acanReceiveCapacity;
+}
+
+uint16_t ACAN2515::transmitBufferCount(uint8_t index)
+{
+  return acanPending.size();
+}
+
+uint16_t ACAN2515::transmitBufferPeakCount(uint8_t index)
+{
+  return acanTransmitPeak;
+}
+
+uint16_t ACAN2515::transmitBufferSize(uint8_t index)
+{
+  return acanTransmitCapacity;
+}
+
 uint8_t ACAN2515::receiveErrorCounter() 
 {
   return 0; 
@@ -185,5 +446,54 @@ uint8_t ACAN2515::transmitErrorCounter()
 
 uint8_t ACAN2515::errorFlagRegister()
 {
-  return 0; 
+  return acanErrorFlags;
+}
+
+/* SPI methods */
+
+SPIClass SPI;
+std::vector<std::vector<byte>> spiTransactions;
+MockSpiDevice * spiDevice;
+
+void clearSpiBus()
+{
+  spiTransactions.clear();
+  spiDevice = nullptr;
+}
+
+void attachSpiDevice(MockSpiDevice * device)
+{
+  spiDevice = device;
+}
+
+const std::vector<std::vector<byte>> & getSpiTransactions()
+{
+  return spiTransactions;
+}
+
+void SPIClass::begin()
+{
+}
+
+void SPIClass::beginTransaction(SPISettings settings)
+{
+  spiTransactions.push_back({});
+  if (spiDevice)
+  {
+    spiDevice->beginTransaction();
+  }
+}
+
+byte SPIClass::transfer(byte data)
+{
+  spiTransactions.back().push_back(data);
+  return spiDevice ? spiDevice->transfer(data) : 0;
+}
+
+void SPIClass::endTransaction()
+{
+  if (spiDevice)
+  {
+    spiDevice->endTransaction();
+  }
 }
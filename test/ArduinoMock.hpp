@@ -1,3 +1,5 @@
+#pragma once
+
 #include "Arduino.hpp"
 
 void setAnalogRead(int pin, int value);
@@ -7,4 +9,36 @@ PinState getDigitalWrite(int pin);
 
 void addMillis(unsigned long millis);
 
+// Serial mock. Characters given to setSerialInput() are returned by Serial.read().
+// Characters written with Serial.print() or Serial.write() are collected.
+// Serial.availableForWrite() starts at 64 and goes down as characters are written.
+#include <string>
+void setSerialInput(const char * characters);
+void setSerialInput(const std::string & bytes);
+const std::string & getSerialOutput();
+void setSerialWriteSpace(int space);
+
 void clearArduinoValues();
+
+// ACAN2515 mock. Frames handed to tryToSend() stay pending until
+// completeAcan2515Transmissions() is called.
+#include <vector>
+#include <ACAN2515.h>
+void clearAcan2515(unsigned int transmitCapacity, unsigned int receiveCapacity = 4);
+void setAcan2515Received(const CANMessage & message);
+void completeAcan2515Transmissions();
+const std::vector<CANMessage> & getAcan2515Sent();
+uint8_t getAcan2515FilterCount();
+void setAcan2515ErrorFlags(uint8_t flags);
+
+// SPI bus mock. All transactions on SPI are recorded. Bytes are also passed to
+// the attached device, if any, which returns the bytes read back.
+struct MockSpiDevice
+{
+  virtual void beginTransaction() = 0;
+  virtual byte transfer(byte data) = 0;
+  virtual void endTransaction() = 0;
+};
+void clearSpiBus();
+void attachSpiDevice(MockSpiDevice * device);
+const std::vector<std::vector<byte>> & getSpiTransactions();
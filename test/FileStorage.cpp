@@ -0,0 +1,190 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+//
+//
+
+#include "FileStorage.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+
+FileStorage::FileStorage(const char *path, unsigned int size)
+  : path(path)
+  , size(size)
+  , pageSize(sysconf(_SC_PAGESIZE))
+  , dirtyPages((size + pageSize - 1) / pageSize, false)
+{
+}
+
+FileStorage::~FileStorage()
+{
+  close();
+}
+
+void FileStorage::begin()
+{
+  if (isOpen())
+  {
+    return;
+  }
+
+  fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+  {
+    return;
+  }
+
+  struct stat st;
+  fstat(fd, &st);
+  unsigned int oldSize = st.st_size;
+  if (oldSize < size && ftruncate(fd, size) != 0)
+  {
+    ::close(fd);
+    fd = -1;
+    return;
+  }
+
+  void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+  {
+    ::close(fd);
+    fd = -1;
+    return;
+  }
+  image = static_cast<byte *>(p);
+
+  if (oldSize < size)
+  {
+    // New storage starts out erased, like an EEPROM.
+    memset(image + oldSize, 0xFF, size - oldSize);
+    markDirty(oldSize, size - oldSize);
+    commitWriteEEPROM();
+  }
+}
+
+void FileStorage::close()
+{
+  if (image != nullptr)
+  {
+    commitWriteEEPROM();
+    munmap(image, size);
+    image = nullptr;
+  }
+  if (fd >= 0)
+  {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+byte FileStorage::read(unsigned int eeaddress)
+{
+  if (!isOpen() || eeaddress >= size)
+  {
+    return 0xFF;
+  }
+  return image[eeaddress];
+}
+
+void FileStorage::write(unsigned int eeaddress, byte data)
+{
+  if (!isOpen() || eeaddress >= size)
+  {
+    return;
+  }
+  image[eeaddress] = data;
+  markDirty(eeaddress, 1);
+}
+
+byte FileStorage::readBytes(unsigned int eeaddress, byte nbytes, byte dest[])
+{
+  if (!isOpen() || eeaddress >= size)
+  {
+    return 0;
+  }
+  if (nbytes > size - eeaddress)
+  {
+    nbytes = size - eeaddress;
+  }
+  memcpy(dest, image + eeaddress, nbytes);
+  return nbytes;
+}
+
+void FileStorage::writeBytes(unsigned int eeaddress, const byte src[], byte numbytes)
+{
+  if (!isOpen() || eeaddress >= size)
+  {
+    return;
+  }
+  if (numbytes > size - eeaddress)
+  {
+    numbytes = size - eeaddress;
+  }
+  memcpy(image + eeaddress, src, numbytes);
+  markDirty(eeaddress, numbytes);
+}
+
+void FileStorage::reset()
+{
+  if (!isOpen())
+  {
+    return;
+  }
+  memset(image, 0xFF, size);
+  markDirty(0, size);
+}
+
+// Flush each run of consecutive dirty pages with a single msync().
+void FileStorage::commitWriteEEPROM()
+{
+  if (!isOpen())
+  {
+    return;
+  }
+
+  bool flushed = false;
+  unsigned int page = 0;
+  while (page < dirtyPages.size())
+  {
+    if (!dirtyPages[page])
+    {
+      ++page;
+      continue;
+    }
+    unsigned int first = page;
+    while (page < dirtyPages.size() && dirtyPages[page])
+    {
+      dirtyPages[page++] = false;
+    }
+    unsigned int start = first * pageSize;
+    unsigned int end = page * pageSize;
+    if (end > size)
+    {
+      end = size;
+    }
+    msync(image + start, end - start, MS_SYNC);
+    flushedPageCount += page - first;
+    flushed = true;
+  }
+  if (flushed)
+  {
+    ++flushCount;
+  }
+}
+
+void FileStorage::markDirty(unsigned int eeaddress, unsigned int nbytes)
+{
+  if (nbytes == 0)
+  {
+    return;
+  }
+  for (unsigned int page = eeaddress / pageSize; page <= (eeaddress + nbytes - 1) / pageSize; ++page)
+  {
+    dirtyPages[page] = true;
+  }
+}
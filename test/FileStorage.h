@@ -0,0 +1,49 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+//
+//
+
+#pragma once
+
+// Storage backed by a memory mapped file for running the node stack on Linux.
+// Data persists across process restarts and the file can be inspected offline.
+// Dirty pages are flushed to the file when commitWriteEEPROM() is called.
+
+#include <Storage.h>
+#include <string>
+#include <vector>
+
+class FileStorage : public VLCB::Storage
+{
+public:
+  FileStorage(const char *path, unsigned int size);
+  virtual ~FileStorage();
+
+  virtual void begin() override;
+  virtual byte read(unsigned int eeaddress) override;
+  virtual void write(unsigned int eeaddress, byte data) override;
+  virtual byte readBytes(unsigned int eeaddress, byte nbytes, byte dest[]) override;
+  virtual void writeBytes(unsigned int eeaddress, const byte src[], byte numbytes) override;
+  virtual void reset() override;
+  virtual void commitWriteEEPROM() override;
+
+  bool isOpen() const { return image != nullptr; }
+  void close();
+  unsigned int getSize() const { return size; }
+  unsigned int getFlushCount() const { return flushCount; }
+  unsigned int getFlushedPageCount() const { return flushedPageCount; }
+
+private:
+  void markDirty(unsigned int eeaddress, unsigned int nbytes);
+
+  std::string path;
+  unsigned int size;
+  unsigned int pageSize;
+  int fd = -1;
+  byte *image = nullptr;
+  std::vector<bool> dirtyPages;
+  unsigned int flushCount = 0;
+  unsigned int flushedPageCount = 0;
+};
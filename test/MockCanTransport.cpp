@@ -21,10 +21,30 @@ VLCB::CANFrame MockCanTransport::getNextCanFrame()
 
 bool MockCanTransport::sendCanFrame(VLCB::CANFrame *frame)
 {
+  if (sendFails)
+  {
+    return false;
+  }
   sent_frames.push_back(*frame);
   return true;
 }
 
+VLCB::CanFrameHeader MockCanTransport::receiveCanFrame(uint8_t data[])
+{
+  lastReceiveData = data;
+  VLCB::CanFrameHeader header = VLCB::CanFrameAdapter<VLCB::CANFrame>::read(incoming_frames.front(), data);
+  incoming_frames.pop_front();
+  return header;
+}
+
+bool MockCanTransport::transmitCanFrame(const VLCB::CanFrameHeader & header, const uint8_t data[])
+{
+  lastTransmitData = data;
+  VLCB::CANFrame frame;
+  VLCB::CanFrameAdapter<VLCB::CANFrame>::write(frame, header, data);
+  return sendCanFrame(&frame);
+}
+
 void MockCanTransport::reset()
 {
 
@@ -20,6 +20,8 @@ public:
   virtual bool available() override;
   virtual VLCB::CANFrame getNextCanFrame() override;
   virtual bool sendCanFrame(VLCB::CANFrame *frame) override;
+  virtual VLCB::CanFrameHeader receiveCanFrame(uint8_t data[]) override;
+  virtual bool transmitCanFrame(const VLCB::CanFrameHeader & header, const uint8_t data[]) override;
   virtual byte getHardwareType() override { return 47; }
   
   virtual void reset() override;
@@ -28,15 +30,27 @@ public:
   virtual unsigned int transmitCounter() override { return 42; }
   virtual unsigned int receiveErrorCounter() override { return 0; }
   virtual unsigned int transmitErrorCounter() override { return 0; }
-  virtual unsigned int receiveBufferUsage() override { return 0; };
-  virtual unsigned int transmitBufferUsage() override { return 0; };
+  virtual unsigned int receiveBufferSize() override { return 0; }
+  virtual unsigned int transmitBufferSize() override { return transmitSize; }
+  virtual unsigned int receiveBufferUsage() override { return incoming_frames.size(); };
+  virtual unsigned int transmitBufferUsage() override { return transmitUsage; };
   virtual unsigned int receiveBufferPeak() override { return 0; };
   virtual unsigned int transmitBufferPeak() override { return 0; };
   virtual unsigned int errorStatus() override { return 0; }
 
   void setNextMessage(VLCB::CANFrame frame);
   void clearMessages();
+  // CAN priority bits of a sent frame.
+  byte sentPriority(int index) const { return (sent_frames[index].id >> 7) & 0x0F; }
 
   std::deque<VLCB::CANFrame> incoming_frames;
   std::vector<VLCB::CANFrame> sent_frames;
+  // Where the payload of the last frame was received into and sent from.
+  const uint8_t * lastReceiveData = nullptr;
+  const uint8_t * lastTransmitData = nullptr;
+  // Refuse to send frames as if the transmit buffers are full.
+  bool sendFails = false;
+  // Reported transmit buffer size and usage.
+  unsigned int transmitSize = 0;
+  unsigned int transmitUsage = 0;
 };
@@ -0,0 +1,42 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+//
+//
+
+#include "MockDueFlash.h"
+#include <DueFlashStorage.h>
+
+MockDueFlash mockDueFlash;
+
+void MockDueFlash::reset(unsigned long size)
+{
+  // Erased flash reads as 0xFF.
+  memory.assign(size, 0xFF);
+  writeCount = 0;
+}
+
+/* DueFlashStorage methods */
+
+byte DueFlashStorage::read(uint32_t address)
+{
+  return mockDueFlash.memory[address];
+}
+
+byte * DueFlashStorage::readAddress(uint32_t address)
+{
+  return &mockDueFlash.memory[address];
+}
+
+bool DueFlashStorage::write(uint32_t address, byte value)
+{
+  return write(address, &value, 1);
+}
+
+bool DueFlashStorage::write(uint32_t address, byte * data, uint32_t dataLength)
+{
+  memcpy(&mockDueFlash.memory[address], data, dataLength);
+  ++mockDueFlash.writeCount;
+  return true;
+}
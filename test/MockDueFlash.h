@@ -0,0 +1,24 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+//
+//
+
+#pragma once
+
+// Simulates the flash memory behind the DueFlashStorage library.
+// Each call to write() is recorded for inspection by tests.
+
+#include <Arduino.h>
+#include <vector>
+
+struct MockDueFlash
+{
+  void reset(unsigned long size);
+
+  std::vector<byte> memory;
+  unsigned int writeCount;
+};
+
+extern MockDueFlash mockDueFlash;
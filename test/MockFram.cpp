@@ -0,0 +1,167 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+//
+//
+
+#include "MockFram.h"
+#include <Wire.h>
+
+MockFram mockFram;
+TwoWire Wire;
+
+namespace
+{
+const byte FRAM_OPC_WREN = 0x06;
+const byte FRAM_OPC_READ = 0x03;
+const byte FRAM_OPC_WRITE = 0x02;
+
+// Bytes in the current SPI transaction after the op-code and address.
+unsigned int spiDataIndex;
+}
+
+void MockFram::reset(unsigned long size, byte addressBytes, byte i2cAddress)
+{
+  memory.assign(size, 0);
+  transactions.clear();
+  this->addressBytes = addressBytes;
+  this->i2cAddress = i2cAddress;
+  addressPointer = 0;
+  writeEnabled = false;
+  receiveQueue.clear();
+  attachSpiDevice(this);
+}
+
+/* Wire methods */
+
+void TwoWire::begin()
+{
+}
+
+void TwoWire::beginTransmission(byte device)
+{
+  mockFram.transactions.push_back({device, false, {}});
+}
+
+void TwoWire::write(int i)
+{
+  mockFram.transactions.back().bytes.push_back(i);
+}
+
+void TwoWire::write(const byte *data, size_t length)
+{
+  std::vector<byte> & bytes = mockFram.transactions.back().bytes;
+  bytes.insert(bytes.end(), data, data + length);
+}
+
+byte TwoWire::endTransmission()
+{
+  const MockBusTransaction & t = mockFram.transactions.back();
+  unsigned long bankSize = 1UL << (8 * mockFram.addressBytes);
+  unsigned long highBits = (t.device - mockFram.i2cAddress) * bankSize;
+  if (t.device < mockFram.i2cAddress || highBits >= mockFram.memory.size())
+  {
+    return 2; // NACK on device address
+  }
+  if (t.bytes.size() < mockFram.addressBytes)
+  {
+    return 0;
+  }
+
+  unsigned long address = 0;
+  for (byte i = 0; i < mockFram.addressBytes; ++i)
+  {
+    address = (address << 8) | t.bytes[i];
+  }
+  mockFram.addressPointer = highBits + address;
+  for (size_t i = mockFram.addressBytes; i < t.bytes.size(); ++i)
+  {
+    mockFram.memory[mockFram.addressPointer] = t.bytes[i];
+    mockFram.addressPointer = (mockFram.addressPointer + 1) % mockFram.memory.size();
+  }
+  return 0;
+}
+
+byte TwoWire::requestFrom(int device, int count)
+{
+  mockFram.transactions.push_back({(byte) device, true, {}});
+  MockBusTransaction & t = mockFram.transactions.back();
+  for (int i = 0; i < count; ++i)
+  {
+    byte b = mockFram.memory[mockFram.addressPointer];
+    mockFram.addressPointer = (mockFram.addressPointer + 1) % mockFram.memory.size();
+    t.bytes.push_back(b);
+    mockFram.receiveQueue.push_back(b);
+  }
+  return count;
+}
+
+bool TwoWire::available()
+{
+  return !mockFram.receiveQueue.empty();
+}
+
+byte TwoWire::read()
+{
+  byte b = mockFram.receiveQueue.front();
+  mockFram.receiveQueue.pop_front();
+  return b;
+}
+
+/* SPI methods */
+
+void MockFram::beginTransaction()
+{
+  mockFram.transactions.push_back({0, false, {}});
+  spiDataIndex = 0;
+}
+
+byte MockFram::transfer(byte data)
+{
+  std::vector<byte> & bytes = mockFram.transactions.back().bytes;
+  bytes.push_back(data);
+  if (bytes.size() == 1)
+  {
+    mockFram.addressPointer = 0;
+    if (data == FRAM_OPC_WREN)
+    {
+      mockFram.writeEnabled = true;
+    }
+    return 0;
+  }
+  if (bytes.size() <= 1u + mockFram.addressBytes)
+  {
+    mockFram.addressPointer = (mockFram.addressPointer << 8) | data;
+    return 0;
+  }
+
+  if (mockFram.memory.empty())
+  {
+    // No chip memory set up.
+    return 0;
+  }
+  unsigned long address = mockFram.addressPointer + spiDataIndex++;
+  address %= mockFram.memory.size();
+  switch (bytes[0])
+  {
+    case FRAM_OPC_READ:
+      return mockFram.memory[address];
+    case FRAM_OPC_WRITE:
+      if (mockFram.writeEnabled)
+      {
+        mockFram.memory[address] = data;
+      }
+      return 0;
+    default:
+      return 0;
+  }
+}
+
+void MockFram::endTransaction()
+{
+  if (mockFram.transactions.back().bytes[0] == FRAM_OPC_WRITE)
+  {
+    mockFram.writeEnabled = false;
+  }
+}
@@ -0,0 +1,44 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+//
+//
+
+#pragma once
+
+// Simulates a FRAM chip attached to the mocked Wire and SPI buses.
+// All bus transactions are recorded for inspection by tests.
+
+#include <Arduino.h>
+#include <vector>
+#include <deque>
+#include "ArduinoMock.hpp"
+
+struct MockBusTransaction
+{
+  byte device;              // I2C device address, 0 for SPI
+  bool isRead;              // I2C requestFrom
+  std::vector<byte> bytes;  // bytes sent to the device, or received for I2C reads
+};
+
+struct MockFram : MockSpiDevice
+{
+  /// Also attaches the chip to the SPI bus.
+  void reset(unsigned long size, byte addressBytes, byte i2cAddress = 0x50);
+
+  virtual void beginTransaction() override;
+  virtual byte transfer(byte data) override;
+  virtual void endTransaction() override;
+
+  std::vector<byte> memory;
+  std::vector<MockBusTransaction> transactions;
+
+  byte addressBytes;
+  byte i2cAddress;
+  unsigned long addressPointer;
+  bool writeEnabled;
+  std::deque<byte> receiveQueue;
+};
+
+extern MockFram mockFram;
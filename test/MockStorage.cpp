@@ -29,7 +29,11 @@ void MockStorage::write(unsigned int eeaddress, byte data)
 
 byte MockStorage::readBytes(unsigned int eeaddress, byte nbytes, byte dest[])
 {
-  return 0;
+  for (byte i = 0; i < nbytes; i++)
+  {
+    dest[i] = eeprom[eeaddress + i];
+  }
+  return nbytes;
 }
 
 void MockStorage::writeBytes(unsigned int eeaddress, const byte src[], byte numbytes)
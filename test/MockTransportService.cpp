@@ -24,6 +24,7 @@ void MockTransportService::process(const VLCB::Action *action)
   {
     case VLCB::ACT_MESSAGE_OUT:
       sent_messages.push_back(action->vlcbMessage);
+      sent_priorities.push_back(action->priority);
       break;
       
     default:
@@ -40,4 +41,5 @@ void MockTransportService::clearMessages()
 {
   incoming_messages.clear();
   sent_messages.clear();
+  sent_priorities.clear();
 }
@@ -30,4 +30,5 @@ public:
 
   std::deque<VLCB::VlcbMessage> incoming_messages;
   std::vector<VLCB::VlcbMessage> sent_messages;
+  std::vector<VLCB::MessagePriority> sent_priorities;
 };
@@ -16,7 +16,13 @@ VLCB::Configuration * createConfiguration()
 {
   static std::unique_ptr<MockStorage> mockStorage;
   mockStorage.reset(new MockStorage);
-  VLCB::Configuration *configuration = createConfiguration(mockStorage.get());
+  return createTestConfiguration(mockStorage.get());
+}
+
+// Configuration with the test layout on a provided storage.
+VLCB::Configuration * createTestConfiguration(VLCB::Storage * storage)
+{
+  VLCB::Configuration *configuration = createConfiguration(storage);
   configuration->EE_NVS_START = 10;
   configuration->setNumNodeVariables(4);
   configuration->EE_EVENTS_START = 20;
@@ -33,18 +39,9 @@ VLCB::Configuration * createConfiguration(VLCB::Storage * mockStorage)
   return configuration;
 }
 
-VLCB::Controller createController(const std::initializer_list<VLCB::Service *> services)
+// Create the controller using the configuration object that is already set up.
+static VLCB::Controller createControllerWithConfiguration(VlcbModeParams startupMode, const std::initializer_list<VLCB::Service *> services)
 {
-  return createController(MODE_NORMAL, services);
-}
-
-VLCB::Controller createController(VlcbModeParams startupMode, const std::initializer_list<VLCB::Service *> services)
-{
-  // Use pointers to objects to create the controller with.
-  // Use unique_ptr so that next invocation deletes the previous objects.
-
-  configuration.reset(createConfiguration());
-
   VLCB::Controller controller(configuration.get());
   controller.setServices(services);
   if (startupMode == MODE_NORMAL)
@@ -60,6 +57,26 @@ VLCB::Controller createController(VlcbModeParams startupMode, const std::initial
   return controller;
 }
 
+VLCB::Controller createController(const std::initializer_list<VLCB::Service *> services)
+{
+  return createController(MODE_NORMAL, services);
+}
+
+VLCB::Controller createController(VlcbModeParams startupMode, const std::initializer_list<VLCB::Service *> services)
+{
+  // Use pointers to objects to create the controller with.
+  // Use unique_ptr so that next invocation deletes the previous objects.
+
+  configuration.reset(createConfiguration());
+  return createControllerWithConfiguration(startupMode, services);
+}
+
+VLCB::Controller createController(VLCB::Storage * storage, const std::initializer_list<VLCB::Service *> services)
+{
+  configuration.reset(createTestConfiguration(storage));
+  return createControllerWithConfiguration(MODE_NORMAL, services);
+}
+
 void process(VLCB::Controller &controller)
 {
   const int MAX_PROCESS_COUNT = 30;
@@ -24,9 +24,13 @@ extern std::unique_ptr<VLCB::Configuration> configuration;
 // Create a Configuration object.
 VLCB::Configuration * createConfiguration();
 VLCB::Configuration * createConfiguration(VLCB::Storage * mockStorage);
+// Create a Configuration object with the standard test layout on the given storage.
+VLCB::Configuration * createTestConfiguration(VLCB::Storage * storage);
 // Use MockTransport to mock out the whole transport part.
 VLCB::Controller createController(std::initializer_list<VLCB::Service *> services);
 VLCB::Controller createController(VlcbModeParams startupMode, std::initializer_list<VLCB::Service *> services);
+// Use a provided storage, e.g. an InstrumentedStorage wrapping a MockStorage.
+VLCB::Controller createController(VLCB::Storage * storage, std::initializer_list<VLCB::Service *> services);
 // Use a provided transport.
 VLCB::Controller createController(VLCB::Transport * trp, std::initializer_list<VLCB::Service *> services);
 
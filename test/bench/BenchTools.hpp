@@ -0,0 +1,45 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+#pragma once
+
+// Helpers for host benchmarks.
+// Timings are only useful to compare implementations on the same host.
+// They say little about the absolute cost on an Arduino.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+// Keep the compiler from optimising away work whose result is not used.
+template <typename T>
+inline void doNotOptimise(const T & value)
+{
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Call fn(n) for n from 0 to calls-1 and return the average time per call in nanoseconds.
+template <typename Fn>
+double benchmark(long calls, Fn fn)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (long n = 0; n < calls; ++n)
+  {
+    fn(n);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / calls;
+}
+
+inline void report(const char * name, double nanos, double baseline = 0)
+{
+  std::cout << "  " << std::left << std::setw(28) << name
+            << std::right << std::fixed << std::setprecision(1) << std::setw(8) << nanos;
+  if (baseline > 0)
+  {
+    std::cout << "  (" << std::setprecision(1) << baseline / nanos << "x faster)";
+  }
+  std::cout << std::endl;
+}
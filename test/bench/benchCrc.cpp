@@ -0,0 +1,159 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+// Host benchmark of the CRC functions.
+// Compares the nibble table CRC-16 and CRC-32 with the bitwise functions they replaced.
+// Also checks that both produce the same results.
+
+#include <cstring>
+#include <iostream>
+#include "BenchTools.hpp"
+#include "Crc.h"
+
+namespace
+{
+
+// The functions below are the previous bitwise CRCs, kept for comparison.
+namespace legacy
+{
+
+uint16_t crc16(const uint8_t *data_p, uint16_t length)
+{
+  uint8_t i;
+  uint16_t data;
+  uint16_t crc = 0xffff;
+
+  if (length == 0)
+  {
+    return (~crc);
+  }
+
+  do
+  {
+    for (i = 0, data = (uint16_t) 0xff & *data_p++;
+         i < 8;
+         i++, data >>= 1)
+    {
+      if ((crc & 0x0001) ^ (data & 0x0001))
+      {
+        crc = (crc >> 1) ^ 0x8408;
+      }
+      else
+      { crc >>= 1; }
+    }
+  } while (--length);
+
+  crc = ~crc;
+  data = crc;
+  crc = (crc << 8) | (data >> 8 & 0xff);
+
+  return (crc);
+}
+
+uint32_t crc32(const uint8_t *s, size_t n)
+{
+  uint32_t crc = 0xFFFFFFFF;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    uint8_t ch = s[i];
+    for (size_t j = 0; j < 8; j++)
+    {
+      uint32_t b = (ch ^ crc) & 1;
+      crc >>= 1;
+      if (b)
+      { crc = crc ^ 0xEDB88320; }
+      ch >>= 1;
+    }
+  }
+
+  return ~crc;
+}
+
+}
+
+// A typical long message fits in the default 64 byte buffers.
+const int MESSAGE_LENGTH = 64;
+const int NUM_MESSAGES = 16;
+const long ITERATIONS = 20000;
+
+uint8_t messages[NUM_MESSAGES][MESSAGE_LENGTH];
+
+void createMessages()
+{
+  uint32_t seed = 12345;
+  for (int i = 0; i < NUM_MESSAGES; ++i)
+  {
+    for (int b = 0; b < MESSAGE_LENGTH; ++b)
+    {
+      seed = seed * 1103515245 + 12345;
+      messages[i][b] = seed >> 16;
+    }
+  }
+}
+
+//
+/// the CRCs must agree for every length before their speeds are compared
+//
+bool checkCrcsAgree()
+{
+  for (int i = 0; i < NUM_MESSAGES; ++i)
+  {
+    for (int length = 0; length <= MESSAGE_LENGTH; ++length)
+    {
+      if (legacy::crc16(messages[i], length) != VLCB::crc16(messages[i], length)
+          || legacy::crc32(messages[i], length) != VLCB::crc32(messages[i], length))
+      {
+        std::cout << "CRCs differ for message " << i << " length " << length << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}
+
+int main()
+{
+  createMessages();
+  if (!checkCrcsAgree())
+  {
+    return 1;
+  }
+
+  long calls = ITERATIONS * NUM_MESSAGES;
+
+  double legacyCrc16 = benchmark(calls, [&](long n) {
+    doNotOptimise(legacy::crc16(messages[n % NUM_MESSAGES], MESSAGE_LENGTH));
+  });
+  double tableCrc16 = benchmark(calls, [&](long n) {
+    doNotOptimise(VLCB::crc16(messages[n % NUM_MESSAGES], MESSAGE_LENGTH));
+  });
+  // As a receiver does it, one long message fragment of 5 bytes at a time.
+  double fragmentCrc16 = benchmark(calls, [&](long n) {
+    const uint8_t * message = messages[n % NUM_MESSAGES];
+    uint16_t crc = VLCB::CRC16_INITIAL;
+    for (int offset = 0; offset < MESSAGE_LENGTH; offset += 5)
+    {
+      crc = VLCB::crc16Update(crc, message + offset, MESSAGE_LENGTH - offset < 5 ? MESSAGE_LENGTH - offset : 5);
+    }
+    doNotOptimise(VLCB::crc16Result(crc));
+  });
+  double legacyCrc32 = benchmark(calls, [&](long n) {
+    doNotOptimise(legacy::crc32(messages[n % NUM_MESSAGES], MESSAGE_LENGTH));
+  });
+  double tableCrc32 = benchmark(calls, [&](long n) {
+    doNotOptimise(VLCB::crc32(messages[n % NUM_MESSAGES], MESSAGE_LENGTH));
+  });
+
+  std::cout << "CRC of " << MESSAGE_LENGTH << " bytes, ns per message" << std::endl;
+  report("crc16 bitwise", legacyCrc16);
+  report("crc16 table", tableCrc16, legacyCrc16);
+  report("crc16 table per fragment", fragmentCrc16, legacyCrc16);
+  report("crc32 bitwise", legacyCrc32);
+  report("crc32 table", tableCrc32, legacyCrc32);
+  return 0;
+}
@@ -0,0 +1,267 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+// Host benchmark of the GridConnect codec.
+// Compares the table driven encoder and decoder with the sprintf/strtol based
+// functions they replaced. Also checks that both produce the same results.
+
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include "BenchTools.hpp"
+#include "GridConnect.h"
+
+namespace
+{
+
+// The functions below are the previous GridConnect codec, kept for comparison.
+namespace legacy
+{
+
+bool encodeGridConnect(char * gcBuffer, const VLCB::CanFrameHeader & header, const uint8_t data[])
+{
+  byte offset = 0;
+  gcBuffer[0] = 0;
+  if (header.ext)
+  {
+    if (header.id > 0x1FFFFFFF)
+    {
+      return false;
+    }
+    strcpy(gcBuffer, ":X");
+    sprintf(gcBuffer + 2, "%02X", header.id >> 21);
+    sprintf(gcBuffer + 4, "%01X", (header.id >> 17) & 0xE);
+    sprintf(gcBuffer + 5, "%01X", (header.id >> 16) & 0x3);
+    sprintf(gcBuffer + 6, "%04X", header.id & 0xFFFF);
+    offset = 10;
+  }
+  else
+  {
+    if (header.id > 0x7FF)
+    {
+      return false;
+    }
+    strcpy(gcBuffer, ":S");
+    sprintf(gcBuffer + 2, "%04X", header.id << 5);
+    offset = 6;
+  }
+  strcpy(gcBuffer + offset++, header.rtr ? "R" : "N");
+  if (header.len > 8)
+  {
+    gcBuffer[0] = 0;
+    return false;
+  }
+  for (int i = 0; i < header.len; i++)
+  {
+    sprintf(gcBuffer + offset, "%02X", data[i]);
+    offset += 2;
+  }
+  strcpy(gcBuffer + offset, ";");
+  return true;
+}
+
+int ascii_pair_to_byte(const char *pair)
+{
+  unsigned char* data = (unsigned char*)pair;
+  int result;
+  if (data[1] < 'A') { result = data[1] - '0'; }
+  else { result = data[1] - 'A' + 10; }
+  if (data[0] < 'A') { result += (data[0] - '0') << 4; }
+  else { result += (data[0] - 'A' + 10) << 4; }
+  return result;
+}
+
+bool checkHexChars(const char *charBuff, int count)
+{
+  for (int i = 0 ; i < count; i++)
+  {
+    if (islower(charBuff[i]) || !isxdigit(charBuff[i]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool decodeGridConnect(const char * gcBuffer, VLCB::CANFrame *frame)
+{
+  int gcIndex = 0;
+  int gcBufferLength = strlen(gcBuffer);
+
+  if (gcBuffer[gcIndex++] != ':')
+  {
+    return false;
+  }
+  if (gcBuffer[gcIndex] == 'X')
+  {
+    frame->ext = true;
+    if (!checkHexChars(&gcBuffer[2], 8))
+    {
+      return false;
+    }
+    frame->id = uint32_t(ascii_pair_to_byte(&gcBuffer[2])) << 21;
+    frame->id += uint32_t(ascii_pair_to_byte(&gcBuffer[4]) & 0xE0) << 13;
+    frame->id += uint32_t(ascii_pair_to_byte(&gcBuffer[4]) & 0x3) << 16;
+    frame->id += uint32_t(ascii_pair_to_byte(&gcBuffer[6])) << 8;
+    frame->id += ascii_pair_to_byte(&gcBuffer[8]);
+    gcIndex = 10;
+  }
+  else if (gcBuffer[gcIndex] == 'S')
+  {
+    frame->ext = false;
+    if (!checkHexChars(&gcBuffer[2], 4))
+    {
+      return false;
+    }
+    frame->id = strtol(&gcBuffer[2], NULL, 16) >> 5;
+    gcIndex = 6;
+  }
+  else
+  {
+    return false;
+  }
+  if (gcBuffer[gcIndex] == 'R')
+  {
+    frame->rtr = true;
+  }
+  else if (gcBuffer[gcIndex] == 'N')
+  {
+    frame->rtr = false;
+  }
+  else
+  {
+    return false;
+  }
+  gcIndex++;
+  int dataLength = gcBufferLength - gcIndex - 1;
+  if ((dataLength % 2) || (dataLength > 16))
+  {
+    return false;
+  }
+  frame->len = dataLength / 2;
+  for (int i = 0; i < dataLength / 2; i++)
+  {
+    if (!checkHexChars(&gcBuffer[gcIndex], 2))
+    {
+      return false;
+    }
+    frame->data[i] = ascii_pair_to_byte(&gcBuffer[gcIndex]);
+    gcIndex += 2;
+  }
+  return gcBuffer[gcBufferLength - 1] == ';';
+}
+
+}
+
+const int NUM_FRAMES = 64;
+const long ITERATIONS = 20000;
+
+VLCB::CANFrame frames[NUM_FRAMES];
+char encoded[NUM_FRAMES][VLCB::GRIDCONNECT_MAX_LENGTH + 1];
+byte encodedLength[NUM_FRAMES];
+
+//
+/// a mix of typical VLCB frames with the odd extended and RTR frame
+//
+void createFrames()
+{
+  uint32_t seed = 12345;
+  for (int i = 0; i < NUM_FRAMES; ++i)
+  {
+    seed = seed * 1103515245 + 12345;
+    VLCB::CANFrame & frame = frames[i];
+    frame.ext = (i % 16) == 15;
+    frame.rtr = (i % 32) == 7;
+    frame.id = frame.ext ? (seed >> 3) & 0x1FFFFFFF : (seed >> 16) & 0x7FF;
+    frame.len = frame.rtr ? 0 : (seed >> 8) % 9;
+    for (int d = 0; d < 8; ++d)
+    {
+      frame.data[d] = seed >> (d * 3);
+    }
+  }
+}
+
+bool framesEqual(const VLCB::CANFrame & a, const VLCB::CANFrame & b)
+{
+  return a.id == b.id && a.ext == b.ext && a.rtr == b.rtr && a.len == b.len
+      && memcmp(a.data, b.data, a.len) == 0;
+}
+
+//
+/// both codecs must agree before their speeds are compared
+//
+bool checkCodecsAgree()
+{
+  for (int i = 0; i < NUM_FRAMES; ++i)
+  {
+    const VLCB::CANFrame & frame = frames[i];
+    VLCB::CanFrameHeader header = {frame.id, frame.ext, frame.rtr, frame.len};
+    char legacyBuffer[VLCB::GRIDCONNECT_MAX_LENGTH + 1];
+    legacy::encodeGridConnect(legacyBuffer, header, frame.data);
+    encodedLength[i] = VLCB::encodeGridConnect(encoded[i], header, frame.data);
+    if (strcmp(legacyBuffer, encoded[i]) != 0 || encodedLength[i] != strlen(legacyBuffer))
+    {
+      std::cout << "Encoders differ: " << legacyBuffer << " " << encoded[i] << std::endl;
+      return false;
+    }
+
+    VLCB::CANFrame legacyFrame = {};
+    VLCB::CANFrame newFrame = {};
+    if (!legacy::decodeGridConnect(encoded[i], &legacyFrame)
+        || !VLCB::decodeGridConnect(encoded[i], encodedLength[i], &newFrame)
+        || !framesEqual(legacyFrame, newFrame) || !framesEqual(frame, newFrame))
+    {
+      std::cout << "Decoders differ: " << encoded[i] << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+int main()
+{
+  createFrames();
+  if (!checkCodecsAgree())
+  {
+    return 1;
+  }
+
+  char buffer[VLCB::GRIDCONNECT_MAX_LENGTH + 1];
+  VLCB::CANFrame frame;
+  long calls = ITERATIONS * NUM_FRAMES;
+
+  double legacyEncode = benchmark(calls, [&](long n) {
+    const VLCB::CANFrame & f = frames[n % NUM_FRAMES];
+    legacy::encodeGridConnect(buffer, {f.id, f.ext, f.rtr, f.len}, f.data);
+    doNotOptimise(buffer);
+  });
+  double tableEncode = benchmark(calls, [&](long n) {
+    const VLCB::CANFrame & f = frames[n % NUM_FRAMES];
+    VLCB::encodeGridConnect(buffer, {f.id, f.ext, f.rtr, f.len}, f.data);
+    doNotOptimise(buffer);
+  });
+  double legacyDecode = benchmark(calls, [&](long n) {
+    legacy::decodeGridConnect(encoded[n % NUM_FRAMES], &frame);
+    doNotOptimise(frame);
+  });
+  double tableDecode = benchmark(calls, [&](long n) {
+    VLCB::decodeGridConnect(encoded[n % NUM_FRAMES], &frame);
+    doNotOptimise(frame);
+  });
+  double tableDecodeLength = benchmark(calls, [&](long n) {
+    VLCB::decodeGridConnect(encoded[n % NUM_FRAMES], encodedLength[n % NUM_FRAMES], &frame);
+    doNotOptimise(frame);
+  });
+
+  std::cout << "GridConnect codec, ns per frame" << std::endl;
+  report("encode sprintf", legacyEncode);
+  report("encode table", tableEncode, legacyEncode);
+  report("decode strtol", legacyDecode);
+  report("decode table", tableDecode, legacyDecode);
+  report("decode table with length", tableDecodeLength, legacyDecode);
+  return 0;
+}
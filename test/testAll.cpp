@@ -10,6 +10,7 @@
 #include "TestTools.hpp"
 
 void testCircularBuffer();
+void testBusLoadMeter();
 void testLED();
 void testSwitch();
 void testConfiguration();
@@ -22,6 +23,16 @@ void testEventTeachingService();
 void testConsumeOwnEventsService();
 void testLongMessageService();
 void testGridConnect();
+void testInstrumentedStorage();
+void testFramStorage();
+void testFileStorage();
+void testCAN2515();
+void testCanBridgeService();
+void testSerialGC();
+void testBinaryFraming();
+void testCrc();
+void testDeferredCommit();
+void testDueEepromEmulationStorage();
 
 // Remaining services to implement
 //Bootloader (the CBUS PIC version) service #10
@@ -30,6 +41,7 @@ void testGridConnect();
 std::map<std::string, void (*)()> suites = {
         {"Arduino", testArduino},
         {"CircularBuffer", testCircularBuffer},
+        {"BusLoadMeter", testBusLoadMeter},
         {"LED", testLED},
         {"Switch", testSwitch},
         {"Configuration", testConfiguration},
@@ -41,7 +53,17 @@ std::map<std::string, void (*)()> suites = {
         {"EventTeachingService", testEventTeachingService},
         {"ConsumeOwnEventsService", testConsumeOwnEventsService},
         {"LongMessageService", testLongMessageService},
-        {"GridConnect", testGridConnect}
+        {"GridConnect", testGridConnect},
+        {"InstrumentedStorage", testInstrumentedStorage},
+        {"FramStorage", testFramStorage},
+        {"FileStorage", testFileStorage},
+        {"CAN2515", testCAN2515},
+        {"CanBridgeService", testCanBridgeService},
+        {"SerialGC", testSerialGC},
+        {"BinaryFraming", testBinaryFraming},
+        {"Crc", testCrc},
+        {"DeferredCommit", testDeferredCommit},
+        {"DueEepromEmulationStorage", testDueEepromEmulationStorage}
 };
 
 int main(int argc, const char * const * argv)
@@ -0,0 +1,94 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+// Test cases for the binary serial framing.
+
+#include "TestTools.hpp"
+#include "BinaryFraming.h"
+
+namespace
+{
+
+void testEncodeStandardFrame()
+{
+  test();
+  uint8_t buffer[VLCB::BINARY_FRAME_MAX_LENGTH];
+  uint8_t data[] = {0x90, 0x01};
+
+  byte length = VLCB::encodeBinaryFrame(buffer, {0x5A3, false, false, 2}, data);
+
+  assertEquals(6, length);
+  assertEquals(0x02, buffer[0]);
+  assertEquals(0x05, buffer[1]);
+  assertEquals(0xA3, buffer[2]);
+  assertEquals(0x90, buffer[3]);
+  assertEquals(0x01, buffer[4]);
+  assertEquals(length, VLCB::binaryFrameLength(buffer[0]));
+}
+
+void testEncodeExtendedRtrFrame()
+{
+  test();
+  uint8_t buffer[VLCB::BINARY_FRAME_MAX_LENGTH];
+  uint8_t noData[1] = {};
+
+  byte length = VLCB::encodeBinaryFrame(buffer, {0x1FFFFFFF, true, true, 0}, noData);
+
+  assertEquals(6, length);
+  assertEquals(0xC0, buffer[0]);
+  assertEquals(0x1F, buffer[1]);
+  assertEquals(0xFF, buffer[4]);
+}
+
+void testEncodeInvalidFrames()
+{
+  test();
+  uint8_t buffer[VLCB::BINARY_FRAME_MAX_LENGTH];
+  uint8_t data[9] = {};
+
+  assertEquals(0, VLCB::encodeBinaryFrame(buffer, {0x800, false, false, 0}, data));
+  assertEquals(0, VLCB::encodeBinaryFrame(buffer, {0x20000000, true, false, 0}, data));
+  assertEquals(0, VLCB::encodeBinaryFrame(buffer, {0x1, false, false, 9}, data));
+}
+
+void testFrameLength()
+{
+  test();
+  assertEquals(4, VLCB::binaryFrameLength(0x00));
+  assertEquals(12, VLCB::binaryFrameLength(0x08));
+  assertEquals(VLCB::BINARY_FRAME_MAX_LENGTH, VLCB::binaryFrameLength(0x88));
+  assertEquals(0, VLCB::binaryFrameLength(0x09));  // too many data bytes
+  assertEquals(0, VLCB::binaryFrameLength(0x10));  // reserved bit set
+}
+
+void testDecodeChecksCrc()
+{
+  test();
+  uint8_t buffer[VLCB::BINARY_FRAME_MAX_LENGTH];
+  uint8_t data[] = {1, 2, 3, 4, 5, 6, 7, 8};
+  byte length = VLCB::encodeBinaryFrame(buffer, {0x123, false, false, 8}, data);
+
+  VLCB::CANFrame frame;
+  assertEquals(true, VLCB::decodeBinaryFrame(buffer, length, &frame));
+  assertEquals(0x123, frame.id);
+  assertEquals(8, frame.len);
+  assertEquals(8, frame.data[7]);
+
+  buffer[5] ^= 0x10;
+  assertEquals(false, VLCB::decodeBinaryFrame(buffer, length, &frame));
+  buffer[5] ^= 0x10;
+  assertEquals(false, VLCB::decodeBinaryFrame(buffer, length - 1, &frame));
+}
+
+}
+
+void testBinaryFraming()
+{
+  testEncodeStandardFrame();
+  testEncodeExtendedRtrFrame();
+  testEncodeInvalidFrames();
+  testFrameLength();
+  testDecodeChecksCrc();
+}
@@ -0,0 +1,137 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+#include "TestTools.hpp"
+#include "ArduinoMock.hpp"
+#include "BusLoadMeter.h"
+
+namespace
+{
+
+const VLCB::CANFrame fullFrame = {0x5A3, false, false, 8, {0x90, 1, 2, 3, 4, 5, 6, 7}};
+
+void testFrameBits()
+{
+  test();
+
+  assertEquals(135, VLCB::BusLoadMeter::frameBits(fullFrame));
+
+  VLCB::CANFrame emptyFrame = {0x5A3, false, false, 0, {}};
+  assertEquals(55, VLCB::BusLoadMeter::frameBits(emptyFrame));
+
+  // Remote frames have no data field whatever the DLC says.
+  VLCB::CANFrame rtrFrame = {0x5A3, false, true, 8, {}};
+  assertEquals(55, VLCB::BusLoadMeter::frameBits(rtrFrame));
+
+  VLCB::CANFrame extFrame = {0x12345, true, false, 0, {}};
+  assertEquals(80, VLCB::BusLoadMeter::frameBits(extFrame));
+}
+
+void testLoadOverOneSecond()
+{
+  test();
+
+  VLCB::BusLoadMeter meter;
+  meter.reset();
+
+  for (int i = 0; i < 100; ++i)
+  {
+    meter.countReceived(fullFrame);
+  }
+  for (int i = 0; i < 50; ++i)
+  {
+    meter.countTransmitted(fullFrame);
+  }
+  // Nothing is reported until the second is complete.
+  assertEquals(0, meter.getReceiveLoad());
+
+  addMillis(1000);
+  meter.update();
+
+  // 100 * 135 bits of 125000 bit/s
+  assertEquals(108, meter.getReceiveLoad());
+  assertEquals(54, meter.getTransmitLoad());
+  assertEquals(108, meter.getReceiveLoad10s());
+  assertEquals(150, meter.getFramesPerSecond());
+}
+
+void testLoadOverTenSeconds()
+{
+  test();
+
+  VLCB::BusLoadMeter meter;
+  meter.reset();
+
+  for (int i = 0; i < 100; ++i)
+  {
+    meter.countReceived(fullFrame);
+  }
+  for (int s = 0; s < 10; ++s)
+  {
+    addMillis(1000);
+    meter.update();
+  }
+
+  assertEquals(0, meter.getReceiveLoad());
+  assertEquals(10, meter.getReceiveLoad10s());
+  assertEquals(0, meter.getFramesPerSecond());
+
+  // A long idle period clears the history.
+  addMillis(60000);
+  meter.update();
+  assertEquals(0, meter.getReceiveLoad10s());
+}
+
+void testBitRate()
+{
+  test();
+
+  VLCB::BusLoadMeter meter(250000);
+  meter.reset();
+
+  for (int i = 0; i < 100; ++i)
+  {
+    meter.countTransmitted(fullFrame);
+  }
+  addMillis(1000);
+  meter.update();
+
+  assertEquals(54, meter.getTransmitLoad());
+}
+
+void testPeakFramesPerSlot()
+{
+  test();
+
+  VLCB::BusLoadMeter meter;
+  meter.reset();
+
+  for (int i = 0; i < 3; ++i)
+  {
+    meter.countReceived(fullFrame);
+  }
+  addMillis(100);
+  for (int i = 0; i < 7; ++i)
+  {
+    meter.countTransmitted(fullFrame);
+  }
+  addMillis(100);
+  meter.countReceived(fullFrame);
+  addMillis(100);
+  meter.update();
+
+  assertEquals(7, meter.getPeakFramesPerSlot());
+}
+
+}
+
+void testBusLoadMeter()
+{
+  testFrameBits();
+  testLoadOverOneSecond();
+  testLoadOverTenSeconds();
+  testBitRate();
+  testPeakFramesPerSlot();
+}
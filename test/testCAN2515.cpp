@@ -0,0 +1,252 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+// Test cases for CAN2515 using a mocked ACAN2515 driver.
+
+#include "TestTools.hpp"
+#include "ArduinoMock.hpp"
+#include "CAN2515.h"
+
+namespace
+{
+
+VLCB::CANFrame makeFrame(byte opc)
+{
+  return {0x5A3, false, false, 1, {opc}};
+}
+
+void testSendWithoutDelay()
+{
+  test();
+  clearAcan2515(2);
+  VLCB::CAN2515 can2515;
+  can2515.begin();
+
+  VLCB::CANFrame frame = makeFrame(OPC_ACON);
+  assertEquals(true, can2515.sendCanFrame(&frame));
+  assertEquals(true, can2515.sendCanFrame(&frame));
+
+  assertEquals(0, millis());
+  assertEquals(2, can2515.transmitCounter());
+  assertEquals(0, can2515.transmitRetryCounter());
+}
+
+void testRetryWhenTransmitBufferFull()
+{
+  test();
+  clearAcan2515(2);
+  VLCB::CAN2515 can2515;
+  can2515.begin();
+
+  for (byte i = 0; i < 4; ++i)
+  {
+    VLCB::CANFrame frame = makeFrame(i);
+    assertEquals(true, can2515.sendCanFrame(&frame));
+  }
+  assertEquals(2, can2515.transmitCounter());
+  assertEquals(2, can2515.transmitRetryCounter());
+
+  // Hardware sends its buffered frames. The waiting frames follow on the next loop.
+  completeAcan2515Transmissions();
+  can2515.available();
+  completeAcan2515Transmissions();
+
+  assertEquals(4, getAcan2515Sent().size());
+  for (byte i = 0; i < 4; ++i)
+  {
+    assertEquals(i, getAcan2515Sent()[i].data[0]);
+  }
+  assertEquals(4, can2515.transmitCounter());
+  assertEquals(0, can2515.transmitDropCounter());
+}
+
+void testFramesKeepOrder()
+{
+  test();
+  clearAcan2515(1);
+  VLCB::CAN2515 can2515;
+  can2515.begin();
+
+  VLCB::CANFrame frame = makeFrame(1);
+  can2515.sendCanFrame(&frame);
+  frame = makeFrame(2);
+  can2515.sendCanFrame(&frame);
+
+  // Room for one frame. The waiting frame must go before the new frame.
+  completeAcan2515Transmissions();
+  frame = makeFrame(3);
+  can2515.sendCanFrame(&frame);
+  completeAcan2515Transmissions();
+  can2515.available();
+  completeAcan2515Transmissions();
+
+  assertEquals(3, getAcan2515Sent().size());
+  assertEquals(1, getAcan2515Sent()[0].data[0]);
+  assertEquals(2, getAcan2515Sent()[1].data[0]);
+  assertEquals(3, getAcan2515Sent()[2].data[0]);
+}
+
+void testDropWhenRetryQueueFull()
+{
+  test();
+  clearAcan2515(1);
+  VLCB::CAN2515 can2515;
+  can2515.setNumRetryBuffers(2);
+  can2515.begin();
+
+  VLCB::CANFrame frame = makeFrame(OPC_ACON);
+  assertEquals(true, can2515.sendCanFrame(&frame));
+  assertEquals(true, can2515.sendCanFrame(&frame));
+  assertEquals(true, can2515.sendCanFrame(&frame));
+  assertEquals(false, can2515.sendCanFrame(&frame));
+
+  assertEquals(1, can2515.transmitCounter());
+  assertEquals(2, can2515.transmitRetryCounter());
+  assertEquals(1, can2515.transmitDropCounter());
+}
+
+void testReceiveOverrun()
+{
+  test();
+  clearAcan2515(2, 2);
+  VLCB::CAN2515 can2515;
+  can2515.begin();
+
+  // A full software receive buffer is not an overrun.
+  CANMessage message = {0x5A3, false, false, 1, {OPC_ACON}};
+  setAcan2515Received(message);
+  setAcan2515Received(message);
+  assertEquals(true, can2515.available());
+  assertEquals(0, can2515.receiveOverrunCounter());
+
+  clearSpiBus();
+  setAcan2515ErrorFlags(VLCB::EFLG_RX0OVR);
+  can2515.available();
+  assertEquals(1, can2515.receiveOverrunCounter());
+
+  // The flags are cleared with a bit modify instruction.
+  assertEquals(1, getSpiTransactions().size());
+  const std::vector<byte> & bitModify = getSpiTransactions()[0];
+  assertEquals(4, bitModify.size());
+  assertEquals(VLCB::MCP2515_BIT_MODIFY, bitModify[0]);
+  assertEquals(VLCB::MCP2515_EFLG, bitModify[1]);
+  assertEquals(VLCB::EFLG_RX0OVR | VLCB::EFLG_RX1OVR, bitModify[2]);
+  assertEquals(0, bitModify[3]);
+  setAcan2515ErrorFlags(0);
+
+  can2515.available();
+  assertEquals(1, can2515.receiveOverrunCounter());
+
+  // Each receive buffer that overflowed is counted.
+  setAcan2515ErrorFlags(VLCB::EFLG_RX0OVR | VLCB::EFLG_RX1OVR);
+  can2515.available();
+  assertEquals(3, can2515.receiveOverrunCounter());
+}
+
+CANMessage makeMessage(uint32_t id, bool ext = false)
+{
+  return {id, ext, false, 1, {OPC_ACON}};
+}
+
+void testHardwareFiltersFromBegin()
+{
+  test();
+  clearAcan2515(2);
+  VLCB::CAN2515 can2515;
+  VLCB::CanAcceptanceFilter filters[] = {{0x7F, 0x11}, {0x7F, 0x12}, VLCB::ENUMERATION_ACCEPTANCE_FILTER};
+  assertEquals(true, can2515.setAcceptanceFilters(filters, 3));
+  can2515.begin();
+
+  assertEquals(6, getAcan2515FilterCount());
+
+  setAcan2515Received(makeMessage(0x413));
+  setAcan2515Received(makeMessage(0x11, true));
+  assertEquals(false, can2515.available());
+
+  setAcan2515Received(makeMessage(0x511));
+  setAcan2515Received(makeMessage(0x312));
+  assertEquals(true, can2515.available());
+  VLCB::CANFrame frame = can2515.getNextCanFrame();
+  assertEquals(0x511, frame.id);
+  assertEquals(true, can2515.acceptsFrame({frame.id, frame.ext, frame.rtr, frame.len}));
+  frame = can2515.getNextCanFrame();
+  assertEquals(0x312, frame.id);
+  assertEquals(false, can2515.available());
+}
+
+void testHardwareFiltersOnTheFly()
+{
+  test();
+  clearAcan2515(2);
+  VLCB::CAN2515 can2515;
+  can2515.begin();
+  assertEquals(0, getAcan2515FilterCount());
+
+  // Two masks. The group with two filters goes to RXB0.
+  VLCB::CanAcceptanceFilter filters[] = {{0x780, 0x100}, {0x780, 0x180}, {0x780, 0x200}, {0x7FF, 0x011}, {0x7FF, 0x022},
+                                         VLCB::ENUMERATION_ACCEPTANCE_FILTER};
+  assertEquals(true, can2515.setAcceptanceFilters(filters, 6));
+  assertEquals(6, getAcan2515FilterCount());
+
+  setAcan2515Received(makeMessage(0x011));
+  setAcan2515Received(makeMessage(0x012));
+  setAcan2515Received(makeMessage(0x1AB));
+  setAcan2515Received(makeMessage(0x283));
+  setAcan2515Received(makeMessage(0x022));
+  setAcan2515Received(makeMessage(0x5AB));
+  assertEquals(4, can2515.receiveBufferUsage());
+
+  // Remove the filters.
+  assertEquals(true, can2515.setAcceptanceFilters(nullptr, 0));
+  assertEquals(0, getAcan2515FilterCount());
+}
+
+void testSoftwareFilterFallback()
+{
+  test();
+  clearAcan2515(2);
+  VLCB::CAN2515 can2515;
+  can2515.begin();
+
+  // Three masks do not fit the MCP2515. Filter in software instead.
+  VLCB::CanAcceptanceFilter filters[] = {{0x7FF, 0x011}, {0x7F0, 0x120}, {0x700, 0x300}};
+  assertEquals(true, can2515.setAcceptanceFilters(filters, 3));
+  assertEquals(0, getAcan2515FilterCount());
+
+  // Frames with data. Zero length frames are always accepted, see below.
+  assertEquals(true, can2515.acceptsFrame({0x011, false, false, 1}));
+  assertEquals(true, can2515.acceptsFrame({0x12F, false, false, 1}));
+  assertEquals(true, can2515.acceptsFrame({0x3AB, false, false, 1}));
+  assertEquals(false, can2515.acceptsFrame({0x012, false, false, 1}));
+  assertEquals(false, can2515.acceptsFrame({0x011, true, false, 1}));
+
+  // Enumeration frames pass the software filters.
+  assertEquals(true, can2515.acceptsFrame({0x5AB, false, true, 0}));
+  assertEquals(true, can2515.acceptsFrame({0x5AB, false, false, 0}));
+
+  // Three filters with the same mask and the enumeration filter fit in hardware.
+  VLCB::CanAcceptanceFilter sameMask[] = {{0x7F, 0x11}, {0x7F, 0x12}, {0x7F, 0x13}, VLCB::ENUMERATION_ACCEPTANCE_FILTER};
+  assertEquals(true, can2515.setAcceptanceFilters(sameMask, 4));
+  assertEquals(6, getAcan2515FilterCount());
+
+  // Without it enumeration frames from other CANIDs would be lost. Filter in software instead.
+  assertEquals(true, can2515.setAcceptanceFilters(sameMask, 3));
+  assertEquals(0, getAcan2515FilterCount());
+  assertEquals(true, can2515.acceptsFrame({0x5AB, false, true, 0}));
+}
+
+}
+
+void testCAN2515()
+{
+  testSendWithoutDelay();
+  testRetryWhenTransmitBufferFull();
+  testFramesKeepOrder();
+  testDropWhenRetryQueueFull();
+  testReceiveOverrun();
+  testHardwareFiltersFromBegin();
+  testHardwareFiltersOnTheFly();
+  testSoftwareFilterFallback();
+}
@@ -0,0 +1,206 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+// Test cases for CanBridgeService.
+// * Forwarding between two segments
+// * Learned routing of addressed messages
+// * Event filters
+// * Backpressure
+
+#include <memory>
+#include "TestTools.hpp"
+#include "Controller.h"
+#include "CanBridgeService.h"
+#include "VlcbCommon.h"
+#include "MockCanTransport.h"
+
+namespace
+{
+std::unique_ptr<MockCanTransport> port0;
+std::unique_ptr<MockCanTransport> port1;
+std::unique_ptr<VLCB::CanBridgeService> bridgeService;
+
+VLCB::Controller createController(byte queueSize = VLCB::DEFAULT_BRIDGE_QUEUE_SIZE)
+{
+  port0.reset(new MockCanTransport);
+  port1.reset(new MockCanTransport);
+  bridgeService.reset(new VLCB::CanBridgeService(port0.get(), port1.get(), queueSize));
+
+  VLCB::Controller controller = ::createController({bridgeService.get()});
+  controller.begin();
+  return controller;
+}
+
+void testForwardBothWays()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+
+  VLCB::CANFrame qnn = {0x11, false, false, 1, {OPC_QNN}};
+  port0->setNextMessage(qnn);
+  VLCB::CANFrame pnn = {0x22, false, false, 6, {OPC_PNN, 0x01, 0x04, 0xA5, 0x01, 0x0E}};
+  port1->setNextMessage(pnn);
+  VLCB::CANFrame rtr = {0x33, false, true, 0, {}};
+  port1->setNextMessage(rtr);
+
+  controller.process();
+
+  assertEquals(1, port1->sent_frames.size());
+  assertEquals(OPC_QNN, port1->sent_frames[0].data[0]);
+  assertEquals(0x11, port1->sent_frames[0].id);
+  assertEquals(2, port0->sent_frames.size());
+  assertEquals(OPC_PNN, port0->sent_frames[0].data[0]);
+  assertEquals(true, port0->sent_frames[1].rtr);
+
+  assertEquals(0, bridgeService->getCanidPort(0x11));
+  assertEquals(1, bridgeService->getCanidPort(0x22));
+  assertEquals(1, bridgeService->getNodePort(0x0104));
+  assertEquals(VLCB::BRIDGE_NO_PORT, bridgeService->getNodePort(0x0105));
+
+  assertEquals(1, bridgeService->getPortStats(0).framesReceived);
+  assertEquals(1, bridgeService->getPortStats(0).framesForwarded);
+  assertEquals(2, bridgeService->getPortStats(0).framesSent);
+  assertEquals(2, bridgeService->getPortStats(1).framesReceived);
+  assertEquals(1, bridgeService->getPortStats(1).framesSent);
+}
+
+void testAddressedMessageRouting()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+
+  // Node 0x0104 is on segment 1.
+  VLCB::CANFrame pnn = {0x22, false, false, 6, {OPC_PNN, 0x01, 0x04, 0xA5, 0x01, 0x0E}};
+  port1->setNextMessage(pnn);
+  controller.process();
+  port0->clearMessages();
+
+  // A request from segment 0 must cross the bridge.
+  VLCB::CANFrame rqnpn = {0x11, false, false, 4, {OPC_RQNPN, 0x01, 0x04, 1}};
+  port0->setNextMessage(rqnpn);
+  controller.process();
+  assertEquals(1, port1->sent_frames.size());
+
+  // A request from segment 1 stays on segment 1.
+  VLCB::CANFrame nvrd = {0x23, false, false, 4, {OPC_NVRD, 0x01, 0x04, 1}};
+  port1->setNextMessage(nvrd);
+  controller.process();
+  assertEquals(0, port0->sent_frames.size());
+  assertEquals(1, bridgeService->getPortStats(1).framesFiltered);
+
+  // Requests to unknown nodes go everywhere.
+  VLCB::CANFrame unknown = {0x23, false, false, 4, {OPC_NVRD, 0x01, 0x09, 1}};
+  port1->setNextMessage(unknown);
+  controller.process();
+  assertEquals(1, port0->sent_frames.size());
+
+  // The node moves to segment 0.
+  VLCB::CANFrame heartbeat = {0x22, false, false, 6, {OPC_HEARTB, 0x01, 0x04, 1, 0, 0}};
+  port0->setNextMessage(heartbeat);
+  controller.process();
+  assertEquals(0, bridgeService->getNodePort(0x0104));
+  assertEquals(1, bridgeService->getPortStats(0).canidMoves);
+}
+
+void testEventFilters()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  assertEquals(true, bridgeService->addEventFilter(0, 0x0102, 10, 19));
+  assertEquals(true, bridgeService->addEventFilter(0, 0, 100, 100));
+
+  VLCB::CANFrame matching = {0x11, false, false, 5, {OPC_ACON, 0x01, 0x02, 0x00, 12}};
+  VLCB::CANFrame otherNode = {0x11, false, false, 5, {OPC_ACON, 0x01, 0x03, 0x00, 12}};
+  VLCB::CANFrame anyNode = {0x12, false, false, 5, {OPC_ASOF, 0x01, 0x05, 0x00, 100}};
+  VLCB::CANFrame outOfRange = {0x11, false, false, 5, {OPC_ACOF, 0x01, 0x02, 0x00, 20}};
+  port0->setNextMessage(matching);
+  port0->setNextMessage(otherNode);
+  port0->setNextMessage(anyNode);
+  port0->setNextMessage(outOfRange);
+
+  // No filters for segment 1. All events are forwarded.
+  VLCB::CANFrame fromOtherSide = {0x21, false, false, 5, {OPC_ACON, 0x02, 0x02, 0x00, 1}};
+  port1->setNextMessage(fromOtherSide);
+
+  controller.process();
+
+  assertEquals(2, port1->sent_frames.size());
+  assertEquals(12, port1->sent_frames[0].data[4]);
+  assertEquals(100, port1->sent_frames[1].data[4]);
+  assertEquals(2, bridgeService->getPortStats(0).framesFiltered);
+  assertEquals(1, port0->sent_frames.size());
+
+  bridgeService->clearEventFilters();
+  port0->setNextMessage(outOfRange);
+  controller.process();
+  assertEquals(3, port1->sent_frames.size());
+}
+
+void testShortEventWithFilters()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  assertEquals(true, bridgeService->addEventFilter(0, 0x0102, 10, 19));
+
+  // Too short for the filters to read the event number.
+  VLCB::CANFrame shortEvent = {0x11, false, false, 3, {OPC_ACON, 0x01, 0x02}};
+  port0->setNextMessage(shortEvent);
+
+  controller.process();
+
+  assertEquals(1, port1->sent_frames.size());
+  assertEquals(3, port1->sent_frames[0].len);
+  assertEquals(0, bridgeService->getPortStats(0).framesFiltered);
+
+  // Ports that do not exist have no statistics.
+  assertEquals(0, bridgeService->getPortStats(VLCB::BRIDGE_PORTS).framesReceived);
+  assertEquals(0, bridgeService->getQueueUsage(VLCB::BRIDGE_PORTS));
+}
+
+void testBackpressure()
+{
+  test();
+
+  VLCB::Controller controller = createController(2);
+  bridgeService->setMaxFramesPerProcess(10);
+  port1->sendFails = true;
+
+  VLCB::CANFrame qnn = {0x11, false, false, 1, {OPC_QNN}};
+  for (int i = 0; i < 5; ++i)
+  {
+    port0->setNextMessage(qnn);
+  }
+
+  controller.process();
+
+  // The queue for segment 1 is full. Remaining frames stay in the transport.
+  assertEquals(2, bridgeService->getQueueUsage(1));
+  assertEquals(3, port0->incoming_frames.size());
+  assertEquals(1, bridgeService->getPortStats(0).backpressure);
+  assertEquals(2, bridgeService->getPortStats(1).queuePeak);
+
+  port1->sendFails = false;
+  controller.process();
+  controller.process();
+
+  assertEquals(0, port0->incoming_frames.size());
+  assertEquals(5, port1->sent_frames.size());
+  assertEquals(5, bridgeService->getPortStats(1).framesSent);
+}
+
+}
+
+void testCanBridgeService()
+{
+  testForwardBothWays();
+  testAddressedMessageRouting();
+  testEventFilters();
+  testShortEventWithFilters();
+  testBackpressure();
+}
@@ -12,9 +12,12 @@
 #include "Controller.h"
 #include "MinimumNodeServiceWithDiagnostics.h"
 #include "CanServiceWithDiagnostics.h"
+#include "EventConsumerService.h"
+#include "EventTeachingService.h"
 #include "VlcbCommon.h"
 #include "ArduinoMock.hpp"
 #include "MockCanTransport.h"
+#include "MockStorage.h"
 
 namespace
 {
@@ -22,6 +25,9 @@ std::unique_ptr<VLCB::MinimumNodeService> minimumNodeService;
 
 // Use MockCanTransport to test CanTransport class.
 std::unique_ptr<MockCanTransport> mockCanTransport;
+std::unique_ptr<VLCB::CanService> canService;
+// Second transport such as a GridConnect link to a PC.
+std::unique_ptr<MockCanTransport> serialTransport;
 
 VLCB::Controller createController(VlcbModeParams startupMode = MODE_NORMAL)
 {
@@ -29,7 +35,6 @@ VLCB::Controller createController(VlcbModeParams startupMode = MODE_NORMAL)
 
   mockCanTransport.reset(new MockCanTransport);
 
-  static std::unique_ptr<VLCB::CanService> canService;
   canService.reset(new VLCB::CanServiceWithDiagnostics(mockCanTransport.get()));
 
   VLCB::Controller controller = ::createController(startupMode, {minimumNodeService.get(), canService.get()});
@@ -63,7 +68,7 @@ void testServiceDiscovery()
   assertEquals(OPC_SD, mockCanTransport->sent_frames[2].data[0]);
   assertEquals(2, mockCanTransport->sent_frames[2].data[3]); // index
   assertEquals(SERVICE_ID_CAN, mockCanTransport->sent_frames[2].data[4]); // service ID
-  assertEquals(2, mockCanTransport->sent_frames[2].data[5]); // version
+  assertEquals(3, mockCanTransport->sent_frames[2].data[5]); // version
 }
 
 void testServiceDiscoveryCanSvc()
@@ -229,6 +234,689 @@ void testRtrMessage()
   assertEquals(3, mockCanTransport->sent_frames[0].id & 0x7F);
 }
 
+void testRtrMessageWithResponseWindow()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  controller.getModuleConfig()->CANID = 64;
+  canService->setEnumerationResponseWindow(80);
+
+  VLCB::CANFrame msg = {0x11, false, true, 0, {}};
+  mockCanTransport->setNextMessage(msg);
+  process(controller);
+  assertEquals(0, mockCanTransport->sent_frames.size());
+
+  // A second RTR while waiting does not give a second reply.
+  mockCanTransport->setNextMessage(msg);
+  addMillis(39);
+  process(controller);
+  assertEquals(0, mockCanTransport->sent_frames.size());
+
+  // CANID 64 replies half way through the window.
+  addMillis(1);
+  process(controller);
+  assertEquals(1, mockCanTransport->sent_frames.size());
+  assertEquals(0, mockCanTransport->sent_frames[0].len);
+  assertEquals(64, mockCanTransport->sent_frames[0].id & 0x7F);
+
+  addMillis(100);
+  process(controller);
+  assertEquals(1, mockCanTransport->sent_frames.size());
+}
+
+// Another node on the simulated bus with its own configuration.
+struct SimulatedNode
+{
+  SimulatedNode(byte canid, byte responseWindow)
+    : configuration(createTestConfiguration(&storage))
+    , canService(&transport)
+    , controller(configuration.get(), {&canService})
+  {
+    configuration->setCANID(canid);
+    canService.setEnumerationResponseWindow(responseWindow);
+  }
+
+  MockStorage storage;
+  std::unique_ptr<VLCB::Configuration> configuration;
+  MockCanTransport transport;
+  VLCB::CanService canService;
+  VLCB::Controller controller;
+};
+
+// Enumerate a bus where 120 other nodes use CANIDs 1 to 120.
+// The bus carries 125 bits each millisecond. Like the MCP2515 the enumerating
+// node has room for 2 received frames and it takes them every millisecond.
+// Returns the number of frames lost as the receive buffer was full.
+unsigned int simulateEnumeration(VLCB::Controller & controller, byte responseWindow)
+{
+  const byte NODE_COUNT = 120;
+  const unsigned int RECEIVE_BUFFERS = 2;
+
+  std::vector<std::unique_ptr<SimulatedNode>> nodes;
+  for (byte canid = 1; canid <= NODE_COUNT; ++canid)
+  {
+    nodes.emplace_back(new SimulatedNode(canid, responseWindow));
+  }
+
+  controller.getModuleConfig()->setCANID(127);
+  controller.putAction({VLCB::ACT_START_CAN_ENUMERATION});
+  process(controller);
+  assertEquals(true, mockCanTransport->sent_frames.back().rtr);
+  for (auto & node : nodes)
+  {
+    node->transport.setNextMessage(mockCanTransport->sent_frames.back());
+  }
+
+  std::deque<VLCB::CANFrame> bus;
+  unsigned int bitsAvailable = 0;
+  unsigned int lostFrames = 0;
+  for (int ms = 0; ms <= 100; ++ms)
+  {
+    for (auto & node : nodes)
+    {
+      node->controller.process();
+      bus.insert(bus.end(), node->transport.sent_frames.begin(), node->transport.sent_frames.end());
+      node->transport.sent_frames.clear();
+    }
+
+    bitsAvailable += 125;
+    while (!bus.empty() && bitsAvailable >= VLCB::BusLoadMeter::frameBits(bus.front()))
+    {
+      bitsAvailable -= VLCB::BusLoadMeter::frameBits(bus.front());
+      if (mockCanTransport->incoming_frames.size() < RECEIVE_BUFFERS)
+      {
+        mockCanTransport->setNextMessage(bus.front());
+      }
+      else
+      {
+        ++lostFrames;
+      }
+      bus.pop_front();
+    }
+    if (bus.empty())
+    {
+      // An idle bus does not save up bit time.
+      bitsAvailable = 0;
+    }
+
+    addMillis(1);
+    process(controller);
+  }
+
+  return lostFrames;
+}
+
+void testEnumerationOfBusyBus()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+
+  // All nodes reply at once and the enumerating node loses replies.
+  unsigned int lostFrames = simulateEnumeration(controller, 0);
+  assertEquals(true, lostFrames > 0);
+  assertEquals(true, controller.getModuleCANID() < 121);
+}
+
+void testEnumerationOfBusyBusWithResponseWindow()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+
+  unsigned int lostFrames = simulateEnumeration(controller, 80);
+  assertEquals(0, lostFrames);
+  assertEquals(121, controller.getModuleCANID());
+}
+
+void testDrainSeveralFramesPerProcess()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  controller.getModuleConfig()->CANID = 3;
+  // No service consumes ACON in this controller.
+  canService->setReceiveFilter(false);
+
+  VLCB::CANFrame rtr = {0x11, false, true, 0, {}};
+  VLCB::CANFrame acon = {0x11, false, false, 5, {OPC_ACON, 0x01, 0x02, 0x00, 0x05}};
+  mockCanTransport->setNextMessage(rtr);
+  for (int i = 0; i < 6; ++i)
+  {
+    mockCanTransport->setNextMessage(acon);
+  }
+  mockCanTransport->setNextMessage(rtr);
+
+  controller.process();
+
+  // The RTR is answered inline and does not count against the budget of 4 messages.
+  assertEquals(3, mockCanTransport->incoming_frames.size());
+  assertEquals(1, mockCanTransport->sent_frames.size());
+  assertEquals(8, canService->getReceiveBacklogPeak());
+
+  controller.process();
+
+  assertEquals(0, mockCanTransport->incoming_frames.size());
+  assertEquals(2, mockCanTransport->sent_frames.size());
+  assertEquals(8, canService->getReceiveBacklogPeak());
+}
+
+void testDrainBudget()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  canService->setMaxFramesPerProcess(1);
+  canService->setReceiveFilter(false);
+
+  VLCB::CANFrame acon = {0x11, false, false, 5, {OPC_ACON, 0x01, 0x02, 0x00, 0x05}};
+  for (int i = 0; i < 3; ++i)
+  {
+    mockCanTransport->setNextMessage(acon);
+  }
+
+  controller.process();
+
+  assertEquals(2, mockCanTransport->incoming_frames.size());
+  assertEquals(3, canService->getReceiveBacklogPeak());
+}
+
+void testDrainBoundedForDroppedFrames()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+
+  // Extended frames are dropped and never reach the action queue.
+  VLCB::CANFrame ext = {0x11, true, false, 1, {0x01}};
+  for (int i = 0; i < 40; ++i)
+  {
+    mockCanTransport->setNextMessage(ext);
+  }
+
+  controller.process();
+  assertEquals(40 - VLCB::DEFAULT_MAX_FRAMES_READ_PER_PROCESS, mockCanTransport->incoming_frames.size());
+
+  canService->setMaxFramesReadPerProcess(5);
+  controller.process();
+  assertEquals(40 - VLCB::DEFAULT_MAX_FRAMES_READ_PER_PROCESS - 5, mockCanTransport->incoming_frames.size());
+  assertEquals(40, canService->getReceiveBacklogPeak());
+}
+
+void testDrainStopsWhenActionQueueFull()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  canService->setMaxFramesPerProcess(100);
+  canService->setReceiveFilter(false);
+
+  VLCB::CANFrame acon = {0x11, false, false, 5, {OPC_ACON, 0x01, 0x02, 0x00, 0x05}};
+  for (int i = 0; i < 40; ++i)
+  {
+    mockCanTransport->setNextMessage(acon);
+  }
+
+  controller.process();
+
+  // Each message takes two slots in the action queue of 30.
+  // The action being processed keeps its slot until all services have seen it.
+  assertEquals(26, mockCanTransport->incoming_frames.size());
+  assertEquals(29, controller.getActionQueuePeak());
+}
+
+// Records where services see the payload of messages.
+class PayloadProbeService : public VLCB::Service
+{
+public:
+  virtual VlcbServiceTypes getServiceID() const override { return SERVICE_ID_NONE; }
+  virtual byte getServiceVersionID() const override { return 1; }
+
+  virtual void process(const VLCB::Action * action) override
+  {
+    if (action == nullptr)
+    {
+      return;
+    }
+    if (action->actionType == VLCB::ACT_MESSAGE_IN && action->vlcbMessage.data[0] == OPC_ACON)
+    {
+      receivedData = action->vlcbMessage.data;
+      VLCB::VlcbMessage reply = {5, {OPC_ACOF, 0x01, 0x02, 0x00, 0x06}};
+      controller->sendMessage(&reply);
+    }
+    else if (action->actionType == VLCB::ACT_MESSAGE_OUT)
+    {
+      sentData = action->vlcbMessage.data;
+    }
+  }
+
+  const uint8_t * receivedData = nullptr;
+  const uint8_t * sentData = nullptr;
+};
+
+void testPayloadCopiedOnce()
+{
+  test();
+
+  minimumNodeService.reset(new VLCB::MinimumNodeService);
+  mockCanTransport.reset(new MockCanTransport);
+  canService.reset(new VLCB::CanService(mockCanTransport.get()));
+  std::unique_ptr<PayloadProbeService> probe(new PayloadProbeService);
+  VLCB::Controller controller = ::createController({minimumNodeService.get(), canService.get(), probe.get()});
+  controller.begin();
+
+  VLCB::CANFrame acon = {0x11, false, false, 5, {OPC_ACON, 0x01, 0x02, 0x00, 0x05}};
+  mockCanTransport->setNextMessage(acon);
+
+  process(controller);
+
+  assertEquals(true, probe->receivedData != nullptr);
+  assertEquals(true, probe->sentData != nullptr);
+  // The transport received the payload straight into the action that the services see.
+  assertEquals(mockCanTransport->lastReceiveData, probe->receivedData);
+  // The reply was sent straight from the action that the reply was queued in.
+  assertEquals(mockCanTransport->lastTransmitData, probe->sentData);
+
+  assertEquals(1, mockCanTransport->sent_frames.size());
+  assertEquals(OPC_ACOF, mockCanTransport->sent_frames[0].data[0]);
+  assertEquals(0x06, mockCanTransport->sent_frames[0].data[4]);
+}
+
+unsigned int requestDiagnostic(VLCB::Controller & controller, byte diagnosticsCode)
+{
+  const byte serviceIndex = 2;
+  VLCB::CANFrame msg = {0x11, false, false, 5, {OPC_RDGN, 0x01, 0x04, serviceIndex, diagnosticsCode}};
+  mockCanTransport->setNextMessage(msg);
+  mockCanTransport->sent_frames.clear();
+
+  process(controller);
+
+  const VLCB::CANFrame & dgn = mockCanTransport->sent_frames.back();
+  assertEquals(OPC_DGN, dgn.data[0]);
+  assertEquals(diagnosticsCode, dgn.data[4]);
+  return (dgn.data[5] << 8) + dgn.data[6];
+}
+
+void testDiagnosticsEnumerationAndConflict()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  controller.getModuleConfig()->setCANID(3);
+
+  // A message from another node using our CANID.
+  VLCB::CANFrame msg = {3, false, false, 1, {OPC_RQNP}};
+  mockCanTransport->setNextMessage(msg);
+  process(controller);
+  addMillis(101);
+  process(controller);
+
+  assertEquals(1, controller.getModuleCANID());
+  assertEquals(1, requestDiagnostic(controller, 0x0D)); // enumerations
+  assertEquals(1, requestDiagnostic(controller, 0x0E)); // conflicts
+  assertEquals(1, requestDiagnostic(controller, 0x0F)); // CANID changes
+  assertEquals(0, requestDiagnostic(controller, 0x10)); // enumeration failures
+}
+
+void testDiagnosticsCanidChange()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  controller.getModuleConfig()->setCANID(3);
+
+  VLCB::CANFrame msg = {0x11, false, false, 4, {OPC_CANID, 0x01, 0x04, 5}};
+  mockCanTransport->setNextMessage(msg);
+  process(controller);
+  assertEquals(5, controller.getModuleCANID());
+
+  // Setting the same CANID again is not a change.
+  mockCanTransport->setNextMessage(msg);
+  process(controller);
+
+  assertEquals(1, requestDiagnostic(controller, 0x0F));
+  assertEquals(0, requestDiagnostic(controller, 0x0D));
+}
+
+void testDiagnosticsEnumerationFailure()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  controller.getModuleConfig()->setCANID(3);
+  controller.putAction({VLCB::ACT_START_CAN_ENUMERATION});
+  process(controller);
+
+  // Every CANID is taken.
+  for (byte remoteCanid = 1 ; remoteCanid <= 127 ; ++remoteCanid)
+  {
+    VLCB::CANFrame msg = {remoteCanid, false, false, 0, {}};
+    mockCanTransport->setNextMessage(msg);
+  }
+  while (!mockCanTransport->incoming_frames.empty())
+  {
+    process(controller);
+  }
+  addMillis(101);
+  process(controller);
+
+  assertEquals(1, requestDiagnostic(controller, 0x10));
+}
+
+void testDiagnosticsBusLoad()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  canService->getBusLoadMeter().reset();
+
+  for (int i = 0; i < 4; ++i)
+  {
+    VLCB::CANFrame msg = {0x11, false, false, 5, {OPC_ACON, 0x01, 0x02, 0x00, 0x03}};
+    mockCanTransport->setNextMessage(msg);
+    process(controller);
+  }
+  addMillis(1000);
+  process(controller);
+
+  // Frames per second, 4 received
+  assertEquals(4, requestDiagnostic(controller, 0x17));
+  // 4 * 111 bits of 125000 bit/s
+  assertEquals(3, requestDiagnostic(controller, 0x13));
+  assertEquals(0, requestDiagnostic(controller, 0x14));
+}
+
+void testReceiveFilter()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+
+  // Not consumed by any service here.
+  VLCB::CANFrame acon = {0x11, false, false, 5, {OPC_ACON, 0x01, 0x02, 0x00, 0x05}};
+  // Addressed to another node.
+  VLCB::CANFrame otherNode = {0x11, false, false, 4, {OPC_RQNPN, 0x01, 0x05, 1}};
+  // Addressed to this node.
+  VLCB::CANFrame rqnpn = {0x11, false, false, 4, {OPC_RQNPN, 0x01, 0x04, 1}};
+  mockCanTransport->setNextMessage(acon);
+  mockCanTransport->setNextMessage(otherNode);
+  mockCanTransport->setNextMessage(rqnpn);
+
+  controller.process();
+
+  assertEquals(0, mockCanTransport->incoming_frames.size());
+  assertEquals(2, canService->getFilteredFrameCount());
+
+  process(controller);
+  assertEquals(1, mockCanTransport->sent_frames.size());
+  assertEquals(OPC_PARAN, mockCanTransport->sent_frames[0].data[0]);
+
+  assertEquals(2, requestDiagnostic(controller, 0x19));
+}
+
+byte consumedEvents;
+
+void countConsumedEvent(byte /*index*/, const VLCB::VlcbMessage * /*msg*/)
+{
+  ++consumedEvents;
+}
+
+void testReceiveFilterWithQueuedTeaching()
+{
+  test();
+  consumedEvents = 0;
+
+  static std::unique_ptr<VLCB::EventTeachingService> eventTeachingService;
+  static std::unique_ptr<VLCB::EventConsumerService> eventConsumerService;
+  minimumNodeService.reset(new VLCB::MinimumNodeService);
+  eventTeachingService.reset(new VLCB::EventTeachingService);
+  eventConsumerService.reset(new VLCB::EventConsumerService);
+  mockCanTransport.reset(new MockCanTransport);
+  canService.reset(new VLCB::CanService(mockCanTransport.get()));
+  VLCB::Controller controller = ::createController({minimumNodeService.get(), eventTeachingService.get(),
+                                                    eventConsumerService.get(), canService.get()});
+  controller.begin();
+  eventConsumerService->setEventHandler(countConsumedEvent);
+
+  // The event is taught and used in the same batch of frames.
+  VLCB::CANFrame nnlrn = {0x11, false, false, 3, {OPC_NNLRN, 0x01, 0x04}};
+  VLCB::CANFrame evlrn = {0x11, false, false, 7, {OPC_EVLRN, 0x01, 0x02, 0x00, 0x05, 1, 42}};
+  VLCB::CANFrame acon = {0x11, false, false, 5, {OPC_ACON, 0x01, 0x02, 0x00, 0x05}};
+  VLCB::CANFrame nnuln = {0x11, false, false, 3, {OPC_NNULN, 0x01, 0x04}};
+  mockCanTransport->setNextMessage(nnlrn);
+  mockCanTransport->setNextMessage(evlrn);
+  mockCanTransport->setNextMessage(acon);
+  mockCanTransport->setNextMessage(nnuln);
+
+  process(controller);
+
+  assertEquals(0, mockCanTransport->incoming_frames.size());
+  assertEquals(0, canService->getFilteredFrameCount());
+  assertEquals(1, consumedEvents);
+
+  // Filtering resumes when no teaching messages are queued.
+  VLCB::CANFrame unknown = {0x11, false, false, 5, {OPC_ACON, 0x01, 0x02, 0x00, 0x06}};
+  mockCanTransport->setNextMessage(unknown);
+  mockCanTransport->setNextMessage(acon);
+
+  process(controller);
+
+  assertEquals(1, canService->getFilteredFrameCount());
+  assertEquals(2, consumedEvents);
+}
+
+void testAcceptanceFilter()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  // Only receive frames from CANID 0x11.
+  VLCB::CanAcceptanceFilter filter = {0x7F, 0x11};
+  assertEquals(true, mockCanTransport->setAcceptanceFilters(&filter, 1));
+
+  VLCB::CANFrame fromOther = {0x12, false, false, 4, {OPC_RQNPN, 0x01, 0x04, 1}};
+  VLCB::CANFrame extended = {0x11, true, false, 4, {OPC_RQNPN, 0x01, 0x04, 1}};
+  VLCB::CANFrame accepted = {0x11, false, false, 4, {OPC_RQNPN, 0x01, 0x04, 2}};
+  mockCanTransport->setNextMessage(fromOther);
+  mockCanTransport->setNextMessage(extended);
+  mockCanTransport->setNextMessage(accepted);
+
+  process(controller);
+
+  assertEquals(0, mockCanTransport->incoming_frames.size());
+  assertEquals(1, mockCanTransport->sent_frames.size());
+  assertEquals(OPC_PARAN, mockCanTransport->sent_frames[0].data[0]);
+  assertEquals(2, mockCanTransport->sent_frames[0].data[3]);
+
+  // Too many filters are rejected and the previous filters stay.
+  VLCB::CanAcceptanceFilter filters[VLCB::MAX_ACCEPTANCE_FILTERS + 1] = {};
+  assertEquals(false, mockCanTransport->setAcceptanceFilters(filters, VLCB::MAX_ACCEPTANCE_FILTERS + 1));
+  assertEquals(false, mockCanTransport->acceptsFrame({0x12, false, false, 4}));
+
+  // CANID enumeration requests and replies from other nodes are always accepted.
+  assertEquals(true, mockCanTransport->acceptsFrame({0x12, false, true, 0}));
+  assertEquals(true, mockCanTransport->acceptsFrame({0x12, false, false, 0}));
+  assertEquals(false, mockCanTransport->acceptsFrame({0x12, true, false, 0}));
+
+  // No filters receive everything.
+  assertEquals(true, mockCanTransport->setAcceptanceFilters(nullptr, 0));
+  assertEquals(true, mockCanTransport->acceptsFrame({0x12, false, false, 4}));
+  assertEquals(true, mockCanTransport->acceptsFrame({0x11, true, false, 4}));
+}
+
+VLCB::Controller createControllerWithSerialTransport(byte queueSize)
+{
+  VLCB::Controller controller = createController();
+  serialTransport.reset(new MockCanTransport);
+  assertEquals(true, canService->addTransport(serialTransport.get(), queueSize));
+  return controller;
+}
+
+void testRouteBetweenTransports()
+{
+  test();
+
+  VLCB::Controller controller = createControllerWithSerialTransport(4);
+  assertEquals(2, canService->getTransportCount());
+
+  // Not consumed by any service here but shall still reach the other transport.
+  VLCB::CANFrame aconFromBus = {0x11, false, false, 5, {OPC_ACON, 0x01, 0x02, 0x00, 0x05}};
+  mockCanTransport->setNextMessage(aconFromBus);
+  // Addressed to this node.
+  VLCB::CANFrame rqnpnFromPc = {0x7E, false, false, 4, {OPC_RQNPN, 0x01, 0x04, 1}};
+  serialTransport->setNextMessage(rqnpnFromPc);
+
+  process(controller);
+
+  // The bus sees the request from the PC and the reply from this node.
+  assertEquals(2, mockCanTransport->sent_frames.size());
+  assertEquals(OPC_RQNPN, mockCanTransport->sent_frames[0].data[0]);
+  assertEquals(0x7E, mockCanTransport->sent_frames[0].id);
+  assertEquals(OPC_PARAN, mockCanTransport->sent_frames[1].data[0]);
+
+  // The PC sees the event from the bus and the reply but not its own request.
+  assertEquals(2, serialTransport->sent_frames.size());
+  assertEquals(OPC_ACON, serialTransport->sent_frames[0].data[0]);
+  assertEquals(OPC_PARAN, serialTransport->sent_frames[1].data[0]);
+
+  assertEquals(1, canService->getForwardedFrames(0));
+  assertEquals(1, canService->getForwardedFrames(1));
+  assertEquals(0, canService->getTotalTransmitDrops());
+}
+
+void testRouteIgnoresAcceptanceFilters()
+{
+  test();
+
+  VLCB::Controller controller = createControllerWithSerialTransport(4);
+  // This module only wants frames from CANID 0x22.
+  VLCB::CanAcceptanceFilter filter = {0x7F, 0x22};
+  assertEquals(true, mockCanTransport->setAcceptanceFilters(&filter, 1));
+
+  VLCB::CANFrame aconFromBus = {0x11, false, false, 5, {OPC_ACON, 0x01, 0x02, 0x00, 0x05}};
+  mockCanTransport->setNextMessage(aconFromBus);
+
+  process(controller);
+
+  assertEquals(1, serialTransport->sent_frames.size());
+  assertEquals(OPC_ACON, serialTransport->sent_frames[0].data[0]);
+}
+
+void testRouteWithFullActionQueue()
+{
+  test();
+
+  VLCB::Controller controller = createControllerWithSerialTransport(4);
+
+  // Leave no room for incoming messages to this module's services.
+  while (controller.actionQueueHasSpace(1))
+  {
+    controller.putAction(VLCB::ACT_INDICATE_WORK);
+  }
+
+  VLCB::CANFrame aconFromBus = {0x11, false, false, 5, {OPC_ACON, 0x01, 0x02, 0x00, 0x05}};
+  mockCanTransport->setNextMessage(aconFromBus);
+
+  controller.process();
+
+  assertEquals(1, serialTransport->sent_frames.size());
+  assertEquals(OPC_ACON, serialTransport->sent_frames[0].data[0]);
+  assertEquals(1, canService->getLocalReceiveDrops());
+  assertEquals(0, mockCanTransport->incoming_frames.size());
+}
+
+void testTransmitQueuePerTransport()
+{
+  test();
+
+  VLCB::Controller controller = createControllerWithSerialTransport(2);
+  serialTransport->sendFails = true;
+
+  for (byte en = 1; en <= 3; ++en)
+  {
+    VLCB::CANFrame acon = {0x11, false, false, 5, {OPC_ACON, 0x01, 0x02, 0x00, en}};
+    mockCanTransport->setNextMessage(acon);
+  }
+
+  process(controller);
+
+  // The PC link is busy. Two frames wait in its queue and the third is dropped.
+  assertEquals(0, serialTransport->sent_frames.size());
+  assertEquals(0, canService->getTransmitDrops(0));
+  assertEquals(1, canService->getTransmitDrops(1));
+  assertEquals(3, canService->getForwardedFrames(0));
+
+  // The PC link is free again.
+  serialTransport->sendFails = false;
+  assertEquals(1, requestDiagnostic(controller, 0x1A));
+
+  // Queued frames are sent first and in order.
+  assertEquals(4, serialTransport->sent_frames.size());
+  assertEquals(1, serialTransport->sent_frames[0].data[4]);
+  assertEquals(2, serialTransport->sent_frames[1].data[4]);
+  assertEquals(OPC_RDGN, serialTransport->sent_frames[2].data[0]);
+  assertEquals(OPC_DGN, serialTransport->sent_frames[3].data[0]);
+}
+
+void testTransportLimit()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  MockCanTransport extraTransports[VLCB::MAX_CAN_TRANSPORTS];
+  for (byte i = 1; i < VLCB::MAX_CAN_TRANSPORTS; ++i)
+  {
+    assertEquals(true, canService->addTransport(&extraTransports[i]));
+  }
+  assertEquals(false, canService->addTransport(&extraTransports[0]));
+  assertEquals(VLCB::MAX_CAN_TRANSPORTS, canService->getTransportCount());
+}
+
+void testPriorityFromOpCode()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  controller.getModuleConfig()->CANID = 3;
+
+  VLCB::VlcbMessage acon = {5, {OPC_ACON, 0x01, 0x04, 0x00, 0x05}};
+  controller.sendMessage(&acon);
+  VLCB::VlcbMessage dtxc = {8, {OPC_DTXC, 1, 2, 3, 4, 5, 6, 7}};
+  controller.sendMessage(&dtxc);
+  VLCB::VlcbMessage rqnp = {1, {OPC_RQNP}};
+  controller.sendMessage(&rqnp);
+  VLCB::VlcbMessage arst = {1, {OPC_ARST}};
+  controller.sendMessage(&arst);
+
+  process(controller);
+
+  assertEquals(4, mockCanTransport->sent_frames.size());
+  assertEquals(VLCB::CAN_PRIORITY_EVENT, mockCanTransport->sentPriority(0));
+  assertEquals(VLCB::CAN_PRIORITY_BULK, mockCanTransport->sentPriority(1));
+  assertEquals(VLCB::CAN_PRIORITY_NORMAL, mockCanTransport->sentPriority(2));
+  assertEquals(VLCB::CAN_PRIORITY_EMERGENCY, mockCanTransport->sentPriority(3));
+  assertEquals(3, mockCanTransport->sent_frames[0].id & 0x7F);
+
+  // Events win arbitration over bulk data.
+  assertEquals(true, mockCanTransport->sent_frames[0].id < mockCanTransport->sent_frames[1].id);
+}
+
+void testPriorityOverride()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+
+  VLCB::VlcbMessage acon = {5, {OPC_ACON, 0x01, 0x04, 0x00, 0x05}};
+  controller.sendMessage(&acon, VLCB::PRIORITY_BULK);
+
+  process(controller);
+
+  assertEquals(1, mockCanTransport->sent_frames.size());
+  assertEquals(VLCB::CAN_PRIORITY_BULK, mockCanTransport->sentPriority(0));
+}
+
 void testFindFreeCanidOnPopulatedBus()
 {
   test();
@@ -306,14 +994,14 @@ void testRequestAllDiagnosticsCanService()
   process(controller);
 
   // Verify sent messages.
-  assertEquals(19, mockCanTransport->sent_frames.size());
+  assertEquals(27, mockCanTransport->sent_frames.size());
 
   int messageIndex = 0;
   assertEquals(OPC_DGN, mockCanTransport->sent_frames[messageIndex].data[0]);
   assertEquals(serviceIndex, mockCanTransport->sent_frames[messageIndex].data[3]);
   assertEquals(0, mockCanTransport->sent_frames[messageIndex].data[4]);
   assertEquals(0, mockCanTransport->sent_frames[messageIndex].data[5]);
-  assertEquals(18, mockCanTransport->sent_frames[messageIndex].data[6]);
+  assertEquals(26, mockCanTransport->sent_frames[messageIndex].data[6]);
 
   ++messageIndex;
   assertEquals(OPC_DGN, mockCanTransport->sent_frames[messageIndex].data[0]);
@@ -453,6 +1141,28 @@ void testCanService()
   testCanidEnumerationOnConflict();
   testCanidEnumerationOnENUM(); // Deprecated
   testRtrMessage();
+  testRtrMessageWithResponseWindow();
+  testEnumerationOfBusyBus();
+  testEnumerationOfBusyBusWithResponseWindow();
+  testDrainSeveralFramesPerProcess();
+  testDrainBudget();
+  testDrainBoundedForDroppedFrames();
+  testDrainStopsWhenActionQueueFull();
+  testPayloadCopiedOnce();
+  testDiagnosticsEnumerationAndConflict();
+  testDiagnosticsCanidChange();
+  testDiagnosticsEnumerationFailure();
+  testDiagnosticsBusLoad();
+  testReceiveFilter();
+  testReceiveFilterWithQueuedTeaching();
+  testAcceptanceFilter();
+  testRouteBetweenTransports();
+  testRouteIgnoresAcceptanceFilters();
+  testRouteWithFullActionQueue();
+  testTransmitQueuePerTransport();
+  testTransportLimit();
+  testPriorityFromOpCode();
+  testPriorityOverride();
   testFindFreeCanidOnPopulatedBus();
   testCANID(); // Deprecated
   testRequestAllDiagnosticsCanService();
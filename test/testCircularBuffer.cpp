@@ -116,6 +116,26 @@ void testHeadWrapAround()
   assertEquals(5, buffer.getNumberOfPuts());
 }
 
+void testReserveAndCommit()
+{
+  test();
+
+  VLCB::CircularBuffer<int> buffer(2);
+  int * slot = buffer.reserve();
+  *slot = 7;
+  assertEquals(false, buffer.available());
+  buffer.commit();
+
+  buffer.put(8);
+  assertEquals(true, buffer.reserve() == nullptr);
+
+  assertEquals(slot, buffer.peek());
+  assertEquals(7, buffer.pop());
+  assertEquals(8, buffer.pop());
+  assertEquals(2, buffer.getNumberOfPuts());
+  assertEquals(0, buffer.getOverflows());
+}
+
 }
 
 void testCircularBuffer()
@@ -125,4 +145,5 @@ void testCircularBuffer()
   testFull();
   testOverflow();
   testHeadWrapAround();
+  testReserveAndCommit();
 }
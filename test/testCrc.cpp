@@ -0,0 +1,51 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+// Test cases for the CRC functions.
+
+#include "TestTools.hpp"
+#include "Crc.h"
+
+namespace
+{
+
+const uint8_t checkData[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+
+void testCrc16CheckValue()
+{
+  test();
+  // CRC-16/X-25 check value 0x906E with its bytes swapped.
+  assertEquals(0x6E90, VLCB::crc16(checkData, sizeof(checkData)));
+  assertEquals(0, VLCB::crc16(checkData, 0));
+}
+
+void testCrc32CheckValue()
+{
+  test();
+  assertEquals(0xCBF43926, VLCB::crc32(checkData, sizeof(checkData)));
+  assertEquals(0, VLCB::crc32(checkData, 0));
+}
+
+void testIncrementalUpdate()
+{
+  test();
+  // Update in fragments of 5 bytes as long messages do.
+  uint16_t crc16 = VLCB::crc16Update(VLCB::CRC16_INITIAL, checkData, 5);
+  crc16 = VLCB::crc16Update(crc16, checkData + 5, 4);
+  assertEquals(VLCB::crc16(checkData, sizeof(checkData)), VLCB::crc16Result(crc16));
+
+  uint32_t crc32 = VLCB::crc32Update(VLCB::CRC32_INITIAL, checkData, 5);
+  crc32 = VLCB::crc32Update(crc32, checkData + 5, 4);
+  assertEquals(VLCB::crc32(checkData, sizeof(checkData)), VLCB::crc32Result(crc32));
+}
+
+}
+
+void testCrc()
+{
+  testCrc16CheckValue();
+  testCrc32CheckValue();
+  testIncrementalUpdate();
+}
@@ -0,0 +1,107 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+// Test cases for deciding when emulated EEPROM is committed to flash.
+
+#include "TestTools.hpp"
+#include "ArduinoMock.hpp"
+#include "DeferredCommit.h"
+
+namespace
+{
+
+void testNothingToCommit()
+{
+  test();
+  clearArduinoValues();
+  VLCB::DeferredCommit deferredCommit;
+
+  addMillis(1000);
+  assertEquals(false, deferredCommit.isDirty());
+  assertEquals(false, deferredCommit.isCommitDue());
+}
+
+void testCommitAfterQuietPeriod()
+{
+  test();
+  clearArduinoValues();
+  VLCB::DeferredCommit deferredCommit;
+
+  deferredCommit.markDirty();
+  assertEquals(true, deferredCommit.isDirty());
+  addMillis(VLCB::EEPROM_COMMIT_DELAY - 1);
+  assertEquals(false, deferredCommit.isCommitDue());
+  addMillis(1);
+  assertEquals(true, deferredCommit.isCommitDue());
+
+  deferredCommit.committed();
+  assertEquals(false, deferredCommit.isDirty());
+  assertEquals(false, deferredCommit.isCommitDue());
+  assertEquals(1, deferredCommit.getCommitCount());
+}
+
+void testBurstOfWritesCoalesced()
+{
+  test();
+  clearArduinoValues();
+  VLCB::DeferredCommit deferredCommit;
+
+  // Each write restarts the quiet period.
+  for (int i = 0; i < 10; ++i)
+  {
+    deferredCommit.markDirty();
+    addMillis(50);
+    assertEquals(false, deferredCommit.isCommitDue());
+  }
+
+  addMillis(VLCB::EEPROM_COMMIT_DELAY);
+  assertEquals(true, deferredCommit.isCommitDue());
+  deferredCommit.committed();
+  assertEquals(1, deferredCommit.getCommitCount());
+}
+
+void testMaxCommitDelay()
+{
+  test();
+  clearArduinoValues();
+  VLCB::DeferredCommit deferredCommit;
+
+  // Writes that never pause long enough are committed after the maximum delay.
+  for (unsigned int t = 0; t < VLCB::EEPROM_MAX_COMMIT_DELAY; t += 100)
+  {
+    deferredCommit.markDirty();
+    assertEquals(false, deferredCommit.isCommitDue());
+    addMillis(100);
+  }
+  assertEquals(true, deferredCommit.isCommitDue());
+  deferredCommit.committed();
+
+  // The maximum delay starts again with the first write after a commit.
+  deferredCommit.markDirty();
+  addMillis(100);
+  assertEquals(false, deferredCommit.isCommitDue());
+}
+
+void testCommitDelay()
+{
+  test();
+  clearArduinoValues();
+  VLCB::DeferredCommit deferredCommit;
+  deferredCommit.setCommitDelay(0);
+
+  deferredCommit.markDirty();
+  assertEquals(true, deferredCommit.isCommitDue());
+}
+
+}
+
+void testDeferredCommit()
+{
+  testNothingToCommit();
+  testCommitAfterQuietPeriod();
+  testBurstOfWritesCoalesced();
+  testMaxCommitDelay();
+  testCommitDelay();
+}
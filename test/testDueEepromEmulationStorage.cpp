@@ -0,0 +1,116 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+// Test cases for DueEepromEmulationStorage using a mocked DueFlashStorage library.
+// This file and DueEepromEmulationStorage.cpp are compiled as for the Arduino Due.
+
+#include "TestTools.hpp"
+#include "DueEepromEmulationStorage.h"
+#include "MockDueFlash.h"
+
+namespace
+{
+
+const unsigned long FLASH_SIZE = 4 * VLCB::DUE_FLASH_PAGE_SIZE;
+
+void testReadFromFlash()
+{
+  test();
+  mockDueFlash.reset(FLASH_SIZE);
+  mockDueFlash.memory[10] = 42;
+  VLCB::DueEepromEmulationStorage storage;
+
+  assertEquals(42, storage.read(10));
+  assertEquals(0xFF, storage.read(11));
+}
+
+void testReadAfterWriteWithinPage()
+{
+  test();
+  mockDueFlash.reset(FLASH_SIZE);
+  mockDueFlash.memory[20] = 7;
+  VLCB::DueEepromEmulationStorage storage;
+
+  const byte data[] = {1, 2, 3};
+  storage.writeBytes(10, data, 3);
+  storage.write(13, 4);
+
+  // Staged in RAM. The rest of the page is still read from the flash copy.
+  assertEquals(0, mockDueFlash.writeCount);
+  byte dest[4];
+  assertEquals(4, storage.readBytes(10, 4, dest));
+  assertEquals(1, dest[0]);
+  assertEquals(4, dest[3]);
+  assertEquals(7, storage.read(20));
+  assertEquals(0xFF, mockDueFlash.memory[10]);
+}
+
+void testCommitWritesPageOnce()
+{
+  test();
+  mockDueFlash.reset(FLASH_SIZE);
+  VLCB::DueEepromEmulationStorage storage;
+
+  storage.write(10, 1);
+  storage.write(11, 2);
+  storage.commitWriteEEPROM();
+
+  assertEquals(1, mockDueFlash.writeCount);
+  assertEquals(1, storage.getPageWriteCount());
+  assertEquals(1, mockDueFlash.memory[10]);
+  assertEquals(2, mockDueFlash.memory[11]);
+
+  // Nothing changed since the last commit.
+  storage.write(10, 1);
+  storage.commitWriteEEPROM();
+  assertEquals(1, mockDueFlash.writeCount);
+}
+
+void testCrossPageWriteFlushesPage()
+{
+  test();
+  mockDueFlash.reset(FLASH_SIZE);
+  VLCB::DueEepromEmulationStorage storage;
+
+  storage.write(10, 1);
+  storage.write(VLCB::DUE_FLASH_PAGE_SIZE + 10, 2);
+
+  // The first page was programmed when the second page was staged.
+  assertEquals(1, mockDueFlash.writeCount);
+  assertEquals(1, mockDueFlash.memory[10]);
+  assertEquals(0xFF, mockDueFlash.memory[VLCB::DUE_FLASH_PAGE_SIZE + 10]);
+  assertEquals(1, storage.read(10));
+  assertEquals(2, storage.read(VLCB::DUE_FLASH_PAGE_SIZE + 10));
+
+  storage.commitWriteEEPROM();
+  assertEquals(2, mockDueFlash.writeCount);
+  assertEquals(2, mockDueFlash.memory[VLCB::DUE_FLASH_PAGE_SIZE + 10]);
+}
+
+void testWriteSpanningPages()
+{
+  test();
+  mockDueFlash.reset(FLASH_SIZE);
+  VLCB::DueEepromEmulationStorage storage;
+
+  const byte data[] = {1, 2, 3, 4};
+  storage.writeBytes(VLCB::DUE_FLASH_PAGE_SIZE - 2, data, 4);
+  storage.commitWriteEEPROM();
+
+  assertEquals(2, mockDueFlash.writeCount);
+  assertEquals(1, mockDueFlash.memory[VLCB::DUE_FLASH_PAGE_SIZE - 2]);
+  assertEquals(4, mockDueFlash.memory[VLCB::DUE_FLASH_PAGE_SIZE + 1]);
+}
+
+}
+
+void testDueEepromEmulationStorage()
+{
+  testReadFromFlash();
+  testReadAfterWriteWithinPage();
+  testCommitWritesPageOnce();
+  testCrossPageWriteFlushesPage();
+  testWriteSpanningPages();
+}
@@ -195,6 +195,32 @@ void testEventHandlerMultipleEvents()
   assertEquals(2, capturedIndex[1]);
 }
 
+void testAcceptsOnlyStoredEvents()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+
+  configuration->writeEvent(0, 260, 1);
+  configuration->updateEvHashEntry(0);
+  configuration->writeEvent(1, 0, 2);
+  configuration->updateEvHashEntry(1);
+
+  VLCB::VlcbMessage stored = {5, {OPC_ACON, 0x01, 0x04, 0, 1}};
+  VLCB::VlcbMessage otherNode = {5, {OPC_ACON, 0x01, 0x05, 0, 1}};
+  VLCB::VlcbMessage storedShort = {5, {OPC_ASOF, 0x02, 0x07, 0, 2}};
+  VLCB::VlcbMessage notEvent = {3, {OPC_NVRD, 0x01, 0x04}};
+
+  // Nothing is consumed without an event handler.
+  assertEquals(false, eventConsumerService->acceptsMessage(&stored));
+
+  eventConsumerService->setEventHandler(eventHandler);
+  assertEquals(true, eventConsumerService->acceptsMessage(&stored));
+  assertEquals(false, eventConsumerService->acceptsMessage(&otherNode));
+  assertEquals(true, eventConsumerService->acceptsMessage(&storedShort));
+  assertEquals(false, eventConsumerService->acceptsMessage(&notEvent));
+}
+
 }
 
 void testEventConsumerService()
@@ -204,4 +230,5 @@ void testEventConsumerService()
   testEventHandlerOff();
   testEventHandlerShortOn();
   testEventHandlerMultipleEvents();
+  testAcceptsOnlyStoredEvents();
 }
@@ -0,0 +1,139 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+// Test cases for FileStorage.
+
+#include <memory>
+#include <cstdio>
+#include <unistd.h>
+#include "TestTools.hpp"
+#include "FileStorage.h"
+#include "Configuration.h"
+#include "VlcbCommon.h"
+
+namespace
+{
+
+std::string tempPath()
+{
+  char path[] = "/tmp/vlcbFileStorageXXXXXX";
+  int fd = mkstemp(path);
+  close(fd);
+  // Start from an empty file.
+  truncate(path, 0);
+  return path;
+}
+
+void testNewFileIsErased()
+{
+  test();
+  std::string path = tempPath();
+  FileStorage storage(path.c_str(), 1000);
+  storage.begin();
+
+  assertEquals(true, storage.isOpen());
+  assertEquals(0xFF, storage.read(0));
+  assertEquals(0xFF, storage.read(999));
+
+  remove(path.c_str());
+}
+
+void testPersistsAcrossRestart()
+{
+  test();
+  std::string path = tempPath();
+  {
+    FileStorage storage(path.c_str(), 1000);
+    storage.begin();
+    storage.write(5, 42);
+    byte data[] = {1, 2, 3};
+    storage.writeBytes(500, data, 3);
+    storage.commitWriteEEPROM();
+  }
+
+  FileStorage storage(path.c_str(), 1000);
+  storage.begin();
+  assertEquals(42, storage.read(5));
+  byte data[3];
+  assertEquals(3, storage.readBytes(500, 3, data));
+  assertEquals(1, data[0]);
+  assertEquals(3, data[2]);
+
+  remove(path.c_str());
+}
+
+void testFlushesOnlyDirtyPages()
+{
+  test();
+  std::string path = tempPath();
+  unsigned int pageSize = sysconf(_SC_PAGESIZE);
+  FileStorage storage(path.c_str(), 4 * pageSize);
+  storage.begin();
+  unsigned int flushes = storage.getFlushCount();
+  unsigned int pages = storage.getFlushedPageCount();
+
+  storage.commitWriteEEPROM();
+  assertEquals(flushes, storage.getFlushCount());
+
+  storage.write(0, 1);
+  storage.write(1, 2);
+  storage.write(2 * pageSize, 3);
+  storage.commitWriteEEPROM();
+  assertEquals(flushes + 1, storage.getFlushCount());
+  assertEquals(pages + 2, storage.getFlushedPageCount());
+
+  storage.commitWriteEEPROM();
+  assertEquals(flushes + 1, storage.getFlushCount());
+
+  remove(path.c_str());
+}
+
+void testReset()
+{
+  test();
+  std::string path = tempPath();
+  FileStorage storage(path.c_str(), 1000);
+  storage.begin();
+  storage.write(5, 42);
+
+  storage.reset();
+
+  assertEquals(0xFF, storage.read(5));
+
+  remove(path.c_str());
+}
+
+void testConfigurationSurvivesRestart()
+{
+  test();
+  std::string path = tempPath();
+  {
+    FileStorage storage(path.c_str(), 1000);
+    std::unique_ptr<VLCB::Configuration> config(createTestConfiguration(&storage));
+    config->setModuleNormalMode(0x0104);
+    config->writeEvent(3, 0x0102, 0x0304);
+    config->writeEventEV(3, 1, 42);
+    config->commitToEEPROM();
+  }
+
+  FileStorage storage(path.c_str(), 1000);
+  std::unique_ptr<VLCB::Configuration> config(createTestConfiguration(&storage));
+  assertEquals(0x0104, config->nodeNum);
+  assertEquals(3, config->findExistingEvent(0x0102, 0x0304));
+  assertEquals(42, config->getEventEVval(3, 1));
+
+  remove(path.c_str());
+}
+
+}
+
+void testFileStorage()
+{
+  testNewFileIsErased();
+  testPersistsAcrossRestart();
+  testFlushesOnlyDirtyPages();
+  testReset();
+  testConfigurationSurvivesRestart();
+}
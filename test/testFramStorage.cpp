@@ -0,0 +1,175 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+// Test cases for FramI2cStorage and FramSpiStorage using a mocked FRAM chip.
+
+#include "TestTools.hpp"
+#include "ArduinoMock.hpp"
+#include "FramI2cStorage.h"
+#include "FramSpiStorage.h"
+#include "MockFram.h"
+
+namespace
+{
+
+void testI2cWriteByteWithoutDelay()
+{
+  test();
+  clearArduinoValues();
+  mockFram.reset(32768, 2);
+  VLCB::FramI2cStorage storage(0x50, 32768);
+
+  storage.write(0x1234, 42);
+
+  assertEquals(0, millis());
+  assertEquals(1, mockFram.transactions.size());
+  assertEquals(0x50, mockFram.transactions[0].device);
+  assertEquals(3, mockFram.transactions[0].bytes.size());
+  assertEquals(0x12, mockFram.transactions[0].bytes[0]);
+  assertEquals(0x34, mockFram.transactions[0].bytes[1]);
+  assertEquals(42, mockFram.memory[0x1234]);
+
+  assertEquals(42, storage.read(0x1234));
+}
+
+void testI2cBurstWrite()
+{
+  test();
+  mockFram.reset(32768, 2);
+  VLCB::FramI2cStorage storage(0x50, 32768);
+
+  byte data[100];
+  for (byte i = 0; i < 100; ++i)
+  {
+    data[i] = i + 1;
+  }
+  storage.writeBytes(0x200, data, 100);
+
+  // 30 data bytes fit in the Wire buffer together with the address.
+  assertEquals(4, mockFram.transactions.size());
+  assertEquals(32, mockFram.transactions[0].bytes.size());
+  assertEquals(12, mockFram.transactions[3].bytes.size());
+  assertEquals(0x02, mockFram.transactions[1].bytes[0]);
+  assertEquals(0x1E, mockFram.transactions[1].bytes[1]);
+  assertEquals(1, mockFram.memory[0x200]);
+  assertEquals(100, mockFram.memory[0x263]);
+}
+
+void testI2cBurstRead()
+{
+  test();
+  mockFram.reset(32768, 2);
+  VLCB::FramI2cStorage storage(0x50, 32768);
+  for (int i = 0; i < 40; ++i)
+  {
+    mockFram.memory[0x300 + i] = i;
+  }
+
+  byte data[40];
+  assertEquals(40, storage.readBytes(0x300, 40, data));
+
+  // Set address and read 32 bytes, then set address and read 8 bytes.
+  assertEquals(4, mockFram.transactions.size());
+  assertEquals(true, mockFram.transactions[1].isRead);
+  assertEquals(32, mockFram.transactions[1].bytes.size());
+  assertEquals(8, mockFram.transactions[3].bytes.size());
+  assertEquals(0, data[0]);
+  assertEquals(39, data[39]);
+}
+
+void testI2cLargeChip()
+{
+  test();
+  mockFram.reset(131072, 2);
+  VLCB::FramI2cStorage storage(0x50, 131072);
+
+  // Spans the 64KB boundary. Upper address bit goes in the device address.
+  byte data[] = {1, 2, 3, 4};
+  storage.writeBytes(0xFFFE, data, 4);
+
+  assertEquals(2, mockFram.transactions.size());
+  assertEquals(0x50, mockFram.transactions[0].device);
+  assertEquals(0x51, mockFram.transactions[1].device);
+  assertEquals(0x00, mockFram.transactions[1].bytes[0]);
+  assertEquals(0x00, mockFram.transactions[1].bytes[1]);
+  assertEquals(2, mockFram.memory[0xFFFF]);
+  assertEquals(3, mockFram.memory[0x10000]);
+
+  byte readBack[4];
+  assertEquals(4, storage.readBytes(0xFFFE, 4, readBack));
+  assertEquals(1, readBack[0]);
+  assertEquals(4, readBack[3]);
+}
+
+void testI2cReset()
+{
+  test();
+  mockFram.reset(65536, 2);
+  VLCB::FramI2cStorage storage(0x50, 65536);
+
+  storage.reset();
+
+  assertEquals(0xFF, mockFram.memory[0]);
+  assertEquals(0xFF, mockFram.memory[4096]);
+  assertEquals(0xFF, mockFram.memory[65535]);
+  // 65536 / 30 bytes per burst
+  assertEquals(2185, mockFram.transactions.size());
+}
+
+void testSpiWriteAndRead()
+{
+  test();
+  mockFram.reset(32768, 2);
+  VLCB::FramSpiStorage storage(10, 32768);
+  storage.begin();
+
+  byte data[] = {5, 6, 7};
+  storage.writeBytes(0x1234, data, 3);
+
+  // Write enable followed by the write.
+  assertEquals(2, mockFram.transactions.size());
+  assertEquals(1, mockFram.transactions[0].bytes.size());
+  assertEquals(0x06, mockFram.transactions[0].bytes[0]);
+  assertEquals(6, mockFram.transactions[1].bytes.size());
+  assertEquals(0x02, mockFram.transactions[1].bytes[0]);
+  assertEquals(7, mockFram.memory[0x1236]);
+  assertEquals(HIGH, getDigitalWrite(10));
+
+  byte readBack[3];
+  assertEquals(3, storage.readBytes(0x1234, 3, readBack));
+  assertEquals(3, mockFram.transactions.size());
+  assertEquals(0x03, mockFram.transactions[2].bytes[0]);
+  assertEquals(5, readBack[0]);
+  assertEquals(7, readBack[2]);
+}
+
+void testSpiThreeAddressBytes()
+{
+  test();
+  mockFram.reset(262144, 3);
+  VLCB::FramSpiStorage storage(10, 262144, 3);
+
+  storage.write(0x3ABCD, 99);
+
+  assertEquals(5, mockFram.transactions[1].bytes.size());
+  assertEquals(0x03, mockFram.transactions[1].bytes[1]);
+  assertEquals(0xAB, mockFram.transactions[1].bytes[2]);
+  assertEquals(0xCD, mockFram.transactions[1].bytes[3]);
+  assertEquals(99, mockFram.memory[0x3ABCD]);
+  assertEquals(99, storage.read(0x3ABCD));
+}
+
+}
+
+void testFramStorage()
+{
+  testI2cWriteByteWithoutDelay();
+  testI2cBurstWrite();
+  testI2cBurstRead();
+  testI2cLargeChip();
+  testI2cReset();
+  testSpiWriteAndRead();
+  testSpiThreeAddressBytes();
+}
@@ -145,6 +145,33 @@ void testGridConnectDecode_DATA(const char * inputMessage, int expectedLEN, bool
   }
 }
 
+void testGridConnectEncode_Length(bool ext, int len, int expectedLength)
+{
+  test();
+  char msgBuffer[VLCB::GRIDCONNECT_MAX_LENGTH + 1];
+  VLCB::CanFrameHeader header = {ext ? 0x1FFFFFFFu : 0x7FFu, ext, false, (uint8_t)len};
+  uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+  byte length = VLCB::encodeGridConnect(msgBuffer, header, data);
+
+  assertEquals(expectedLength, length);
+  assertEquals(expectedLength, strlen(msgBuffer));
+}
+
+void testGridConnectDecode_Length(const char * inputMessage, int length, int expectedLEN, bool expectedResult)
+{
+  test();
+  VLCB::CANFrame frame;
+  bool result = VLCB::decodeGridConnect(inputMessage, length, &frame);
+
+  assertEquals(expectedResult, result);
+  if (result)
+  {
+    assertEquals(expectedLEN, frame.len);
+    assertEquals(0x1, frame.id);
+  }
+}
+
 void testGridConnect()
 {
   // test encoding standard ID - 11 bits, max id 0x7FF
@@ -233,4 +260,16 @@ void testGridConnect()
   testGridConnectDecode_DATA(":X00000000N000102030405FEFF09;", 9, false);   // extended msg, too many data bytes
   testGridConnectDecode_DATA(":X00000000NQ00102030405FEFF;", 8, false);     // extended msg, invalid char in data
   testGridConnectDecode_DATA(":X00000000N000102030405FEFQ;", 8, false);     // extended msg, invalid char in data
+
+  // test encoded length returned so that callers need not count the characters
+  testGridConnectEncode_Length(false, 0, 8);                                // ":SFFE0N;"
+  testGridConnectEncode_Length(false, 8, 24);
+  testGridConnectEncode_Length(true, 8, VLCB::GRIDCONNECT_MAX_LENGTH);
+  testGridConnectEncode_Length(false, 9, 0);                                // too many data bytes
+
+  // test decoding with a given length, the message need not be null terminated
+  testGridConnectDecode_Length(":S0020N0102;:S0040N;", 12, 2, true);        // first of two messages
+  testGridConnectDecode_Length(":S0020N0102;", 11, 2, false);               // end of frame character cut off
+  testGridConnectDecode_Length(":X00000001N;", 8, 0, false);                // too short for an extended ID
+  testGridConnectDecode_Length(":S0020N;", 7, 0, false);                    // shorter than any message
 }
\ No newline at end of file
@@ -0,0 +1,231 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+// Test cases for InstrumentedStorage.
+// Also pins the storage cost of key protocol operations so that
+// performance regressions are caught.
+
+#include <memory>
+#include "TestTools.hpp"
+#include "Controller.h"
+#include "MinimumNodeService.h"
+#include "EventConsumerService.h"
+#include "EventTeachingService.h"
+#include "InstrumentedStorage.h"
+#include "VlcbCommon.h"
+#include "MockStorage.h"
+#include "MockTransportService.h"
+
+namespace
+{
+std::unique_ptr<MockStorage> mockStorage;
+std::unique_ptr<VLCB::InstrumentedStorage> instrumentedStorage;
+std::unique_ptr<MockTransportService> mockTransportService;
+
+void createStorage(const VLCB::StorageLatencyModel *latency = nullptr)
+{
+  mockStorage.reset(new MockStorage);
+  instrumentedStorage.reset(new VLCB::InstrumentedStorage(mockStorage.get(), latency));
+}
+
+VLCB::Controller createController(VLCB::Service * eventService)
+{
+  static std::unique_ptr<VLCB::MinimumNodeService> minimumNodeService;
+  minimumNodeService.reset(new VLCB::MinimumNodeService);
+
+  mockTransportService.reset(new MockTransportService);
+
+  createStorage();
+  VLCB::Controller controller = ::createController(instrumentedStorage.get(), {minimumNodeService.get(), eventService, mockTransportService.get()});
+  controller.begin();
+
+  VLCB::Configuration * config = controller.getModuleConfig();
+  instrumentedStorage->setRegionBoundaries(config->EE_NVS_START, config->EE_EVENTS_START, config->EE_FREE_BASE);
+  return controller;
+}
+
+void fillEventTable(VLCB::Configuration * config)
+{
+  for (byte i = 0; i < config->getNumEvents(); ++i)
+  {
+    config->writeEvent(i, 0x0102, i + 1);
+    config->updateEvHashEntry(i);
+  }
+}
+
+void testForwardsToBackend()
+{
+  test();
+  createStorage();
+
+  instrumentedStorage->write(12, 42);
+  byte data[] = {1, 2, 3};
+  instrumentedStorage->writeBytes(30, data, 3);
+
+  assertEquals(42, mockStorage->read(12));
+  assertEquals(2, mockStorage->read(31));
+  assertEquals(42, instrumentedStorage->read(12));
+}
+
+void testCountsPerRegion()
+{
+  test();
+  createStorage();
+  instrumentedStorage->setRegionBoundaries(10, 20, 100);
+
+  instrumentedStorage->read(2);
+  instrumentedStorage->write(12, 1);
+  byte data[] = {1, 2, 3, 4};
+  instrumentedStorage->writeBytes(20, data, 4);
+  instrumentedStorage->readBytes(24, 2, data);
+  instrumentedStorage->write(100, 5);
+  instrumentedStorage->commitWriteEEPROM();
+
+  assertEquals(1, instrumentedStorage->getCounters(VLCB::STORAGE_REGION_HEADER).readCalls);
+  assertEquals(0, instrumentedStorage->getCounters(VLCB::STORAGE_REGION_HEADER).writeCalls);
+  assertEquals(1, instrumentedStorage->getCounters(VLCB::STORAGE_REGION_NVS).writeCalls);
+  assertEquals(1, instrumentedStorage->getCounters(VLCB::STORAGE_REGION_EVENTS).writeCalls);
+  assertEquals(4, instrumentedStorage->getCounters(VLCB::STORAGE_REGION_EVENTS).bytesWritten);
+  assertEquals(1, instrumentedStorage->getCounters(VLCB::STORAGE_REGION_EVENTS).readCalls);
+  assertEquals(2, instrumentedStorage->getCounters(VLCB::STORAGE_REGION_EVENTS).bytesRead);
+  assertEquals(1, instrumentedStorage->getCounters(VLCB::STORAGE_REGION_USER).writeCalls);
+
+  VLCB::StorageCounters totals = instrumentedStorage->getTotals();
+  assertEquals(2, totals.readCalls);
+  assertEquals(3, totals.writeCalls);
+  assertEquals(3, totals.bytesRead);
+  assertEquals(6, totals.bytesWritten);
+  assertEquals(1, instrumentedStorage->getCommitCalls());
+
+  instrumentedStorage->resetCounters();
+  assertEquals(0, instrumentedStorage->getTotals().writeCalls);
+  assertEquals(0, instrumentedStorage->getCommitCalls());
+}
+
+void testLatencyModel()
+{
+  test();
+  createStorage(&VLCB::LATENCY_INTERNAL_EEPROM);
+
+  byte data[] = {1, 2, 3, 4};
+  instrumentedStorage->writeBytes(20, data, 4);
+  assertEquals(4 * 3400, instrumentedStorage->getSimulatedMicros());
+
+  instrumentedStorage->resetCounters();
+  instrumentedStorage->setLatencyModel(&VLCB::LATENCY_I2C_EEPROM);
+  instrumentedStorage->writeBytes(20, data, 4);
+  instrumentedStorage->write(30, 1);
+  assertEquals(2 * 5270 + 5 * 90, instrumentedStorage->getSimulatedMicros());
+
+  instrumentedStorage->resetCounters();
+  instrumentedStorage->setLatencyModel(&VLCB::LATENCY_FLASH);
+  instrumentedStorage->write(30, 1);
+  instrumentedStorage->commitWriteEEPROM();
+  assertEquals(20001, instrumentedStorage->getSimulatedMicros());
+}
+
+void testAconLookupCostOnFullTable()
+{
+  test();
+  static std::unique_ptr<VLCB::EventConsumerService> eventConsumerService;
+  eventConsumerService.reset(new VLCB::EventConsumerService);
+  eventConsumerService->setEventHandler([](byte /*index*/, const VLCB::VlcbMessage * /*msg*/) {});
+  VLCB::Controller controller = createController(eventConsumerService.get());
+  fillEventTable(controller.getModuleConfig());
+  instrumentedStorage->resetCounters();
+
+  VLCB::VlcbMessage msg = {5, {OPC_ACON, 0x01, 0x02, 0x00, 0x0A}};
+  mockTransportService->setNextMessage(msg);
+  process(controller);
+
+  // Only the slot with a matching hash is read from storage.
+  VLCB::StorageCounters events = instrumentedStorage->getCounters(VLCB::STORAGE_REGION_EVENTS);
+  assertEquals(4, events.readCalls);
+  assertEquals(4, events.bytesRead);
+  assertEquals(0, instrumentedStorage->getTotals().writeCalls);
+}
+
+void testUnknownAconCostOnFullTable()
+{
+  test();
+  static std::unique_ptr<VLCB::EventConsumerService> eventConsumerService;
+  eventConsumerService.reset(new VLCB::EventConsumerService);
+  eventConsumerService->setEventHandler([](byte /*index*/, const VLCB::VlcbMessage * /*msg*/) {});
+  VLCB::Controller controller = createController(eventConsumerService.get());
+  fillEventTable(controller.getModuleConfig());
+  instrumentedStorage->resetCounters();
+
+  // Event number 100 does not share a hash with any stored event.
+  VLCB::VlcbMessage msg = {5, {OPC_ACON, 0x01, 0x02, 0x00, 0x64}};
+  mockTransportService->setNextMessage(msg);
+  process(controller);
+
+  VLCB::StorageCounters totals = instrumentedStorage->getTotals();
+  assertEquals(0, totals.readCalls);
+  assertEquals(0, totals.writeCalls);
+}
+
+void testEvlrnNewEventCost()
+{
+  test();
+  static std::unique_ptr<VLCB::EventTeachingService> eventTeachingService;
+  eventTeachingService.reset(new VLCB::EventTeachingService);
+  VLCB::Controller controller = createController(eventTeachingService.get());
+  eventTeachingService->enableLearn();
+  instrumentedStorage->resetCounters();
+
+  VLCB::VlcbMessage msg = {7, {OPC_EVLRN, 0x05, 0x06, 0x00, 0x07, 1, 42}};
+  mockTransportService->setNextMessage(msg);
+  process(controller);
+
+  assertEquals(2, mockTransportService->sent_messages.size());
+  assertEquals(OPC_WRACK, mockTransportService->sent_messages[0].data[0]);
+
+  // One block write of the event key and one write for the EV.
+  VLCB::StorageCounters events = instrumentedStorage->getCounters(VLCB::STORAGE_REGION_EVENTS);
+  assertEquals(2, events.writeCalls);
+  assertEquals(5, events.bytesWritten);
+  // Read back of the event key to update the hash table.
+  assertEquals(4, events.readCalls);
+  assertEquals(0, instrumentedStorage->getCounters(VLCB::STORAGE_REGION_HEADER).writeCalls);
+  assertEquals(0, instrumentedStorage->getCounters(VLCB::STORAGE_REGION_NVS).writeCalls);
+}
+
+void testEvlrnExistingEventCost()
+{
+  test();
+  static std::unique_ptr<VLCB::EventTeachingService> eventTeachingService;
+  eventTeachingService.reset(new VLCB::EventTeachingService);
+  VLCB::Controller controller = createController(eventTeachingService.get());
+  fillEventTable(controller.getModuleConfig());
+  eventTeachingService->enableLearn();
+  instrumentedStorage->resetCounters();
+
+  VLCB::VlcbMessage msg = {7, {OPC_EVLRN, 0x01, 0x02, 0x00, 0x0A, 2, 42}};
+  mockTransportService->setNextMessage(msg);
+  process(controller);
+
+  assertEquals(2, mockTransportService->sent_messages.size());
+  assertEquals(OPC_WRACK, mockTransportService->sent_messages[0].data[0]);
+
+  // Lookup of the existing event and a single EV write.
+  VLCB::StorageCounters events = instrumentedStorage->getCounters(VLCB::STORAGE_REGION_EVENTS);
+  assertEquals(4, events.readCalls);
+  assertEquals(1, events.writeCalls);
+  assertEquals(1, events.bytesWritten);
+}
+
+}
+
+void testInstrumentedStorage()
+{
+  testForwardsToBackend();
+  testCountsPerRegion();
+  testLatencyModel();
+  testAconLookupCostOnFullTable();
+  testUnknownAconCostOnFullTable();
+  testEvlrnNewEventCost();
+  testEvlrnExistingEventCost();
+}
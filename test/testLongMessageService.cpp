@@ -6,17 +6,23 @@
 // Test cases for LongMessageService.
 
 #include <memory>
+#include <string>
 #include "TestTools.hpp"
+#include "ArduinoMock.hpp"
 #include "Controller.h"
 #include "MinimumNodeService.h"
 #include "LongMessageService.h"
 #include "Parameters.h"
 #include "VlcbCommon.h"
 #include "MockTransportService.h"
+#include "MockCanTransport.h"
+#include "Crc.h"
+#include "MockStorage.h"
 
 namespace
 {
 static std::unique_ptr<MockTransportService> mockTransportService;
+static std::unique_ptr<VLCB::LongMessageService> longMessageService;
 
 VLCB::Controller createController()
 {
@@ -25,7 +31,6 @@ VLCB::Controller createController()
 
   mockTransportService.reset(new MockTransportService);
 
-  static std::unique_ptr<VLCB::LongMessageService> longMessageService;
   longMessageService.reset(new VLCB::LongMessageService);
 
   VLCB::Controller controller = ::createController({minimumNodeService.get(), longMessageService.get(), mockTransportService.get()});
@@ -34,6 +39,46 @@ VLCB::Controller createController()
   return controller;
 }
 
+static std::unique_ptr<VLCB::LongMessageServiceEx> longMessageServiceEx;
+
+VLCB::Controller createExController()
+{
+  static std::unique_ptr<VLCB::MinimumNodeService> minimumNodeService;
+  minimumNodeService.reset(new VLCB::MinimumNodeService);
+
+  mockTransportService.reset(new MockTransportService);
+
+  longMessageServiceEx.reset(new VLCB::LongMessageServiceEx);
+
+  VLCB::Controller controller = ::createController({minimumNodeService.get(), longMessageServiceEx.get(), mockTransportService.get()});
+  controller.begin();
+
+  return controller;
+}
+
+// Run the long message service until it has sent all fragments.
+// Returns the payload of the sent data fragments.
+std::string sendAllFragments(VLCB::Controller &controller)
+{
+  process(controller);
+  for (int i = 0 ; longMessageServiceEx->is_sending() && i < 100 ; ++i)
+  {
+    addMillis(VLCB::LONG_MESSAGE_DEFAULT_DELAY);
+    longMessageServiceEx->process();
+    process(controller);
+  }
+
+  std::string payload;
+  for (auto & msg : mockTransportService->sent_messages)
+  {
+    if (msg.data[0] == OPC_DTXC && msg.data[2] != 0)
+    {
+      payload.append((const char *) &msg.data[3], 5);
+    }
+  }
+  return payload;
+}
+
 void testServiceDiscovery()
 {
   test();
@@ -81,10 +126,499 @@ void testServiceDiscoveryEventProdSvc()
   // Not testing service data bytes.
 }
 
+void testExSendFromPool()
+{
+  test();
+
+  VLCB::Controller controller = createExController();
+  assertEquals(true, longMessageServiceEx->allocateContexts(2, 16, 2, 16));
+
+  char message[] = "Hello\0world";
+  assertEquals(VLCB::LONG_MESSAGE_SEND_OK, longMessageServiceEx->queueLongMessage(message, 11, 3));
+  // The message has been copied so the caller may reuse its buffer.
+  memset(message, 'x', sizeof(message));
+
+  std::string payload = sendAllFragments(controller);
+
+  assertEquals(0, longMessageServiceEx->is_sending());
+  assertEquals(4, mockTransportService->sent_messages.size());
+  VLCB::VlcbMessage header = mockTransportService->sent_messages[0];
+  assertEquals(OPC_DTXC, header.data[0]);
+  assertEquals(3, header.data[1]); // stream ID
+  assertEquals(0, header.data[2]); // sequence number
+  assertEquals(11, header.data[4]); // message length
+  // The embedded null byte is sent too.
+  assertEquals(0, memcmp("Hello\0world", payload.data(), 11));
+}
+
+void testExSendStatusCodes()
+{
+  test();
+
+  VLCB::Controller controller = createExController();
+  const char message[] = "Long message";
+
+  assertEquals(VLCB::LONG_MESSAGE_SEND_NOT_ALLOCATED, longMessageServiceEx->queueLongMessage(message, 4, 1));
+  assertEquals(false, longMessageServiceEx->sendLongMessage(message, 4, 1));
+
+  assertEquals(true, longMessageServiceEx->allocateContexts(1, 16, 1, 8));
+  assertEquals(VLCB::LONG_MESSAGE_SEND_OK, longMessageServiceEx->queueLongMessage(message, 8, 1));
+  assertEquals(VLCB::LONG_MESSAGE_SEND_STREAM_BUSY, longMessageServiceEx->queueLongMessage(message, 8, 1));
+  assertEquals(VLCB::LONG_MESSAGE_SEND_NO_CONTEXT, longMessageServiceEx->queueLongMessage(message, 8, 2));
+
+  sendAllFragments(controller);
+  assertEquals(VLCB::LONG_MESSAGE_SEND_OK, longMessageServiceEx->queueLongMessage(message, 8, 2));
+}
+
+void testExSendCopiesLongMessageToHeap()
+{
+  test();
+
+  VLCB::Controller controller = createExController();
+  assertEquals(true, longMessageServiceEx->allocateContexts(1, 16, 1, 8));
+  char message[] = "A message longer than the send buffer";
+
+  assertEquals(VLCB::LONG_MESSAGE_SEND_OK, longMessageServiceEx->queueLongMessage(message, sizeof(message), 1));
+  // The caller may reuse its buffer straight away.
+  memset(message, 'x', sizeof(message) - 1);
+
+  std::string payload = sendAllFragments(controller);
+
+  assertEquals("A message longer than the send buffer", payload.c_str());
+  assertEquals(0, longMessageServiceEx->is_sending());
+}
+
+byte completedStreamId;
+const void * completedMessage;
+
+void testExSendFromCallerBuffer()
+{
+  test();
+
+  VLCB::Controller controller = createExController();
+  // No send buffers in the pool, messages are sent from the caller's buffer.
+  assertEquals(true, longMessageServiceEx->allocateContexts(1, 16, 1, 0));
+  const char message[] = "A message longer than any send buffer";
+  completedStreamId = 0;
+  completedMessage = nullptr;
+
+  assertEquals(VLCB::LONG_MESSAGE_SEND_OK, longMessageServiceEx->queueLongMessage(message, sizeof(message), 7,
+    [](const void * msg, byte streamId) { completedMessage = msg; completedStreamId = streamId; }));
+  assertEquals(true, completedMessage == nullptr);
+
+  std::string payload = sendAllFragments(controller);
+
+  assertEquals(7, completedStreamId);
+  assertEquals(true, completedMessage == message);
+  assertEquals(message, payload.c_str());
+}
+
+void testExReportsBytesPerSecond()
+{
+  test();
+
+  VLCB::Controller controller = createExController();
+  assertEquals(true, longMessageServiceEx->allocateContexts());
+  const char message[] = "Twenty bytes message";
+
+  assertEquals(VLCB::LONG_MESSAGE_SEND_OK, longMessageServiceEx->queueLongMessage(message, 20, 5));
+  addMillis(VLCB::LONG_MESSAGE_DEFAULT_DELAY);
+  longMessageServiceEx->process();
+  // 5 bytes sent in 20ms.
+  assertEquals(250, longMessageServiceEx->getBytesPerSecond(5));
+
+  sendAllFragments(controller);
+
+  // 4 fragments sent 20ms apart after the header.
+  assertEquals(250, longMessageServiceEx->getBytesPerSecond(5));
+  assertEquals(0, longMessageServiceEx->getBytesPerSecond(6));
+}
+
+void testExAdaptivePacingOnQuietBus()
+{
+  test();
+
+  VLCB::Controller controller = createExController();
+  MockCanTransport transport;
+  transport.transmitSize = 32;
+  longMessageServiceEx->setAdaptivePacing(&transport);
+  assertEquals(true, longMessageServiceEx->allocateContexts());
+  const char message[] = "A message of forty bytes to send quickly";
+
+  assertEquals(VLCB::LONG_MESSAGE_SEND_OK, longMessageServiceEx->queueLongMessage(message, 40, 1));
+  process(controller);
+  mockTransportService->clearMessages();
+
+  // Without waiting, a burst of fragments is sent per call.
+  longMessageServiceEx->process();
+  process(controller);
+  assertEquals(VLCB::LONG_MESSAGE_MAX_BURST, mockTransportService->sent_messages.size());
+
+  longMessageServiceEx->process();
+  process(controller);
+  assertEquals(8, mockTransportService->sent_messages.size());
+  assertEquals(0, longMessageServiceEx->is_sending());
+}
+
+void testExAdaptivePacingBacksOff()
+{
+  test();
+
+  VLCB::Controller controller = createExController();
+  MockCanTransport transport;
+  transport.transmitSize = 32;
+  transport.transmitUsage = 16;
+  longMessageServiceEx->setAdaptivePacing(&transport, 2);
+  assertEquals(true, longMessageServiceEx->allocateContexts());
+  const char message[] = "A message of forty bytes to send quickly";
+
+  assertEquals(VLCB::LONG_MESSAGE_SEND_OK, longMessageServiceEx->queueLongMessage(message, 40, 1));
+  process(controller);
+  mockTransportService->clearMessages();
+
+  // Half full buffer: one fragment at a time, 2ms + 25ms apart.
+  addMillis(26);
+  longMessageServiceEx->process();
+  process(controller);
+  assertEquals(0, mockTransportService->sent_messages.size());
+  addMillis(1);
+  longMessageServiceEx->process();
+  longMessageServiceEx->process();
+  process(controller);
+  assertEquals(1, mockTransportService->sent_messages.size());
+
+  // Nearly full buffer: hold back.
+  transport.transmitUsage = 24;
+  addMillis(1000);
+  longMessageServiceEx->process();
+  process(controller);
+  assertEquals(1, mockTransportService->sent_messages.size());
+
+  // Quiet again: the minimum delay still applies.
+  transport.transmitUsage = 0;
+  longMessageServiceEx->process();
+  process(controller);
+  assertEquals(2, mockTransportService->sent_messages.size());
+}
+
+byte receivedStatus;
+std::string receivedMessage;
+
+void receiveHandler(void *msg, unsigned int msg_len, byte /*stream_id*/, byte status)
+{
+  receivedMessage.assign((const char *) msg, msg_len);
+  receivedStatus = status;
+}
+
+// Send a message with a CRC and feed the sent fragments back in.
+// Corrupt one byte of the first data fragment if asked to.
+void loopBackWithCrc(bool receiverChecksCrc, bool corrupt)
+{
+  VLCB::Controller controller = createExController();
+  byte streams[] = {3};
+  longMessageServiceEx->subscribe(streams, 1, receiveHandler);
+  assertEquals(true, longMessageServiceEx->allocateContexts());
+  longMessageServiceEx->use_crc(true);
+  receivedStatus = 0xFF;
+  receivedMessage.clear();
+
+  const char message[] = "Checked by a CRC";
+  assertEquals(VLCB::LONG_MESSAGE_SEND_OK, longMessageServiceEx->queueLongMessage(message, 16, 3));
+  sendAllFragments(controller);
+  // CRC-16 of the message in the header.
+  assertEquals(VLCB::crc16((const uint8_t *) message, 16),
+               (mockTransportService->sent_messages[0].data[5] << 8) + mockTransportService->sent_messages[0].data[6]);
+
+  std::vector<VLCB::VlcbMessage> fragments = mockTransportService->sent_messages;
+  if (corrupt)
+  {
+    fragments[1].data[4] ^= 0x01;
+  }
+  longMessageServiceEx->use_crc(receiverChecksCrc);
+  for (auto & fragment : fragments)
+  {
+    mockTransportService->setNextMessage(fragment);
+  }
+  process(controller);
+}
+
+void testExReceiveChecksCrc()
+{
+  test();
+
+  loopBackWithCrc(true, false);
+  assertEquals(VLCB::LONG_MESSAGE_COMPLETE, receivedStatus);
+  assertEquals("Checked by a CRC", receivedMessage.c_str());
+
+  loopBackWithCrc(true, true);
+  assertEquals(VLCB::LONG_MESSAGE_CRC_ERROR, receivedStatus);
+
+  // A receiver that does not check CRCs accepts the message.
+  loopBackWithCrc(false, true);
+  assertEquals(VLCB::LONG_MESSAGE_COMPLETE, receivedStatus);
+}
+
+struct CountingProducer : public VLCB::StorageLongMessageProducer
+{
+  CountingProducer(VLCB::Storage *storage, unsigned int address, unsigned int length)
+    : StorageLongMessageProducer(storage, address, length) {}
+
+  virtual void read(unsigned int offset, byte *data, byte count) override
+  {
+    ++reads;
+    largestRead = count > largestRead ? count : largestRead;
+    StorageLongMessageProducer::read(offset, data, count);
+  }
+  virtual void completed(byte stream_id) override { completedStreamId = stream_id; }
+
+  int reads = 0;
+  byte largestRead = 0;
+  byte completedStreamId = 0;
+};
+
+void testExSendFromProducer()
+{
+  test();
+
+  VLCB::Controller controller = createExController();
+  byte streams[] = {4};
+  longMessageServiceEx->subscribe(streams, 1, receiveHandler);
+  // No send buffers and a message longer than the default buffer length.
+  assertEquals(true, longMessageServiceEx->allocateContexts(1, 128, 1, 0));
+  longMessageServiceEx->use_crc(true);
+  receivedStatus = 0xFF;
+
+  MockStorage storage;
+  std::string message;
+  for (int i = 0; i < 100; ++i)
+  {
+    message += (char) ('A' + i % 26);
+  }
+  storage.writeBytes(200, (const byte *) message.data(), 100);
+  CountingProducer producer(&storage, 200, 100);
+
+  assertEquals(VLCB::LONG_MESSAGE_SEND_OK, longMessageServiceEx->queueLongMessage(&producer, 4));
+  // The CRC is calculated by reading the message a fragment at a time.
+  assertEquals(20, producer.reads);
+  assertEquals(0, producer.completedStreamId);
+
+  sendAllFragments(controller);
+  assertEquals(40, producer.reads);
+  assertEquals(5, producer.largestRead);
+  assertEquals(4, producer.completedStreamId);
+  assertEquals(100, mockTransportService->sent_messages[0].data[4]); // message length
+  assertEquals(VLCB::crc16((const byte *) message.data(), 100),
+               (mockTransportService->sent_messages[0].data[5] << 8) + mockTransportService->sent_messages[0].data[6]);
+
+  std::vector<VLCB::VlcbMessage> fragments = mockTransportService->sent_messages;
+  for (auto & fragment : fragments)
+  {
+    mockTransportService->setNextMessage(fragment);
+  }
+  for (int i = 0; i < 5; ++i)
+  {
+    process(controller);
+  }
+  assertEquals(VLCB::LONG_MESSAGE_COMPLETE, receivedStatus);
+  assertEquals(message.c_str(), receivedMessage.c_str());
+}
+
+void testSendFromProducer()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  MockStorage storage;
+  storage.writeBytes(10, (const byte *) "Stored message", 14);
+  CountingProducer producer(&storage, 10, 14);
+
+  assertEquals(true, longMessageService->sendLongMessage(&producer, 2));
+  for (int i = 0; i < 5; ++i)
+  {
+    addMillis(VLCB::LONG_MESSAGE_DEFAULT_DELAY);
+    longMessageService->process();
+    process(controller);
+  }
+
+  assertEquals(false, longMessageService->is_sending());
+  assertEquals(3, producer.reads);
+  assertEquals(2, producer.completedStreamId);
+  assertEquals(4, mockTransportService->sent_messages.size());
+  assertEquals(14, mockTransportService->sent_messages[0].data[4]);
+  assertEquals('S', mockTransportService->sent_messages[1].data[3]);
+  assertEquals('e', mockTransportService->sent_messages[3].data[6]);
+  assertEquals(0, mockTransportService->sent_messages[3].data[7]);
+}
+
+struct RecordingSink : public VLCB::LongMessageSink
+{
+  virtual void begin(byte /*stream_id*/, unsigned int length) override
+  {
+    data.clear();
+    messageLength = length;
+  }
+  virtual bool write(unsigned int offset, const byte *fragment, byte count) override
+  {
+    inOrder = inOrder && offset == data.size();
+    data.append((const char *) fragment, count);
+    return true;
+  }
+  virtual void end(byte stream_id, byte status) override
+  {
+    endedStreamId = stream_id;
+    endStatus = status;
+  }
+
+  std::string data;
+  unsigned int messageLength = 0;
+  bool inOrder = true;
+  byte endedStreamId = 0;
+  byte endStatus = 0xFF;
+};
+
+// Feed all sent fragments back into the long message service.
+void loopBack(VLCB::Controller &controller)
+{
+  std::vector<VLCB::VlcbMessage> fragments = mockTransportService->sent_messages;
+  for (auto & fragment : fragments)
+  {
+    mockTransportService->setNextMessage(fragment);
+  }
+  for (int i = 0; i < 5; ++i)
+  {
+    process(controller);
+  }
+}
+
+void testExReceiveIntoSinks()
+{
+  test();
+
+  VLCB::Controller controller = createExController();
+  // No receive buffers, all data goes to the sinks.
+  assertEquals(true, longMessageServiceEx->allocateContexts(2, 0, 2, 0));
+  longMessageServiceEx->use_crc(true);
+  RecordingSink sink5, sink6;
+  assertEquals(true, longMessageServiceEx->subscribe(5, &sink5));
+  assertEquals(true, longMessageServiceEx->subscribe(6, &sink6));
+
+  std::string message5(100, 'x');
+  std::string message6 = "A shorter message";
+  assertEquals(VLCB::LONG_MESSAGE_SEND_OK, longMessageServiceEx->queueLongMessage(message5.data(), 100, 5, [](const void *, byte) {}));
+  assertEquals(VLCB::LONG_MESSAGE_SEND_OK, longMessageServiceEx->queueLongMessage(message6.data(), message6.size(), 6, [](const void *, byte) {}));
+  sendAllFragments(controller);
+  loopBack(controller);
+
+  // Both streams are received at the same time, each into its own sink.
+  assertEquals(100, sink5.messageLength);
+  assertEquals(message5.c_str(), sink5.data.c_str());
+  assertEquals(true, sink5.inOrder);
+  assertEquals(5, sink5.endedStreamId);
+  assertEquals(VLCB::LONG_MESSAGE_COMPLETE, sink5.endStatus);
+  assertEquals(message6.c_str(), sink6.data.c_str());
+  assertEquals(VLCB::LONG_MESSAGE_COMPLETE, sink6.endStatus);
+}
+
+void testExSinkSubscriptions()
+{
+  test();
+
+  VLCB::Controller controller = createExController();
+  assertEquals(true, longMessageServiceEx->allocateContexts());
+  RecordingSink sink;
+  VLCB::VlcbMessage header = {8, {OPC_DTXC, 1, 0, 0, 10, 0, 0, 0}};
+  VLCB::VlcbMessage fragment = {8, {OPC_DTXC, 1, 1, 'a', 'b', 'c', 'd', 'e'}};
+
+  assertEquals(false, longMessageServiceEx->acceptsMessage(&header));
+  for (byte id = 1; id <= VLCB::NUM_EX_SINKS; ++id)
+  {
+    assertEquals(true, longMessageServiceEx->subscribe(id, &sink));
+  }
+  assertEquals(false, longMessageServiceEx->subscribe(VLCB::NUM_EX_SINKS + 1, &sink));
+
+  // Continuation fragments are only accepted while their message is received.
+  assertEquals(true, longMessageServiceEx->acceptsMessage(&header));
+  assertEquals(false, longMessageServiceEx->acceptsMessage(&fragment));
+  longMessageServiceEx->processReceivedMessageFragment(&header);
+  assertEquals(true, longMessageServiceEx->acceptsMessage(&fragment));
+
+  // Unsubscribing frees the slot for another stream.
+  assertEquals(true, longMessageServiceEx->subscribe(2, nullptr));
+  assertEquals(true, longMessageServiceEx->subscribe(VLCB::NUM_EX_SINKS + 1, &sink));
+}
+
+struct SmallBufferSink : public VLCB::BufferLongMessageSink
+{
+  SmallBufferSink() : BufferLongMessageSink(buffer, sizeof(buffer)) {}
+  virtual void end(byte /*stream_id*/, byte status) override { endStatus = status; }
+
+  byte buffer[10];
+  byte endStatus = 0xFF;
+};
+
+void testExBufferSinkTruncates()
+{
+  test();
+
+  VLCB::Controller controller = createExController();
+  assertEquals(true, longMessageServiceEx->allocateContexts());
+  SmallBufferSink sink;
+  longMessageServiceEx->subscribe(1, &sink);
+
+  VLCB::VlcbMessage header = {8, {OPC_DTXC, 1, 0, 0, 12, 0, 0, 0}};
+  VLCB::VlcbMessage fragment1 = {8, {OPC_DTXC, 1, 1, 'a', 'b', 'c', 'd', 'e'}};
+  VLCB::VlcbMessage fragment2 = {8, {OPC_DTXC, 1, 2, 'f', 'g', 'h', 'i', 'j'}};
+  VLCB::VlcbMessage fragment3 = {8, {OPC_DTXC, 1, 3, 'k', 'l', 0, 0, 0}};
+  longMessageServiceEx->processReceivedMessageFragment(&header);
+  longMessageServiceEx->processReceivedMessageFragment(&fragment1);
+  longMessageServiceEx->processReceivedMessageFragment(&fragment2);
+  assertEquals(0xFF, sink.endStatus);
+  assertEquals(10, sink.getLength());
+
+  longMessageServiceEx->processReceivedMessageFragment(&fragment3);
+  assertEquals(VLCB::LONG_MESSAGE_TRUNCATED, sink.endStatus);
+  assertEquals(0, memcmp("abcdefghij", sink.buffer, 10));
+  assertEquals(false, longMessageServiceEx->acceptsMessage(&fragment3));
+}
+
+void testAdaptivePacingSingleStream()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  MockCanTransport transport;
+  transport.transmitSize = 32;
+  longMessageService->setAdaptivePacing(&transport);
+  const char message[] = "Fifteen bytes..";
+
+  assertEquals(true, longMessageService->sendLongMessage(message, 15, 1));
+  longMessageService->process();
+  process(controller);
+
+  // Header and all 3 fragments sent at once.
+  assertEquals(4, mockTransportService->sent_messages.size());
+  assertEquals(false, longMessageService->is_sending());
+  assertEquals(15000, longMessageService->getBytesPerSecond(1));
+}
+
 }
 
 void testLongMessageService()
 {
   testServiceDiscovery();
   testServiceDiscoveryEventProdSvc();
+  testExSendFromPool();
+  testExSendStatusCodes();
+  testExSendCopiesLongMessageToHeap();
+  testExSendFromCallerBuffer();
+  testExReportsBytesPerSecond();
+  testExAdaptivePacingOnQuietBus();
+  testExAdaptivePacingBacksOff();
+  testAdaptivePacingSingleStream();
+  testExReceiveChecksCrc();
+  testExSendFromProducer();
+  testSendFromProducer();
+  testExReceiveIntoSinks();
+  testExSinkSubscriptions();
+  testExBufferSinkTruncates();
 }
@@ -313,6 +313,31 @@ void testQueryNodeNumber()
   assertEquals(PF_CONSUMER | PF_PRODUCER | PF_NORMAL | PF_VLCB, mockTransportService->sent_messages[0].data[5]);
 }
 
+void testQueryNodeNumberWithResponseWindow()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  controller.getModuleConfig()->setCANID(64);
+  minimumNodeService->setQnnResponseWindow(200);
+
+  VLCB::VlcbMessage msg_rqsd = {1, {OPC_QNN}};
+  mockTransportService->setNextMessage(msg_rqsd);
+
+  process(controller);
+  assertEquals(0, mockTransportService->sent_messages.size());
+
+  // CANID 64 replies half way through the window.
+  addMillis(99);
+  process(controller);
+  assertEquals(0, mockTransportService->sent_messages.size());
+
+  addMillis(1);
+  process(controller);
+  assertEquals(1, mockTransportService->sent_messages.size());
+  assertEquals(OPC_PNN, mockTransportService->sent_messages[0].data[0]);
+}
+
 void testReadNodeParametersNormalMode()
 {
   test();
@@ -508,6 +533,33 @@ void testHeartBeat()
   assertEquals(OPC_HEARTB, mockTransportService->sent_messages[0].data[0]);
 }
 
+void testSpreadHeartBeat()
+{
+  test();
+
+  VLCB::Controller controller = createController();
+  controller.getModuleConfig()->setCANID(32);
+  minimumNodeService->setHeartBeat(true);
+  minimumNodeService->setSpreadHeartbeat(true);
+  minimumNodeService->begin();
+  minimumNodeService->setHeartBeat(true);
+
+  // CANID 32 sends its first heartbeat a quarter of the heart rate early.
+  addMillis(3700);
+  process(controller);
+  assertEquals(0, mockTransportService->sent_messages.size());
+
+  addMillis(100);
+  process(controller);
+  assertEquals(1, mockTransportService->sent_messages.size());
+  assertEquals(OPC_HEARTB, mockTransportService->sent_messages[0].data[0]);
+
+  // Then at the normal heart rate.
+  addMillis(5001);
+  process(controller);
+  assertEquals(2, mockTransportService->sent_messages.size());
+}
+
 void testServiceDiscovery()
 {
   test();
@@ -1126,6 +1178,7 @@ void testMinimumNodeService()
   testSetNodeNumberNormal();
   testSetNodeNumberShort();
   testQueryNodeNumber();
+  testQueryNodeNumberWithResponseWindow();
   testReadNodeParametersNormalMode();
   testReadNodeParametersSetupMode();
   testReadNodeParameterCount();
@@ -1136,6 +1189,7 @@ void testMinimumNodeService()
   testModuleNameLearn();
   testModuleNameNormal();
   testHeartBeat();
+  testSpreadHeartBeat();
   testServiceDiscovery();
   testServiceDiscoveryLongMessageSvc();
   testServiceDiscoveryIndexOutOfBand();
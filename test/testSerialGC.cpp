@@ -0,0 +1,291 @@
+//  Copyright (C) Sven Rosvall (sven@rosvall.ie)
+//  This file is part of VLCB-Arduino project on https://github.com/SvenRosvall/VLCB-Arduino
+//  Licensed under the Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+//  The full licence can be found at: http://creativecommons.org/licenses/by-nc-sa/4.0
+
+// Test cases for SerialGC using a mocked serial port.
+
+#include "TestTools.hpp"
+#include "ArduinoMock.hpp"
+#include "SerialGC.h"
+
+namespace
+{
+
+void testReceiveAllAvailableFrames()
+{
+  test();
+  VLCB::SerialGC serialGC;
+
+  setSerialInput(":S0020N9001020005;:SB020N0D;:X00000001R;");
+
+  assertEquals(true, serialGC.available());
+  // All frames are decoded in a single call.
+  assertEquals(3, serialGC.receiveBufferUsage());
+  assertEquals(3, serialGC.receiveCounter());
+
+  VLCB::CANFrame frame = serialGC.getNextCanFrame();
+  assertEquals(0x1, frame.id);
+  assertEquals(5, frame.len);
+  assertEquals(0x90, frame.data[0]);
+  assertEquals(0x05, frame.data[4]);
+
+  uint8_t data[8];
+  VLCB::CanFrameHeader header = serialGC.receiveCanFrame(data);
+  assertEquals(0x581, header.id);
+  assertEquals(1, header.len);
+  assertEquals(0x0D, data[0]);
+
+  frame = serialGC.getNextCanFrame();
+  assertEquals(true, frame.ext);
+  assertEquals(true, frame.rtr);
+
+  assertEquals(false, serialGC.available());
+  assertEquals(0, serialGC.receiveBufferUsage());
+  assertEquals(3, serialGC.receiveBufferPeak());
+}
+
+void testFrameSplitOverCalls()
+{
+  test();
+  VLCB::SerialGC serialGC;
+
+  setSerialInput(":S0020N90");
+  assertEquals(false, serialGC.available());
+
+  setSerialInput("01020005;");
+  assertEquals(true, serialGC.available());
+  assertEquals(0x90, serialGC.getNextCanFrame().data[0]);
+}
+
+void testResynchroniseOnStartCharacter()
+{
+  test();
+  VLCB::SerialGC serialGC;
+
+  // Noise before the first message, a broken message and a lower case message.
+  setSerialInput("xx;:S0020N90:S0040N0d;");
+
+  assertEquals(true, serialGC.available());
+  VLCB::CANFrame frame = serialGC.getNextCanFrame();
+  assertEquals(0x2, frame.id);
+  assertEquals(0x0D, frame.data[0]);
+  assertEquals(false, serialGC.available());
+  assertEquals(0, serialGC.receiveErrorCounter());
+}
+
+void testInvalidAndOverlongMessages()
+{
+  test();
+  VLCB::SerialGC serialGC;
+
+  setSerialInput(":S0020Q;:S0020N000102030405060708090A;:S0020N01;");
+
+  assertEquals(true, serialGC.available());
+  assertEquals(1, serialGC.receiveBufferUsage());
+  // Both the invalid and the over-long message are errors. No data was lost for lack of buffer space.
+  assertEquals(2, serialGC.receiveErrorCounter());
+  assertEquals(0, serialGC.receiveOverrunCounter());
+  assertEquals(1, serialGC.getNextCanFrame().data[0]);
+}
+
+void testStopReadingWhenQueueFull()
+{
+  test();
+  VLCB::SerialGC serialGC(Serial, 2);
+
+  setSerialInput(":S0020N01;:S0020N02;:S0020N03;");
+
+  assertEquals(true, serialGC.available());
+  assertEquals(2, serialGC.receiveBufferSize());
+  assertEquals(2, serialGC.receiveBufferUsage());
+  // The third frame is left in the serial port until there is room.
+  assertEquals(10, Serial.available());
+
+  assertEquals(1, serialGC.getNextCanFrame().data[0]);
+  assertEquals(true, serialGC.available());
+  assertEquals(2, serialGC.getNextCanFrame().data[0]);
+  assertEquals(3, serialGC.getNextCanFrame().data[0]);
+  assertEquals(3, serialGC.receiveCounter());
+}
+
+void testSeparateInstances()
+{
+  test();
+  VLCB::SerialGC first;
+  VLCB::SerialGC second;
+
+  // Each instance keeps its own parse state.
+  setSerialInput(":S0020N");
+  assertEquals(false, first.available());
+  setSerialInput(":S0040N02;");
+  assertEquals(true, second.available());
+  setSerialInput("01;");
+  assertEquals(true, first.available());
+
+  assertEquals(0x2, second.getNextCanFrame().id);
+  VLCB::CANFrame frame = first.getNextCanFrame();
+  assertEquals(0x1, frame.id);
+  assertEquals(1, frame.data[0]);
+}
+
+void testSendFrame()
+{
+  test();
+  VLCB::SerialGC serialGC;
+
+  VLCB::CANFrame frame = {0x1, false, false, 2, {0x90, 0x01}};
+  assertEquals(true, serialGC.sendCanFrame(&frame));
+
+  assertEquals(":S0020N9001;", getSerialOutput().c_str());
+  assertEquals(1, serialGC.transmitCounter());
+}
+
+
+void testTransmitWithoutBlocking()
+{
+  test();
+  VLCB::SerialGC serialGC(Serial, 2, 30);
+  setSerialWriteSpace(16);
+
+  VLCB::CANFrame frame = {0x1, false, false, 2, {0x90, 0x01}};
+  assertEquals(true, serialGC.sendCanFrame(&frame));
+  frame.data[1] = 2;
+  assertEquals(true, serialGC.sendCanFrame(&frame));
+  frame.data[1] = 3;
+  assertEquals(true, serialGC.sendCanFrame(&frame));
+
+  // Only as much as the serial port has room for is written.
+  assertEquals(":S0020N9001;:S00", getSerialOutput().c_str());
+  assertEquals(20, serialGC.transmitBufferUsage());
+  assertEquals(20, serialGC.transmitBufferPeak());
+  assertEquals(30, serialGC.transmitBufferSize());
+  assertEquals(2, serialGC.transmitWaitCounter());
+  assertEquals(0, serialGC.transmitRetryCounter());
+
+  // No room for another frame.
+  assertEquals(false, serialGC.sendCanFrame(&frame));
+  assertEquals(1, serialGC.transmitDropCounter());
+
+  // The rest is written when the serial port has room again.
+  setSerialWriteSpace(64);
+  serialGC.available();
+  assertEquals(":S0020N9001;:S0020N9002;:S0020N9003;", getSerialOutput().c_str());
+  assertEquals(0, serialGC.transmitBufferUsage());
+  assertEquals(3, serialGC.transmitCounter());
+}
+
+void testTransmitWrapsAroundBuffer()
+{
+  test();
+  VLCB::SerialGC serialGC(Serial, 2, 30);
+
+  VLCB::CANFrame frame = {0x1, false, false, 2, {0x90, 0x01}};
+  for (byte i = 1; i <= 5; ++i)
+  {
+    frame.data[1] = i;
+    assertEquals(true, serialGC.sendCanFrame(&frame));
+    setSerialWriteSpace(64);
+  }
+
+  assertEquals(":S0020N9001;:S0020N9002;:S0020N9003;:S0020N9004;:S0020N9005;", getSerialOutput().c_str());
+  assertEquals(0, serialGC.transmitWaitCounter());
+}
+
+const VLCB::CANFrame roundTripFrames[] = {
+  {0x1, false, false, 5, {OPC_ACON, 0x01, 0x02, 0x00, 0x05}},
+  {0x7FF, false, false, 8, {0, 1, 2, 3, 0xFC, 0xFD, 0xFE, 0xFF}},
+  {0x7F, false, true, 0, {}},
+  {0x1FFFFFFF, true, false, 8, {8, 7, 6, 5, 4, 3, 2, 1}},
+  {0x20000, true, false, 0, {}}
+};
+const byte numRoundTripFrames = sizeof(roundTripFrames) / sizeof(roundTripFrames[0]);
+
+// Send frames through one SerialGC and receive them with another.
+// Returns the number of bytes used on the serial link.
+unsigned int roundTrip(VLCB::SerialFraming framing)
+{
+  VLCB::SerialGC sender(Serial, 8, 255);
+  VLCB::SerialGC receiver(Serial, 8, 255);
+  if (framing != VLCB::SERIAL_FRAMING_GRIDCONNECT)
+  {
+    // GridConnect is the default. Avoid the banner that begin() prints for it.
+    sender.begin(framing);
+    receiver.begin(framing);
+  }
+  setSerialWriteSpace(1000);
+
+  for (byte i = 0; i < numRoundTripFrames; ++i)
+  {
+    VLCB::CANFrame frame = roundTripFrames[i];
+    assertEquals(true, sender.sendCanFrame(&frame));
+  }
+  setSerialInput(getSerialOutput());
+
+  assertEquals(true, receiver.available());
+  assertEquals(numRoundTripFrames, receiver.receiveBufferUsage());
+  for (byte i = 0; i < numRoundTripFrames; ++i)
+  {
+    const VLCB::CANFrame & expected = roundTripFrames[i];
+    VLCB::CANFrame frame = receiver.getNextCanFrame();
+    assertEquals(expected.id, frame.id);
+    assertEquals(expected.ext, frame.ext);
+    assertEquals(expected.rtr, frame.rtr);
+    assertEquals(expected.len, frame.len);
+    assertEquals(0, memcmp(expected.data, frame.data, expected.len));
+  }
+  assertEquals(0, receiver.receiveErrorCounter());
+  return getSerialOutput().size();
+}
+
+void testRoundTripBothFramings()
+{
+  test();
+  unsigned int gridConnectBytes = roundTrip(VLCB::SERIAL_FRAMING_GRIDCONNECT);
+  clearArduinoValues();
+  unsigned int binaryBytes = roundTrip(VLCB::SERIAL_FRAMING_BINARY);
+
+  // Binary framing takes half the bytes of GridConnect for these frames.
+  assertEquals(90, gridConnectBytes);
+  assertEquals(45, binaryBytes);
+}
+
+void testBinaryResynchronise()
+{
+  test();
+  VLCB::SerialGC sender;
+  VLCB::SerialGC receiver;
+  sender.begin(VLCB::SERIAL_FRAMING_BINARY);
+  receiver.begin(VLCB::SERIAL_FRAMING_BINARY);
+
+  // A byte that cannot start a frame and a byte that looks like the start of a frame.
+  setSerialInput(std::string("\x3F\x05", 2));
+  VLCB::CANFrame frame = roundTripFrames[0];
+  sender.sendCanFrame(&frame);
+  frame.data[4] = 6;
+  sender.sendCanFrame(&frame);
+  setSerialInput(getSerialOutput());
+
+  assertEquals(true, receiver.available());
+  assertEquals(2, receiver.receiveBufferUsage());
+  assertEquals(5, receiver.getNextCanFrame().data[4]);
+  assertEquals(6, receiver.getNextCanFrame().data[4]);
+  assertEquals(1, receiver.receiveErrorCounter());
+}
+
+}
+
+void testSerialGC()
+{
+  testReceiveAllAvailableFrames();
+  testFrameSplitOverCalls();
+  testResynchroniseOnStartCharacter();
+  testInvalidAndOverlongMessages();
+  testStopReadingWhenQueueFull();
+  testSeparateInstances();
+  testSendFrame();
+  testTransmitWithoutBlocking();
+  testTransmitWrapsAroundBuffer();
+  testRoundTripBothFramings();
+  testBinaryResynchronise();
+}